@@ -0,0 +1,60 @@
+#ifndef _BENCHMARK_H__
+#define _BENCHMARK_H__
+
+#include <cstdlib>
+#include <map>
+#include <string>
+
+#include "Timer.h"
+
+/**
+ * Options given to a benchmark on the command line,
+ * as "--name value" pairs
+ */
+class BenchmarkArgs {
+public:
+	BenchmarkArgs(int argc, char* argv[], int first) {
+		for (int i = first; i + 1 < argc; i += 2) {
+			std::string name = argv[i];
+			if (name.compare(0, 2, "--") == 0)
+				values[name.substr(2)] = argv[i + 1];
+		}
+	}
+
+	inline int getInt(const std::string& name, int default_value) const {
+		std::map<std::string, std::string>::const_iterator it = values.find(name);
+		return (it == values.end()) ? default_value : atoi(it->second.c_str());
+	}
+
+	inline double getDouble(const std::string& name, double default_value) const {
+		std::map<std::string, std::string>::const_iterator it = values.find(name);
+		return (it == values.end()) ? default_value : atof(it->second.c_str());
+	}
+
+	inline std::string getString(const std::string& name, const std::string& default_value) const {
+		std::map<std::string, std::string>::const_iterator it = values.find(name);
+		return (it == values.end()) ? default_value : it->second;
+	}
+
+private:
+	std::map<std::string, std::string> values;
+};
+
+/**
+ * Runs function repetitions times and returns the fastest
+ * run in seconds
+ */
+template <typename Function>
+double bestOf(unsigned int repetitions, Function function) {
+	double best = 0.0;
+	for (unsigned int i = 0; i < repetitions; ++i) {
+		Timer timer;
+		function();
+		double elapsed = timer.elapsed();
+		if (i == 0 || elapsed < best)
+			best = elapsed;
+	}
+	return best;
+}
+
+#endif
@@ -0,0 +1,61 @@
+#include "SyntheticMesh.h"
+
+#include "GameException.h"
+
+#include <cmath>
+#include <cstdio>
+
+void writeSyntheticObj(const std::string& filename, unsigned int n_objects, unsigned int triangles_per_object) {
+	FILE* file = fopen(filename.c_str(), "w");
+	if (!file)
+		THROW_EXCEPTION("Could not open " + filename + " for writing");
+
+	// A grid of side x side quads, two triangles each
+	unsigned int side = static_cast<unsigned int>(std::sqrt(triangles_per_object / 2.0));
+	if (side < 1)
+		side = 1;
+	unsigned int grid_columns = static_cast<unsigned int>(std::ceil(std::sqrt(static_cast<double>(n_objects))));
+
+	unsigned long long first_vertex = 1; // OBJ indices start at one
+	for (unsigned int object = 0; object < n_objects; ++object) {
+		float offset_x = static_cast<float>(object % grid_columns) * 1.1f;
+		float offset_z = static_cast<float>(object / grid_columns) * 1.1f;
+
+		fprintf(file, "o object%u\n", object);
+		for (unsigned int j = 0; j <= side; ++j) {
+			for (unsigned int i = 0; i <= side; ++i) {
+				float u = i / static_cast<float>(side);
+				float v = j / static_cast<float>(side);
+				float height = 0.05f * std::sin(u * 12.0f) * std::cos(v * 12.0f);
+				fprintf(file, "v %f %f %f\n", offset_x + u, height, offset_z + v);
+			}
+		}
+		for (unsigned int j = 0; j <= side; ++j) {
+			for (unsigned int i = 0; i <= side; ++i) {
+				float u = i / static_cast<float>(side);
+				float v = j / static_cast<float>(side);
+				// Gradient of the height field
+				float dx = 0.6f * std::cos(u * 12.0f) * std::cos(v * 12.0f);
+				float dz = -0.6f * std::sin(u * 12.0f) * std::sin(v * 12.0f);
+				float length = std::sqrt(dx * dx + 1.0f + dz * dz);
+				fprintf(file, "vn %f %f %f\n", -dx / length, 1.0f / length, -dz / length);
+			}
+		}
+		for (unsigned int j = 0; j < side; ++j) {
+			for (unsigned int i = 0; i < side; ++i) {
+				unsigned long long a = first_vertex + j * (side + 1) + i;
+				unsigned long long b = a + 1;
+				unsigned long long c = a + (side + 1);
+				unsigned long long d = c + 1;
+				fprintf(file, "f %llu//%llu %llu//%llu %llu//%llu\n", a, a, c, c, b, b);
+				fprintf(file, "f %llu//%llu %llu//%llu %llu//%llu\n", b, b, c, c, d, d);
+			}
+		}
+		first_vertex += static_cast<unsigned long long>(side + 1) * (side + 1);
+	}
+
+	bool ok = (ferror(file) == 0);
+	fclose(file);
+	if (!ok)
+		THROW_EXCEPTION("Could not write " + filename);
+}
@@ -0,0 +1,13 @@
+#ifndef _SYNTHETICMESH_H__
+#define _SYNTHETICMESH_H__
+
+#include <string>
+
+/**
+ * Writes an OBJ file with n_objects separate objects ("o" groups, so assimp
+ * gives every one its own mesh), each a wavy grid of about
+ * triangles_per_object triangles with smooth normals.
+ */
+void writeSyntheticObj(const std::string& filename, unsigned int n_objects, unsigned int triangles_per_object);
+
+#endif
@@ -0,0 +1,103 @@
+#include "Benchmark.h"
+#include "MeshHierarchy.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace {
+	/**
+	 * A tree of n_nodes nodes where every node has up to branching
+	 * children, added breadth first, each with a box around its geometry
+	 */
+	void makeTree(unsigned int n_nodes, unsigned int branching, MeshHierarchy& hierarchy) {
+		srand(1);
+		hierarchy.clear();
+		hierarchy.reserve(n_nodes);
+		for (unsigned int i = 0; i < n_nodes; ++i) {
+			int parent = (i == 0) ? -1 : static_cast<int>((i - 1) / branching);
+			glm::vec3 position(rand() % 20 - 10.0f, rand() % 20 - 10.0f, rand() % 20 - 10.0f);
+			glm::mat4 transform = glm::translate(glm::mat4(1.0f), position);
+			transform = glm::rotate(transform, static_cast<float>(rand() % 360), glm::vec3(0.0f, 1.0f, 0.0f));
+			unsigned int node = hierarchy.addNode(parent, transform, 0, 3);
+			hierarchy.setBounds(node, glm::vec3(-1.0f), glm::vec3(1.0f));
+		}
+		hierarchy.updateWorldTransforms();
+	}
+}
+
+/**
+ * Times updating the world transforms, normal transforms and bounds of
+ * a hierarchy after moving a node: the root, a child of the root, and
+ * the last leaf.
+ * Options:
+ *   --nodes N        only run for N nodes (default: 1000, 10000 and 100000)
+ *   --branching N    children per node (default: 1, 4 and 16; 1 is a chain)
+ *   --repetitions N  runs per case, the best one is reported (default 5)
+ */
+int benchHierarchy(const BenchmarkArgs& args) {
+	std::vector<unsigned int> node_counts;
+	int nodes = args.getInt("nodes", 0);
+	if (nodes > 0) {
+		node_counts.push_back(nodes);
+	}
+	else {
+		node_counts.push_back(1000);
+		node_counts.push_back(10000);
+		node_counts.push_back(100000);
+	}
+	std::vector<unsigned int> branchings;
+	int branching = args.getInt("branching", 0);
+	if (branching > 0) {
+		branchings.push_back(branching);
+	}
+	else {
+		branchings.push_back(1);
+		branchings.push_back(4);
+		branchings.push_back(16);
+	}
+	unsigned int repetitions = args.getInt("repetitions", 5);
+
+	printf("%8s %10s %12s %10s %12s %10s %12s\n", "nodes", "branching", "root us", "ns/node", "child us", "nodes", "leaf us");
+	for (size_t n = 0; n < node_counts.size(); ++n) {
+		for (size_t b = 0; b < branchings.size(); ++b) {
+			unsigned int n_nodes = node_counts[n];
+			MeshHierarchy hierarchy;
+			makeTree(n_nodes, branchings[b], hierarchy);
+			unsigned int iterations = std::max(1u, 1000000u / n_nodes);
+
+			// Time to move node and update the hierarchy
+			auto timeMove = [&](unsigned int node) {
+				glm::mat4 local = hierarchy.getLocalTransform(node);
+				return bestOf(repetitions, [&]() {
+					for (unsigned int i = 0; i < iterations; ++i) {
+						hierarchy.setLocalTransform(node, glm::translate(local, glm::vec3(0.0f, 0.001f * i, 0.0f)));
+						hierarchy.updateWorldTransforms();
+					}
+				}) / iterations;
+			};
+
+			// Moving the root dirties every node, moving its first child
+			// the nodes below that child, and moving the last node only itself
+			unsigned int child = std::min(1u, n_nodes - 1);
+			unsigned int child_nodes = 0;
+			std::vector<unsigned char> below_child(n_nodes, 0);
+			for (unsigned int i = child; i < n_nodes; ++i) {
+				int parent = hierarchy.getParent(i);
+				below_child[i] = (i == child) || (parent >= 0 && below_child[parent]);
+				child_nodes += below_child[i];
+			}
+			double root_time = timeMove(0);
+			double child_time = timeMove(child);
+			double leaf_time = timeMove(n_nodes - 1);
+
+			printf("%8u %10u %12.1f %10.2f %12.1f %10u %12.1f\n", n_nodes, branchings[b], root_time * 1e6, root_time * 1e9 / n_nodes,
+				child_time * 1e6, child_nodes, leaf_time * 1e6);
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,85 @@
+#include "Benchmark.h"
+#include "SyntheticMesh.h"
+#include "Model.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <thread>
+
+/**
+ * Times the conversion of an imported assimp scene into a MeshData
+ * with 1, 2, 4, ... threads. The assimp import itself is done once
+ * up front, as it is serial and the same for every thread count,
+ * and timed with every import profile.
+ * Options:
+ *   --file F         model to load (default: a synthetic OBJ)
+ *   --meshes N       meshes in the synthetic OBJ (default 256)
+ *   --triangles N    triangles per synthetic mesh (default 20000)
+ *   --max-threads N  highest thread count to try (default: all cores)
+ *   --repetitions N  runs per thread count, the best one is reported (default 3)
+ *   --profile P      import profile the scene is converted from (default fast)
+ */
+int benchImport(const BenchmarkArgs& args) {
+	std::string filename = args.getString("file", "");
+	bool synthetic = filename.empty();
+	if (synthetic) {
+		filename = "bench_synthetic.obj";
+		unsigned int n_meshes = args.getInt("meshes", 256);
+		unsigned int n_triangles = args.getInt("triangles", 20000);
+		std::cout << "Writing " << filename << ": " << n_meshes << " meshes of ~" << n_triangles << " triangles" << std::endl;
+		writeSyntheticObj(filename, n_meshes, n_triangles);
+	}
+
+	ImportProfile::Profile profile = ImportProfile::FAST;
+	ImportProfile::fromName(args.getString("profile", "fast"), profile);
+
+	const aiScene* scene = NULL;
+	for (unsigned int i = 0; i < ImportProfile::n_profiles; ++i) {
+		ImportProfile::Profile import_profile = static_cast<ImportProfile::Profile>(i);
+		Timer import_timer;
+		const aiScene* imported = ImportProfile::importFile(filename, import_profile);
+		double import_time = import_timer.elapsed();
+		if (!imported) {
+			std::cerr << "Unable to load mesh from " << filename << std::endl;
+			if (scene)
+				aiReleaseImport(scene);
+			return 1;
+		}
+		std::cout << "assimp import (" << ImportProfile::getName(import_profile) << "): " << import_time * 1000.0 << " ms, "
+			<< imported->mNumMeshes << " meshes" << std::endl;
+
+		if (import_profile == profile)
+			scene = imported;
+		else
+			aiReleaseImport(imported);
+	}
+
+	unsigned int max_threads = args.getInt("max-threads", std::max(1u, std::thread::hardware_concurrency()));
+	unsigned int repetitions = args.getInt("repetitions", 3);
+
+	double serial_time = 0.0;
+	printf("%8s %12s %8s\n", "threads", "convert ms", "speedup");
+	for (unsigned int threads = 1; threads <= max_threads; threads *= 2) {
+		LoadOptions options;
+		options.threads = threads;
+
+		double time = bestOf(repetitions, [&]() {
+			MeshData data;
+			Model::convertScene(scene, false, data, options);
+		});
+		if (threads == 1)
+			serial_time = time;
+
+		printf("%8u %12.2f %8.2f\n", threads, time * 1000.0, serial_time / time);
+
+		// Also try the exact core count if it is not a power of two
+		if (threads < max_threads && threads * 2 > max_threads)
+			threads = max_threads / 2;
+	}
+
+	aiReleaseImport(scene);
+	if (synthetic)
+		remove(filename.c_str());
+	return 0;
+}
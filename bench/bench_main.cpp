@@ -0,0 +1,73 @@
+#include "Benchmark.h"
+#include "GameException.h"
+
+#include <cstring>
+#include <iostream>
+
+int benchHierarchy(const BenchmarkArgs& args);
+int benchImport(const BenchmarkArgs& args);
+int benchObj(const BenchmarkArgs& args);
+int benchTimer(const BenchmarkArgs& args);
+int benchTrackball(const BenchmarkArgs& args);
+int benchTransform(const BenchmarkArgs& args);
+
+namespace {
+	struct BenchmarkEntry {
+		const char* name;
+		const char* description;
+		int (*function)(const BenchmarkArgs& args);
+	};
+
+	const BenchmarkEntry benchmarks[] = {
+		{"hierarchy", "World transforms and bounds of node hierarchies after moving a node", benchHierarchy},
+		{"import", "Mesh conversion time against thread count", benchImport},
+		{"obj", "Reading OBJ files with ObjReader against assimp", benchObj},
+		{"timer", "Cost of reading the clocks of Timer and of a timed scope", benchTimer},
+		{"trackball", "Virtual trackball rotation per call, and per frame with and without coalescing mouse motion", benchTrackball},
+		{"transform", "Per part modelview and normal matrices, glm against the batch kernels", benchTransform},
+	};
+	const unsigned int n_benchmarks = sizeof(benchmarks) / sizeof(benchmarks[0]);
+
+	void printUsage(const char* program) {
+		std::cerr << "Usage: " << program << " <benchmark|all> [--option value ...]" << std::endl;
+		std::cerr << "Benchmarks:" << std::endl;
+		for (unsigned int i = 0; i < n_benchmarks; ++i)
+			std::cerr << "  " << benchmarks[i].name << "\t" << benchmarks[i].description << std::endl;
+	}
+}
+
+/**
+ * Runs one (or all) of the benchmarks
+ */
+int main(int argc, char* argv[]) {
+	if (argc < 2) {
+		printUsage(argv[0]);
+		return 1;
+	}
+
+	BenchmarkArgs args(argc, argv, 2);
+	bool all = (strcmp(argv[1], "all") == 0);
+	bool found = false;
+	int result = 0;
+
+	for (unsigned int i = 0; i < n_benchmarks; ++i) {
+		if (!all && strcmp(argv[1], benchmarks[i].name) != 0)
+			continue;
+		found = true;
+
+		std::cout << "=== " << benchmarks[i].name << ": " << benchmarks[i].description << std::endl;
+		try {
+			if (benchmarks[i].function(args) != 0)
+				result = 1;
+		}
+		catch (GameException&) {
+			result = 1;
+		}
+	}
+
+	if (!found) {
+		printUsage(argv[0]);
+		return 1;
+	}
+	return result;
+}
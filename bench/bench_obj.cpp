@@ -0,0 +1,83 @@
+#include "Benchmark.h"
+#include "SyntheticMesh.h"
+#include "Model.h"
+
+#include <cstdio>
+#include <iostream>
+#include <vector>
+
+namespace {
+	// Bytes of a synthetic OBJ file per triangle, to pick the triangle
+	// count for a file size (about one vertex per two triangles)
+	const double synthetic_bytes_per_triangle = 80.0;
+	const unsigned int synthetic_objects = 64;
+
+	long long fileSize(const std::string& filename) {
+		FILE* file = fopen(filename.c_str(), "rb");
+		if (!file)
+			return -1;
+		fseek(file, 0, SEEK_END);
+		long long size = ftell(file);
+		fclose(file);
+		return size;
+	}
+
+	/**
+	 * Imports filename with and without ObjReader, and prints the best time of each
+	 */
+	void compare(const std::string& filename, unsigned int threads, unsigned int repetitions) {
+		// Only the reading and welding is compared, not the passes after it
+		LoadOptions options;
+		options.threads = threads;
+		options.lod_levels = 1;
+		options.optimize = false;
+
+		std::vector<double> times;
+		for (int obj_reader = 1; obj_reader >= 0; --obj_reader) {
+			options.obj_reader = (obj_reader != 0);
+			times.push_back(bestOf(repetitions, [&]() {
+				MeshData data;
+				Model::import(filename, false, data, options);
+			}));
+		}
+
+		double megabytes = fileSize(filename) / (1024.0 * 1024.0);
+		printf("%10.1f %12.1f %12.1f %14.1f %14.1f %8.2f\n", megabytes, times[0] * 1000.0, times[1] * 1000.0,
+			megabytes / times[0], megabytes / times[1], times[1] / times[0]);
+	}
+}
+
+/**
+ * Times reading OBJ files with ObjReader against assimp, on synthetic
+ * files from --min-mb to --max-mb, doubling the size every time.
+ * Several GB work, but take a while to write (and a lot of memory to
+ * read with assimp).
+ * Options:
+ *   --file F         OBJ file to read instead of the synthetic ones
+ *   --min-mb N       size of the smallest synthetic file (default 1)
+ *   --max-mb N       size of the largest synthetic file (default 256)
+ *   --threads N      threads for ObjReader and the conversion (default: all cores)
+ *   --repetitions N  runs per file and reader, the best one is reported (default 3)
+ */
+int benchObj(const BenchmarkArgs& args) {
+	unsigned int threads = args.getInt("threads", 0);
+	unsigned int repetitions = args.getInt("repetitions", 3);
+
+	printf("%10s %12s %12s %14s %14s %8s\n", "MB", "ObjReader ms", "assimp ms", "ObjReader MB/s", "assimp MB/s", "speedup");
+
+	std::string filename = args.getString("file", "");
+	if (!filename.empty()) {
+		compare(filename, threads, repetitions);
+		return 0;
+	}
+
+	filename = "bench_synthetic.obj";
+	double max_megabytes = args.getDouble("max-mb", 256.0);
+	for (double megabytes = args.getDouble("min-mb", 1.0); megabytes <= max_megabytes; megabytes *= 2.0) {
+		double n_triangles = megabytes * 1024.0 * 1024.0 / synthetic_bytes_per_triangle;
+		writeSyntheticObj(filename, synthetic_objects, static_cast<unsigned int>(n_triangles / synthetic_objects));
+		compare(filename, threads, repetitions);
+	}
+	remove(filename.c_str());
+	return 0;
+}
@@ -0,0 +1,52 @@
+#include "Benchmark.h"
+
+#include <cstdio>
+
+/**
+ * Times reading the clocks of Timer, and the cost of one timed scope.
+ * Options:
+ *   --iterations N   clock reads per measurement (default: 10000000)
+ *   --repetitions N  runs per case, the best one is reported (default 5)
+ */
+int benchTimer(const BenchmarkArgs& args) {
+	unsigned int iterations = args.getInt("iterations", 10000000);
+	unsigned int repetitions = args.getInt("repetitions", 5);
+
+	// Summed, so the reads are not optimized away
+	uint64_t sum = 0;
+
+	printf("%-24s %10s\n", "", "ns/call");
+	double time = bestOf(repetitions, [&]() {
+		for (unsigned int i = 0; i < iterations; ++i)
+			sum += Timer::getNanoseconds();
+	}) / iterations;
+	printf("%-24s %10.2f\n", "Timer::getNanoseconds", time * 1e9);
+
+	time = bestOf(repetitions, [&]() {
+		for (unsigned int i = 0; i < iterations; ++i)
+			sum += Timer::getTicks();
+	}) / iterations;
+	printf("%-24s %10.2f%s\n", "Timer::getTicks", time * 1e9,
+#ifdef TIMER_HAVE_TSC
+		" (time stamp counter)"
+#else
+		" (monotonic clock, define TIMER_USE_TSC for the time stamp counter)"
+#endif
+		);
+
+	static TimerAccumulator accumulator("bench");
+	time = bestOf(repetitions, [&]() {
+		for (unsigned int i = 0; i < iterations; ++i)
+			ScopedTimer timer(accumulator);
+	}) / iterations;
+	printf("%-24s %10.2f\n", "ScopedTimer", time * 1e9);
+
+	printf("%-24s %10s\n", "TIMED_SCOPE",
+#ifdef TIMED_SCOPES
+		"as ScopedTimer"
+#else
+		"compiled out"
+#endif
+		);
+	return (sum == 0) ? 1 : 0;
+}
@@ -0,0 +1,88 @@
+#include "Benchmark.h"
+#include "VirtualTrackball.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+/**
+ * Times VirtualTrackball::rotate on a drag around a circle in an 800x600
+ * window, and what the trackball costs per frame when it is turned for
+ * every mouse motion event against once per frame.
+ * Options:
+ *   --iterations N   rotate calls, or mouse motion events, per measurement
+ *                    (default: 1000000)
+ *   --events N       mouse motion events per frame, e.g. 8 for a 1000 Hz
+ *                    mouse at 120 frames per second (default: 8)
+ *   --repetitions N  runs per case, the best one is reported (default 5)
+ */
+int benchTrackball(const BenchmarkArgs& args) {
+	unsigned int iterations = args.getInt("iterations", 1000000);
+	unsigned int events = std::max(1, args.getInt("events", 8));
+	unsigned int repetitions = args.getInt("repetitions", 5);
+	const int width = 800, height = 600;
+
+	// Mouse positions on a circle that crosses the edge of the trackball
+	const unsigned int n_positions = 1024;
+	std::vector<int> xs(n_positions), ys(n_positions);
+	for (unsigned int i = 0; i < n_positions; ++i) {
+		double angle = 2.0 * 3.14159265358979 * i / n_positions;
+		xs[i] = width / 2 + static_cast<int>(320.0 * cos(angle));
+		ys[i] = height / 2 + static_cast<int>(240.0 * sin(angle));
+	}
+
+	VirtualTrackball trackball;
+	trackball.setWindowSize(width, height);
+
+	// Summed, so the rotations are not optimized away
+	float sum = 0.0f;
+	double time = bestOf(repetitions, [&]() {
+		trackball.rotateBegin(width / 2, height / 2);
+		for (unsigned int i = 0; i < iterations; ++i) {
+			glm::mat4 view_matrix = trackball.rotate(xs[i % n_positions], ys[i % n_positions]);
+			sum += view_matrix[0][0];
+		}
+		trackball.rotateEnd(xs[(iterations - 1) % n_positions], ys[(iterations - 1) % n_positions]);
+	}) / iterations;
+
+	// Frames of events mouse motion events each, handled as the main loop
+	// did before coalescing (rotate for every event), and as it does now
+	// (keep the last position, rotate once before drawing). Taking events
+	// from SDL costs the same either way and is left out.
+	unsigned int frames = std::max(1u, iterations / events);
+	double per_event = bestOf(repetitions, [&]() {
+		trackball.rotateBegin(width / 2, height / 2);
+		unsigned int position = 0;
+		for (unsigned int i = 0; i < frames; ++i) {
+			glm::mat4 view_matrix(1.0f);
+			for (unsigned int j = 0; j < events; ++j, ++position)
+				view_matrix = trackball.rotate(xs[position % n_positions], ys[position % n_positions]);
+			sum += view_matrix[0][0];
+		}
+		trackball.rotateEnd(width / 2, height / 2);
+	}) / frames;
+
+	double once = bestOf(repetitions, [&]() {
+		trackball.rotateBegin(width / 2, height / 2);
+		unsigned int position = 0;
+		for (unsigned int i = 0; i < frames; ++i) {
+			int mouse_x = 0, mouse_y = 0;
+			bool mouse_moved = false;
+			for (unsigned int j = 0; j < events; ++j, ++position) {
+				mouse_x = xs[position % n_positions];
+				mouse_y = ys[position % n_positions];
+				mouse_moved = true;
+			}
+			if (mouse_moved)
+				sum += trackball.rotate(mouse_x, mouse_y)[0][0];
+		}
+		trackball.rotateEnd(width / 2, height / 2);
+	}) / frames;
+
+	printf("%-24s %10s %18s %18s\n", "", "ns/call", "ns/frame (events)", "ns/frame (once)");
+	printf("%-24s %10.2f %18.2f %18.2f\n", "VirtualTrackball::rotate", time * 1e9, per_event * 1e9, once * 1e9);
+	return (sum == sum) ? 0 : 1;
+}
@@ -0,0 +1,129 @@
+#include "Benchmark.h"
+#include "MeshHierarchy.h"
+#include "TransformKernel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace {
+	/**
+	 * A flat hierarchy of n_parts randomly rotated, scaled and moved parts
+	 */
+	void makeParts(unsigned int n_parts, MeshHierarchy& hierarchy) {
+		srand(1);
+		hierarchy.clear();
+		hierarchy.reserve(n_parts);
+		for (unsigned int i = 0; i < n_parts; ++i) {
+			glm::vec3 position(rand() % 200 - 100.0f, rand() % 200 - 100.0f, rand() % 200 - 100.0f);
+			glm::vec3 axis(rand() % 100 + 1.0f, rand() % 100 - 50.0f, rand() % 100 - 50.0f);
+			float angle = static_cast<float>(rand() % 360);
+			float scale = 0.5f + (rand() % 100) / 50.0f;
+
+			glm::mat4 transform = glm::translate(glm::mat4(1.0f), position);
+			transform = glm::rotate(transform, angle, axis);
+			transform = glm::scale(transform, glm::vec3(scale, scale * 1.5f, scale));
+			hierarchy.addNode(-1, transform, 0, 3);
+		}
+		hierarchy.updateWorldTransforms();
+	}
+
+	/**
+	 * What the renderer used to do for every part: the full product and
+	 * an inverse of the modelview matrix per part
+	 */
+	void transformPartsGlm(const glm::mat4& view_matrix, const glm::mat4& model_matrix, const MeshHierarchy& hierarchy,
+			TransformKernel::DrawTransform* out) {
+		for (unsigned int i = 0; i < hierarchy.size(); ++i) {
+			glm::mat4 modelview_matrix = view_matrix*model_matrix*hierarchy.getWorldTransform(i);
+			glm::mat3 normal_matrix = glm::transpose(glm::inverse(glm::mat3(modelview_matrix)));
+			out[i].modelview_matrix = modelview_matrix;
+			for (int c = 0; c < 3; ++c)
+				out[i].normal_matrix[c] = glm::vec4(normal_matrix[c], 0.0f);
+		}
+	}
+
+	/**
+	 * Largest difference to the reference, relative to the largest element
+	 */
+	float maxError(const std::vector<TransformKernel::DrawTransform>& a, const std::vector<TransformKernel::DrawTransform>& b) {
+		float error = 0.0f;
+		for (size_t i = 0; i < a.size(); ++i) {
+			const float* x = &a[i].modelview_matrix[0][0];
+			const float* y = &b[i].modelview_matrix[0][0];
+			float scale = 1e-6f;
+			for (int j = 0; j < 28; ++j)
+				scale = std::max(scale, std::fabs(y[j]));
+			for (int j = 0; j < 28; ++j)
+				error = std::max(error, std::fabs(x[j] - y[j]) / scale);
+		}
+		return error;
+	}
+}
+
+/**
+ * Times computing the modelview and normal matrices of every part, with
+ * the glm path the renderer used before and the batch kernels.
+ * Options:
+ *   --parts N        only run for N parts (default: 1000, 10000 and 100000)
+ *   --repetitions N  runs per case, the best one is reported (default 5)
+ */
+int benchTransform(const BenchmarkArgs& args) {
+	std::vector<unsigned int> part_counts;
+	int parts = args.getInt("parts", 0);
+	if (parts > 0) {
+		part_counts.push_back(parts);
+	}
+	else {
+		part_counts.push_back(1000);
+		part_counts.push_back(10000);
+		part_counts.push_back(100000);
+	}
+	unsigned int repetitions = args.getInt("repetitions", 5);
+
+	glm::mat4 view_matrix = glm::rotate(glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -5.0f)), 30.0f, glm::vec3(0.0f, 1.0f, 0.0f));
+	glm::mat4 model_matrix = glm::scale(glm::mat4(1.0f), glm::vec3(3));
+	glm::mat4 view_model_matrix = view_matrix*model_matrix;
+	glm::mat4 view_model_normal_matrix = glm::mat4(glm::transpose(glm::inverse(glm::mat3(view_model_matrix))));
+
+	const TransformKernel::Implementation implementations[] = {TransformKernel::SCALAR, TransformKernel::SSE, TransformKernel::AVX2};
+
+	printf("%8s %-10s %12s %10s %8s %10s\n", "parts", "kernel", "total us", "ns/part", "speedup", "max error");
+	for (size_t p = 0; p < part_counts.size(); ++p) {
+		unsigned int n_parts = part_counts[p];
+		MeshHierarchy hierarchy;
+		makeParts(n_parts, hierarchy);
+
+		// Repeat small cases, so every measurement takes a while
+		unsigned int iterations = std::max(1u, 1000000u / n_parts);
+
+		std::vector<TransformKernel::DrawTransform> reference(n_parts);
+		double glm_time = bestOf(repetitions, [&]() {
+			for (unsigned int i = 0; i < iterations; ++i)
+				transformPartsGlm(view_matrix, model_matrix, hierarchy, &reference[0]);
+		}) / iterations;
+		printf("%8u %-10s %12.1f %10.2f %8.2f %10s\n", n_parts, "glm", glm_time * 1e6, glm_time * 1e9 / n_parts, 1.0, "-");
+
+		std::vector<TransformKernel::DrawTransform> out(n_parts);
+		for (size_t k = 0; k < sizeof(implementations) / sizeof(implementations[0]); ++k) {
+			TransformKernel::Implementation implementation = implementations[k];
+			if (!TransformKernel::isSupported(implementation))
+				continue;
+
+			double time = bestOf(repetitions, [&]() {
+				for (unsigned int i = 0; i < iterations; ++i)
+					TransformKernel::transformParts(implementation, view_model_matrix, view_model_normal_matrix,
+						hierarchy.getWorldTransforms(), hierarchy.getNormalTransforms(), NULL, n_parts, &out[0]);
+			}) / iterations;
+
+			printf("%8u %-10s %12.1f %10.2f %8.2f %10.2e\n", n_parts, TransformKernel::getName(implementation),
+				time * 1e6, time * 1e9 / n_parts, glm_time / time, maxError(out, reference));
+		}
+	}
+	return 0;
+}
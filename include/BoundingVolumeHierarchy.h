@@ -0,0 +1,70 @@
+#ifndef _BOUNDINGVOLUMEHIERARCHY_H__
+#define _BOUNDINGVOLUMEHIERARCHY_H__
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Frustum.h"
+#include "MeshHierarchy.h"
+
+/**
+ * A binary tree of axis-aligned bounding boxes over the model space
+ * bounds of the parts of a model, for culling them against the view
+ * frustum without testing every part. Parts are split at the median
+ * of the longest axis, so the tree is balanced. The tree is stored
+ * depth first in one array: the left child of a node follows it, and
+ * the parts below a node form one range, so a node entirely inside
+ * the frustum marks its parts visible without testing them.
+ */
+class BoundingVolumeHierarchy {
+public:
+	BoundingVolumeHierarchy();
+	~BoundingVolumeHierarchy();
+
+	/**
+	 * Rebuilds the tree if the hierarchy changed since the last call.
+	 * Only nodes with geometry (and a bounding box) are added.
+	 */
+	void update(const MeshHierarchy& hierarchy);
+
+	/**
+	 * Sets visible[i] to 1 for every part i whose box is (at least partly)
+	 * inside the frustum, and to 0 for all other nodes of the hierarchy.
+	 * Returns the number of visible parts.
+	 */
+	unsigned int cull(const Frustum& frustum, std::vector<unsigned char>& visible) const;
+
+	/**
+	 * Number of parts in the tree
+	 */
+	inline unsigned int size() const {return static_cast<unsigned int>(parts.size());}
+
+	static const unsigned int max_leaf_parts = 4;
+
+private:
+	struct Node {
+		glm::vec3 min;
+		glm::vec3 max;
+		unsigned int first; //< First part below the node, in parts
+		unsigned int count; //< Number of parts below the node
+		unsigned int right; //< Right child, 0 for a leaf
+	};
+
+	/**
+	 * Adds the node for parts[first, first + count) and its subtree,
+	 * and returns its index
+	 */
+	unsigned int build(unsigned int first, unsigned int count);
+
+	std::vector<Node> nodes;
+	std::vector<unsigned int> parts; //< Hierarchy node of every part, in tree order
+	std::vector<glm::vec3> part_min; //< Bounds of every part, indexed by hierarchy node
+	std::vector<glm::vec3> part_max;
+	unsigned int n_hierarchy_nodes;
+
+	bool built;
+	unsigned int built_version; //< Version of the hierarchy the tree was built for
+};
+
+#endif
@@ -0,0 +1,140 @@
+#ifndef _DRAWBATCH_H__
+#define _DRAWBATCH_H__
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "GLUtils/GLUtils.hpp"
+#include "DrawDataBuffer.h"
+#include "MeshHierarchy.h"
+
+/**
+ * The list of draws of a model: one per node of the hierarchy that has
+ * uploaded geometry and is not culled, at the level of detail picked for it. Draw i uses the matrices at index i of the draw
+ * data, so the draw data is computed for getNodes() only.
+ *
+ * The parts are drawn either with one multi-draw call (one per chunk of
+ * the DrawDataBuffer), where the shader tells them apart with
+ * gl_DrawIDARB, the index of the draw within the call, or with one call
+ * per part. Nodes without geometry are left out of the list, as some
+ * drivers get the draw ids wrong around empty draws in a multi-draw call.
+ *
+ * Without culling, the list is only rebuilt while the model is still
+ * being uploaded.
+ * Batches use glMultiDrawElementsIndirect with a command buffer where
+ * supported, and glMultiDrawElements otherwise.
+ *
+ * The list can be drawn with several instances of every part, for the
+ * instances of a model in a scene. The draws stay the same however many
+ * instances there are: the commands of the indirect buffer say how many,
+ * and without it every part is drawn with glDrawElementsInstanced, as
+ * glMultiDrawElements has no instanced form.
+ */
+class DrawBatch {
+public:
+	DrawBatch(bool use_indirect=isIndirectSupported());
+	~DrawBatch();
+
+	/**
+	 * True if the context has gl_DrawIDARB (GL_ARB_shader_draw_parameters),
+	 * which batching needs
+	 */
+	static bool isSupported();
+
+	/**
+	 * True if the context has glMultiDrawElementsIndirect
+	 */
+	static bool isIndirectSupported();
+
+	/**
+	 * Preprocessor definitions the shaders need to use the draw id
+	 */
+	static std::string getShaderDefines();
+
+	/**
+	 * Rebuilds the draw list if the hierarchy or the number of uploaded
+	 * indices changed since the last call. If visible is given (one flag
+	 * per node), nodes flagged 0 are culled. If levels is given, each node
+	 * is drawn at levels[node], or at the full level until that level is
+	 * uploaded. With either, the list is rebuilt every call.
+	 */
+	void update(const MeshHierarchy& hierarchy, unsigned int available_indices, size_t index_size,
+			const unsigned char* visible=NULL, const unsigned char* levels=NULL);
+
+	/**
+	 * Hierarchy node of every draw
+	 */
+	const std::vector<unsigned int>& getNodes() const { return nodes; }
+	unsigned int size() const { return static_cast<unsigned int>(nodes.size()); }
+
+	/**
+	 * Number of nodes with geometry left out of the list by culling
+	 */
+	unsigned int getNumCulled() const { return n_culled; }
+
+	/**
+	 * Triangles in the list, and the number of draws at each level of detail
+	 */
+	size_t getNumTriangles() const { return n_triangles; }
+	const std::vector<unsigned int>& getLevelDraws() const { return level_draws; }
+
+	/**
+	 * Number of indices and byte offset in the index buffer of every draw,
+	 * for drawing the list without OpenGL
+	 */
+	const std::vector<GLsizei>& getCounts() const { return counts; }
+	const std::vector<const GLvoid*>& getOffsets() const { return offsets; }
+
+	/**
+	 * Draws all parts with multi-draw calls, which needs isSupported().
+	 * The draw data must be uploaded and bound, and the VAO bound. draw_id
+	 * is set to the draw id of the first part of each call, the shader adds
+	 * gl_DrawIDARB to it. Every part is drawn instances times. Returns the
+	 * number of draw calls made.
+	 */
+	unsigned int draw(GLenum index_type, DrawDataBuffer& draw_data, const GLUtils::Uniform<GLint>& draw_id,
+			unsigned int instances=1);
+
+	/**
+	 * Draws all parts with one call each, instances times. Returns the
+	 * number of draw calls made.
+	 */
+	unsigned int drawSeparately(GLenum index_type, DrawDataBuffer& draw_data, const GLUtils::Uniform<GLint>& draw_id,
+			unsigned int instances=1);
+
+private:
+	DrawBatch(const DrawBatch&);
+	DrawBatch& operator=(const DrawBatch&);
+
+	/**
+	 * Layout of a command in the indirect buffer, given by OpenGL
+	 */
+	struct DrawElementsIndirectCommand {
+		GLuint count;
+		GLuint instance_count;
+		GLuint first_index;
+		GLint base_vertex;
+		GLuint base_instance;
+	};
+
+	bool use_indirect;
+	std::vector<unsigned int> nodes; //< Hierarchy node, per draw
+	std::vector<GLsizei> counts; //< Indices to draw, per draw
+	std::vector<const GLvoid*> offsets; //< Byte offset in the index buffer, per draw
+	std::vector<DrawElementsIndirectCommand> commands;
+	std::shared_ptr<GLUtils::StreamBuffer> indirect_buffer;
+	bool commands_uploaded;
+	unsigned int command_instances; //< Instance count of the commands
+	unsigned int n_culled;
+	size_t n_triangles;
+	std::vector<unsigned int> level_draws;
+
+	unsigned int built_size; //< Nodes in the hierarchy the list was built for
+	unsigned int built_indices; //< Uploaded indices the list was built for
+	bool built_per_frame; //< The list was built for one frame (culled or with levels)
+};
+
+#endif
@@ -0,0 +1,101 @@
+#ifndef _DRAWDATABUFFER_H__
+#define _DRAWDATABUFFER_H__
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "GLUtils/GLUtils.hpp"
+#include "TransformKernel.h"
+
+/**
+ * Holds the matrices of every part on the GPU, uploaded once per frame,
+ * so a draw only needs to set the draw id the shader reads them with.
+ *
+ * With UNIFORM_BUFFER the matrices go in a uniform block. A block is
+ * limited in size (16 KiB guaranteed), so the parts are split in chunks
+ * that fit, and the chunk of the part being drawn is bound as a range.
+ * With TEXTURE_BUFFER they are read with texelFetch from a buffer
+ * texture, which holds any number of parts, at the cost of slower reads
+ * on some hardware. The shader picks the matching code path through the
+ * definitions from getShaderDefines().
+ */
+class DrawDataBuffer {
+public:
+	enum Mode {
+		UNIFORM_BUFFER,
+		TEXTURE_BUFFER
+	};
+
+	DrawDataBuffer(Mode mode);
+	~DrawDataBuffer();
+
+	inline Mode getMode() const {return mode;}
+
+	/**
+	 * Preprocessor definitions the shaders need for this mode
+	 */
+	std::string getShaderDefines() const;
+
+	/**
+	 * Connects the uniform block (or buffer texture) to a linked program
+	 * built with getShaderDefines(). The program must be in use.
+	 */
+	void attachProgram(GLUtils::Program& program);
+
+	/**
+	 * Replaces the matrices of all parts with one upload
+	 */
+	void upload(const std::vector<TransformKernel::DrawTransform>& transforms);
+
+	/**
+	 * Binds what the shader needs to read the matrices. Called once per
+	 * frame, before the first selectDraw().
+	 */
+	void bind();
+
+	/**
+	 * Makes the matrices of part available to the shader and returns the
+	 * draw id that selects them. Only rebinds when the part is in another
+	 * chunk than the previous one.
+	 */
+	inline GLint selectDraw(unsigned int part) {
+		if (mode == TEXTURE_BUFFER)
+			return static_cast<GLint>(part);
+
+		unsigned int chunk = part / parts_per_chunk;
+		if (chunk != bound_chunk)
+			bindChunk(chunk);
+		return static_cast<GLint>(part - chunk * parts_per_chunk);
+	}
+
+	/**
+	 * Number of consecutive parts one draw call (with its draw ids
+	 * starting at 0 at the first part) can reach. selectDraw() on the
+	 * first of them makes them available.
+	 */
+	inline unsigned int getPartsPerCall() const {
+		return (mode == TEXTURE_BUFFER) ? ~0u : parts_per_chunk;
+	}
+
+	static const GLuint block_binding = 0; //< Uniform buffer binding point
+	static const GLint texture_unit = 0; //< Texture unit of the buffer texture
+
+private:
+	DrawDataBuffer(const DrawDataBuffer&);
+	DrawDataBuffer& operator=(const DrawDataBuffer&);
+
+	void bindChunk(unsigned int chunk);
+
+	Mode mode;
+	std::shared_ptr<GLUtils::StreamBuffer> buffer;
+	GLuint texture; //< Buffer texture, in TEXTURE_BUFFER mode
+
+	unsigned int parts_per_chunk; //< Parts in one uniform block
+	unsigned int bound_chunk; //< Chunk bound to the uniform block
+	size_t n_parts; //< Parts in the last upload
+};
+
+#endif
@@ -0,0 +1,156 @@
+#ifndef _FRAMEPROFILER_H__
+#define _FRAMEPROFILER_H__
+
+#include <deque>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "Timer.h"
+
+/**
+ * Measures every frame: the CPU time of each phase of the main loop, the
+ * GPU time of the frame, and how much was drawn. Keeps the last frames
+ * to report the median and the 95th and 99th percentile, prints them
+ * every few seconds, and can write every frame to a CSV file to compare
+ * builds.
+ *
+ * The GPU time is measured with a GL_TIME_ELAPSED query around the
+ * frame. Results are read a few frames later from a ring of queries,
+ * and only when they are available, so measuring never waits for the
+ * GPU. Frames are reported once their GPU time is known.
+ */
+class FrameProfiler {
+public:
+	/**
+	 * Parts of a frame, in the order the main loop runs them
+	 */
+	enum Phase {
+		EVENTS, //< Handling input events, or taking the latest input from the event thread
+		UPDATE, //< Model loading and the camera
+		DRAW, //< Culling, the draw list, and submitting the draws
+		SWAP, //< Swapping buffers (or waiting for the GPU with glFinish)
+		n_phases
+	};
+
+	/**
+	 * gpu_timing measures the GPU time of every frame, if the context
+	 * supports timer queries. Without it, no OpenGL calls are made.
+	 */
+	FrameProfiler(bool gpu_timing);
+	~FrameProfiler();
+
+	/**
+	 * Writes every frame to filename, as comma separated values with a
+	 * header line
+	 */
+	void openCsv(const std::string& filename);
+
+	/**
+	 * Prints the statistics to stdout every interval seconds (0 never does)
+	 */
+	inline void setPrintInterval(double interval) {print_interval = interval;}
+
+	/**
+	 * Starts a frame, in phase EVENTS
+	 */
+	void beginFrame();
+
+	/**
+	 * The loop is idle from beginIdle to endIdle, e.g. waiting for input
+	 * when frames are only drawn on demand. Idle time is left out of the
+	 * interval of the next frame, so the frame percentiles are not the
+	 * time between inputs.
+	 */
+	void beginIdle();
+	void endIdle();
+
+	/**
+	 * Ends the current phase and starts phase
+	 */
+	void beginPhase(Phase phase);
+
+	/**
+	 * Ends the frame, which made draw_calls draw calls and drew triangles
+	 */
+	void endFrame(size_t draw_calls, size_t triangles);
+
+	/**
+	 * Reports the frames still waiting for their GPU time (waiting
+	 * for it), and prints the statistics
+	 */
+	void finish();
+
+	/**
+	 * Prints the percentiles of the frames in the window
+	 */
+	void print() const;
+
+	/**
+	 * Statistics of the frames in the window, one line, for a window title
+	 */
+	std::string getSummary() const;
+
+	/**
+	 * Seconds since the previous frame started, less the idle time in
+	 * between, for motion that should not depend on the frame rate
+	 */
+	inline double getFrameInterval() const {return frame_interval;}
+
+	static const char* getPhaseName(Phase phase);
+
+	static const size_t window_size = 512; //< Frames the percentiles are computed over
+	static const unsigned int n_queries = 4; //< Frames a GPU time can be late before it is skipped
+
+private:
+	FrameProfiler(const FrameProfiler&);
+	FrameProfiler& operator=(const FrameProfiler&);
+
+	struct Frame {
+		size_t index;
+		double start; //< Seconds since the profiler was created
+		double interval; //< Milliseconds since the previous frame started, not counting idle time
+		double phases[n_phases]; //< Milliseconds
+		double cpu; //< Milliseconds, all phases
+		double gpu; //< Milliseconds, negative if not measured
+		size_t draw_calls;
+		size_t triangles;
+		int query; //< Slot in the query ring, -1 if not measured or done
+	};
+
+	/**
+	 * Reads the available query results, without waiting unless wait is set
+	 */
+	void collectQueries(bool wait);
+
+	/**
+	 * Reports the frames at the front of pending that are complete
+	 */
+	void reportFrames();
+	void report(const Frame& frame);
+
+	bool gpu_timing;
+	GLuint queries[n_queries];
+	bool query_busy[n_queries];
+	unsigned int next_query;
+
+	Timer clock;
+	double phase_start;
+	double frame_interval;
+	double idle_start; //< Negative if not idle
+	double idle; //< Seconds idle since the current frame started
+	Phase phase;
+	Frame current;
+	size_t n_frames;
+	std::deque<Frame> pending; //< Ended frames, waiting for their GPU time
+
+	std::deque<Frame> history; //< The last window_size reported frames
+
+	std::ofstream csv;
+	double print_interval;
+	double last_print;
+};
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef _FRUSTUM_H__
+#define _FRUSTUM_H__
+
+#include <glm/glm.hpp>
+
+/**
+ * The six planes of a view frustum, extracted from a clip matrix
+ * (projection * view * model). Boxes are tested in the space the clip
+ * matrix transforms from, so with the model matrix included, model
+ * space bounding boxes can be tested as they are.
+ */
+class Frustum {
+public:
+	enum Result {
+		OUTSIDE,
+		INTERSECTS,
+		INSIDE
+	};
+
+	static const unsigned int all_planes = (1 << 6) - 1;
+
+	Frustum(const glm::mat4& clip_matrix);
+
+	/**
+	 * Tests an axis-aligned box against the planes in plane_mask. On
+	 * return, plane_mask only holds the planes the box intersects: a box
+	 * inside its parent's planes does not need to test them again.
+	 */
+	Result test(const glm::vec3& min, const glm::vec3& max, unsigned int& plane_mask) const;
+
+	inline Result test(const glm::vec3& min, const glm::vec3& max) const {
+		unsigned int plane_mask = all_planes;
+		return test(min, max, plane_mask);
+	}
+
+private:
+	glm::vec4 planes[6]; //< a*x + b*y + c*z + d >= 0 inside
+};
+
+#endif
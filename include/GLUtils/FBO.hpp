@@ -0,0 +1,99 @@
+#ifndef _FBO_HPP__
+#define _FBO_HPP__
+
+#include <vector>
+#include <sstream>
+#include <algorithm>
+#include <GL/glew.h>
+
+#include "GameException.h"
+
+namespace GLUtils {
+
+/**
+ * Offscreen render target with an RGBA color buffer and a depth buffer
+ */
+class FBO {
+public:
+	FBO(unsigned int width, unsigned int height) {
+		this->width = width;
+		this->height = height;
+
+		glGenRenderbuffers(1, &color_name);
+		glBindRenderbuffer(GL_RENDERBUFFER, color_name);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+
+		glGenRenderbuffers(1, &depth_name);
+		glBindRenderbuffer(GL_RENDERBUFFER, depth_name);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+		glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+		glGenFramebuffers(1, &fbo_name);
+		bind();
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color_name);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth_name);
+		GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+		unbind();
+
+		if (status != GL_FRAMEBUFFER_COMPLETE) {
+			std::stringstream err;
+			err << "Framebuffer incomplete: 0x" << std::hex << status;
+			THROW_EXCEPTION(err.str());
+		}
+	}
+
+	~FBO() {
+		glDeleteFramebuffers(1, &fbo_name);
+		glDeleteRenderbuffers(1, &depth_name);
+		glDeleteRenderbuffers(1, &color_name);
+	}
+
+	inline void bind() {
+		glBindFramebuffer(GL_FRAMEBUFFER, fbo_name);
+	}
+
+	static inline void unbind() {
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+
+	/**
+	 * Reads the color buffer as tightly packed RGB rows, top row first
+	 */
+	inline void readPixels(std::vector<unsigned char>& pixels) {
+		size_t row_bytes = 3 * width;
+		pixels.resize(row_bytes * height);
+
+		bind();
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, &pixels[0]);
+
+		// OpenGL returns the bottom row first
+		std::vector<unsigned char> row(row_bytes);
+		for (unsigned int y=0; y<height/2; ++y) {
+			unsigned char* top = &pixels[y * row_bytes];
+			unsigned char* bottom = &pixels[(height - 1 - y) * row_bytes];
+			std::copy(top, top + row_bytes, row.begin());
+			std::copy(bottom, bottom + row_bytes, top);
+			std::copy(row.begin(), row.end(), bottom);
+		}
+	}
+
+	inline GLuint name() {
+		return fbo_name;
+	}
+
+	inline unsigned int getWidth() {return width;}
+	inline unsigned int getHeight() {return height;}
+
+private:
+	FBO() {}
+	GLuint fbo_name; //< Framebuffer name
+	GLuint color_name; //< Color renderbuffer name
+	GLuint depth_name; //< Depth renderbuffer name
+	unsigned int width;
+	unsigned int height;
+};
+
+};//namespace GLUtils
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef _IBO_HPP__
+#define _IBO_HPP__
+
+#include <GL/glew.h>
+
+namespace GLUtils {
+
+/**
+ * Element (index) buffer. The binding of GL_ELEMENT_ARRAY_BUFFER is
+ * part of the vertex array object state, so bind() should be called
+ * while the VAO that uses the indices is bound.
+ */
+class IBO {
+public:
+	IBO(const void* data, unsigned int bytes, GLenum type, int usage=GL_STATIC_DRAW) {
+		index_type = type;
+		glGenBuffers(1, &ibo_name);
+		// Upload through the copy target, so that we do not touch
+		// the element array binding of whatever VAO is currently bound
+		glBindBuffer(GL_COPY_WRITE_BUFFER, ibo_name);
+		glBufferData(GL_COPY_WRITE_BUFFER, bytes, data, usage);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	}
+
+	~IBO() {
+		glDeleteBuffers(1, &ibo_name);
+	}
+
+	inline void bind() {
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo_name);
+	}
+
+	/**
+	 * Replaces bytes bytes of the buffer, starting at offset
+	 */
+	inline void update(const void* data, unsigned int offset, unsigned int bytes) {
+		glBindBuffer(GL_COPY_WRITE_BUFFER, ibo_name);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, offset, bytes, data);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	}
+
+	inline GLuint name() {
+		return ibo_name;
+	}
+
+	/**
+	 * GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+	 */
+	inline GLenum type() {
+		return index_type;
+	}
+
+	/**
+	 * Size of one index in bytes
+	 */
+	inline unsigned int indexSize() {
+		return (index_type == GL_UNSIGNED_SHORT) ? 2 : 4;
+	}
+
+private:
+	IBO() {}
+	GLuint ibo_name; //< IBO name
+	GLenum index_type; //< Type of the indices stored in the buffer
+};
+
+};//namespace GLUtils
+
+#endif
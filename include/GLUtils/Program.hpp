@@ -1,125 +1,298 @@
-#ifndef _PROGRAM_HPP__
-#define _PROGRAM_HPP__
-
-#include "GameException.h"
-
-#include <string>
-#include <sstream>
-#include <vector>
-
-#include <GL/glew.h>
-
-namespace GLUtils {
-
-class Program {
-public:
-	Program(std::string vs, std::string fs) {
-		name = glCreateProgram();
-		attachShader(vs, GL_VERTEX_SHADER);
-		attachShader(fs, GL_FRAGMENT_SHADER);
-		link();
-	}
-
-	Program(std::string vs, std::string gs, std::string fs) {
-		name = glCreateProgram();
-		attachShader(vs, GL_VERTEX_SHADER);
-		attachShader(gs, GL_GEOMETRY_SHADER);
-		attachShader(fs, GL_FRAGMENT_SHADER);
-		link();
-	}
-
-	inline void use() {
-		glUseProgram(name);
-	}
-
-	static inline void disuse() {
-		glUseProgram(0);
-	}
-
-	inline GLint getUniform(std::string var) {
-		GLint loc = glGetUniformLocation(name, var.c_str());
-		assert(loc >= 0);
-		return loc;
-	}
-
-	inline void setAttributePointer(std::string var, unsigned int size, GLenum type=GL_FLOAT, GLboolean normalized=GL_FALSE, GLsizei stride=0, GLvoid* pointer=NULL) {
-		GLint loc = glGetAttribLocation(name, var.c_str());
-		assert(loc >= 0);
-		glVertexAttribPointer(loc, size, type, normalized, stride, pointer);
-		glEnableVertexAttribArray(loc);
-	}
-
-private:
-	void link() {
-		std::stringstream log;
-		glLinkProgram(name);
-
-		// check for errors
-		GLint linkstatus;
-		glGetProgramiv(name, GL_LINK_STATUS, &linkstatus);
-		if (linkstatus != GL_TRUE) {
-			log << "Linking failed!" << std::endl;
-
-			GLint logsize;
-			glGetProgramiv(name, GL_INFO_LOG_LENGTH, &logsize);
-
-			if (logsize > 0) {
-				std::vector < GLchar > infolog(logsize + 1);
-				glGetProgramInfoLog(name, logsize, NULL, &infolog[0]);
-				log << "--- error log ---" << std::endl;
-				log << std::string(infolog.begin(), infolog.end()) << std::endl;
-			} else {
-				log << "--- empty log message ---" << std::endl;
-			}
-			THROW_EXCEPTION(log.str());
-		}
-	}
-
-	void attachShader(std::string& src, unsigned int type) {
-		std::stringstream log;
-		// create shader object
-		GLuint s = glCreateShader(type);
-		if (s == 0) {
-			log << "Failed to create shader of type " << type << std::endl;
-			THROW_EXCEPTION(log.str());
-		}
-
-		// set source code and compile
-		const GLchar* src_list[1] = { src.c_str() };
-		glShaderSource(s, 1, src_list, NULL);
-		glCompileShader(s);
-
-		// check for errors
-		GLint compile_status;
-		glGetShaderiv(s, GL_COMPILE_STATUS, &compile_status);
-		if (compile_status != GL_TRUE) {
-			// compilation failed
-			log << "Compilation failed!" << std::endl;
-			log << "--- source code ---" << std::endl;
-			log << src << std::endl;
-
-			GLint logsize;
-			glGetShaderiv(s, GL_INFO_LOG_LENGTH, &logsize);
-
-			if (logsize > 0) {
-				std::vector<GLchar> infolog(logsize + 1);
-				glGetShaderInfoLog(s, logsize, NULL, &infolog[0]);
-
-				log << "--- error log ---" << std::endl;
-				log << std::string(infolog.begin(), infolog.end()) << std::endl;
-			} else {
-				log << "--- empty log message ---" << std::endl;
-			}
-			THROW_EXCEPTION(log.str());
-		}
-		
-		glAttachShader(name, s);
-	}
-
-	GLuint name; //< OpenGL shader program
-
-};
-
-}; //Namespace GLUtils
-
+#ifndef _PROGRAM_HPP__
+#define _PROGRAM_HPP__
+
+#include "GameException.h"
+
+#include <string>
+#include <sstream>
+#include <vector>
+#include <algorithm>
+#include <assert.h>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+namespace GLUtils {
+
+/**
+ * Location of a uniform of type T, resolved once (Program::getUniformHandle)
+ * so setting it does not look up the name. Setting an invalid handle
+ * (location -1, e.g. a uniform the compiler optimized away) does nothing.
+ */
+template <typename T>
+class Uniform {
+public:
+	Uniform() : location(-1) {}
+	explicit Uniform(GLint location) : location(location) {}
+
+	/**
+	 * Sets the uniform of the program in use
+	 */
+	inline void set(const T& value) const;
+
+	inline GLint getLocation() const {return location;}
+	inline bool isValid() const {return location >= 0;}
+
+	/**
+	 * True if a uniform declared with the GLSL type gl_type can be set as a T
+	 */
+	static inline bool matches(GLenum gl_type);
+
+private:
+	GLint location;
+};
+
+template <> inline void Uniform<GLfloat>::set(const GLfloat& value) const {glUniform1f(location, value);}
+template <> inline void Uniform<GLint>::set(const GLint& value) const {glUniform1i(location, value);}
+template <> inline void Uniform<GLuint>::set(const GLuint& value) const {glUniform1ui(location, value);}
+template <> inline void Uniform<glm::vec3>::set(const glm::vec3& value) const {glUniform3fv(location, 1, glm::value_ptr(value));}
+template <> inline void Uniform<glm::vec4>::set(const glm::vec4& value) const {glUniform4fv(location, 1, glm::value_ptr(value));}
+template <> inline void Uniform<glm::mat3>::set(const glm::mat3& value) const {glUniformMatrix3fv(location, 1, 0, glm::value_ptr(value));}
+template <> inline void Uniform<glm::mat4>::set(const glm::mat4& value) const {glUniformMatrix4fv(location, 1, 0, glm::value_ptr(value));}
+
+template <> inline bool Uniform<GLfloat>::matches(GLenum gl_type) {return gl_type == GL_FLOAT;}
+template <> inline bool Uniform<GLuint>::matches(GLenum gl_type) {return gl_type == GL_UNSIGNED_INT;}
+template <> inline bool Uniform<glm::vec3>::matches(GLenum gl_type) {return gl_type == GL_FLOAT_VEC3;}
+template <> inline bool Uniform<glm::vec4>::matches(GLenum gl_type) {return gl_type == GL_FLOAT_VEC4;}
+template <> inline bool Uniform<glm::mat3>::matches(GLenum gl_type) {return gl_type == GL_FLOAT_MAT3;}
+template <> inline bool Uniform<glm::mat4>::matches(GLenum gl_type) {return gl_type == GL_FLOAT_MAT4;}
+template <> inline bool Uniform<GLint>::matches(GLenum gl_type) {
+	// Samplers are set as texture unit numbers
+	switch (gl_type) {
+	case GL_INT: case GL_BOOL:
+	case GL_SAMPLER_1D: case GL_SAMPLER_2D: case GL_SAMPLER_3D: case GL_SAMPLER_CUBE:
+	case GL_SAMPLER_2D_SHADOW: case GL_SAMPLER_2D_ARRAY: case GL_SAMPLER_BUFFER:
+	case GL_INT_SAMPLER_BUFFER: case GL_UNSIGNED_INT_SAMPLER_BUFFER:
+		return true;
+	default:
+		return false;
+	}
+}
+
+class Program {
+public:
+	Program(std::string vs, std::string fs) {
+		name = glCreateProgram();
+		attachShader(vs, GL_VERTEX_SHADER);
+		attachShader(fs, GL_FRAGMENT_SHADER);
+		link();
+	}
+
+	Program(std::string vs, std::string gs, std::string fs) {
+		name = glCreateProgram();
+		attachShader(vs, GL_VERTEX_SHADER);
+		attachShader(gs, GL_GEOMETRY_SHADER);
+		attachShader(fs, GL_FRAGMENT_SHADER);
+		link();
+	}
+
+	inline void use() {
+		glUseProgram(name);
+	}
+
+	static inline void disuse() {
+		glUseProgram(0);
+	}
+
+	/**
+	 * Location of an active uniform. Looked up in the table built
+	 * after linking, so it never calls into the driver, but hot code
+	 * should still resolve a handle once with getUniformHandle().
+	 */
+	inline GLint getUniform(const std::string& var) {
+		const Variable* variable = find(uniforms, var);
+		assert(variable != NULL);
+		return (variable != NULL) ? variable->location : -1;
+	}
+
+	/**
+	 * Typed handle to a uniform. Throws a GameException if the uniform
+	 * is active but its type does not match T. The handle is invalid
+	 * if the uniform is not active.
+	 */
+	template <typename T>
+	inline Uniform<T> getUniformHandle(const std::string& var) {
+		const Variable* variable = find(uniforms, var);
+		if (variable == NULL)
+			return Uniform<T>();
+		if (!Uniform<T>::matches(variable->type))
+			THROW_EXCEPTION("Uniform " + var + " is used with the wrong type");
+		return Uniform<T>(variable->location);
+	}
+
+	/**
+	 * Location of an active vertex attribute
+	 */
+	inline GLint getAttribute(const std::string& var) {
+		const Variable* variable = find(attributes, var);
+		assert(variable != NULL);
+		return (variable != NULL) ? variable->location : -1;
+	}
+
+	/**
+	 * Connects a uniform block to the binding point buffers are bound to
+	 * (with glBindBufferBase/Range). Throws a GameException if the program
+	 * has no such block.
+	 */
+	inline void setUniformBlockBinding(const std::string& block, GLuint binding) {
+		GLuint index = glGetUniformBlockIndex(name, block.c_str());
+		if (index == GL_INVALID_INDEX)
+			THROW_EXCEPTION("No uniform block " + block);
+		glUniformBlockBinding(name, index, binding);
+	}
+
+	inline void setAttributePointer(const std::string& var, unsigned int size, GLenum type=GL_FLOAT, GLboolean normalized=GL_FALSE, GLsizei stride=0, GLvoid* pointer=NULL) {
+		GLint loc = getAttribute(var);
+		glVertexAttribPointer(loc, size, type, normalized, stride, pointer);
+		glEnableVertexAttribArray(loc);
+	}
+
+private:
+	/**
+	 * An active uniform or attribute, as reported after linking
+	 */
+	struct Variable {
+		std::string name;
+		GLint location;
+		GLenum type;
+		GLint size; //< Number of elements, for arrays
+
+		inline bool operator<(const Variable& other) const {return name < other.name;}
+	};
+
+	static inline const Variable* find(const std::vector<Variable>& variables, const std::string& var) {
+		Variable key;
+		key.name = var;
+		std::vector<Variable>::const_iterator it = std::lower_bound(variables.begin(), variables.end(), key);
+		if (it == variables.end() || it->name != var)
+			return NULL;
+		return &(*it);
+	}
+
+	/**
+	 * Fills the uniform and attribute tables with all the active
+	 * variables of the linked program, sorted by name
+	 */
+	void introspect() {
+		GLint count, max_length;
+
+		uniforms.clear();
+		glGetProgramiv(name, GL_ACTIVE_UNIFORMS, &count);
+		glGetProgramiv(name, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_length);
+		std::vector<GLchar> buffer(std::max(max_length, 1));
+		for (GLint i=0; i<count; ++i) {
+			Variable variable;
+			GLsizei length = 0;
+			glGetActiveUniform(name, i, static_cast<GLsizei>(buffer.size()), &length, &variable.size, &variable.type, &buffer[0]);
+			variable.name = stripArraySuffix(std::string(&buffer[0], length));
+			variable.location = glGetUniformLocation(name, &buffer[0]);
+			// Uniforms in uniform blocks have no location
+			if (variable.location >= 0)
+				uniforms.push_back(variable);
+		}
+		std::sort(uniforms.begin(), uniforms.end());
+
+		attributes.clear();
+		glGetProgramiv(name, GL_ACTIVE_ATTRIBUTES, &count);
+		glGetProgramiv(name, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &max_length);
+		buffer.resize(std::max(max_length, 1));
+		for (GLint i=0; i<count; ++i) {
+			Variable variable;
+			GLsizei length = 0;
+			glGetActiveAttrib(name, i, static_cast<GLsizei>(buffer.size()), &length, &variable.size, &variable.type, &buffer[0]);
+			variable.name = stripArraySuffix(std::string(&buffer[0], length));
+			variable.location = glGetAttribLocation(name, &buffer[0]);
+			// Built-ins like gl_VertexID have no location
+			if (variable.location >= 0)
+				attributes.push_back(variable);
+		}
+		std::sort(attributes.begin(), attributes.end());
+	}
+
+	/**
+	 * Arrays are reported as "name[0]", but looked up as "name"
+	 */
+	static inline std::string stripArraySuffix(const std::string& var) {
+		if (var.size() > 3 && var.compare(var.size() - 3, 3, "[0]") == 0)
+			return var.substr(0, var.size() - 3);
+		return var;
+	}
+
+	void link() {
+		std::stringstream log;
+		glLinkProgram(name);
+
+		// check for errors
+		GLint linkstatus;
+		glGetProgramiv(name, GL_LINK_STATUS, &linkstatus);
+		if (linkstatus != GL_TRUE) {
+			log << "Linking failed!" << std::endl;
+
+			GLint logsize;
+			glGetProgramiv(name, GL_INFO_LOG_LENGTH, &logsize);
+
+			if (logsize > 0) {
+				std::vector < GLchar > infolog(logsize + 1);
+				glGetProgramInfoLog(name, logsize, NULL, &infolog[0]);
+				log << "--- error log ---" << std::endl;
+				log << std::string(infolog.begin(), infolog.end()) << std::endl;
+			} else {
+				log << "--- empty log message ---" << std::endl;
+			}
+			THROW_EXCEPTION(log.str());
+		}
+
+		introspect();
+	}
+
+	void attachShader(std::string& src, unsigned int type) {
+		std::stringstream log;
+		// create shader object
+		GLuint s = glCreateShader(type);
+		if (s == 0) {
+			log << "Failed to create shader of type " << type << std::endl;
+			THROW_EXCEPTION(log.str());
+		}
+
+		// set source code and compile
+		const GLchar* src_list[1] = { src.c_str() };
+		glShaderSource(s, 1, src_list, NULL);
+		glCompileShader(s);
+
+		// check for errors
+		GLint compile_status;
+		glGetShaderiv(s, GL_COMPILE_STATUS, &compile_status);
+		if (compile_status != GL_TRUE) {
+			// compilation failed
+			log << "Compilation failed!" << std::endl;
+			log << "--- source code ---" << std::endl;
+			log << src << std::endl;
+
+			GLint logsize;
+			glGetShaderiv(s, GL_INFO_LOG_LENGTH, &logsize);
+
+			if (logsize > 0) {
+				std::vector<GLchar> infolog(logsize + 1);
+				glGetShaderInfoLog(s, logsize, NULL, &infolog[0]);
+
+				log << "--- error log ---" << std::endl;
+				log << std::string(infolog.begin(), infolog.end()) << std::endl;
+			} else {
+				log << "--- empty log message ---" << std::endl;
+			}
+			THROW_EXCEPTION(log.str());
+		}
+		
+		glAttachShader(name, s);
+	}
+
+	GLuint name; //< OpenGL shader program
+	std::vector<Variable> uniforms; //< Active uniforms, sorted by name
+	std::vector<Variable> attributes; //< Active attributes, sorted by name
+
+};
+
+}; //Namespace GLUtils
+
 #endif
\ No newline at end of file
@@ -0,0 +1,85 @@
+#ifndef _STREAMBUFFER_HPP__
+#define _STREAMBUFFER_HPP__
+
+#include <cstddef>
+#include <algorithm>
+#include <GL/glew.h>
+
+namespace GLUtils {
+
+/**
+ * Buffer object whose whole contents are replaced every frame. Each
+ * upload orphans the old storage first, so the driver can hand out
+ * fresh memory instead of waiting for the GPU to finish reading the
+ * previous frame's data.
+ */
+class StreamBuffer {
+public:
+	StreamBuffer(GLenum target) : target(target), capacity(0) {
+		glGenBuffers(1, &buffer_name);
+	}
+
+	~StreamBuffer() {
+		glDeleteBuffers(1, &buffer_name);
+	}
+
+	/**
+	 * Replaces the contents with bytes bytes of data. The storage only
+	 * grows, so it can be bound with ranges computed for a larger upload.
+	 */
+	inline void upload(const void* data, size_t bytes) {
+		bind();
+		if (bytes > capacity)
+			capacity = std::max(bytes, 2 * capacity);
+		glBufferData(target, capacity, NULL, GL_STREAM_DRAW);
+		if (bytes > 0)
+			glBufferSubData(target, 0, bytes, data);
+		unbind();
+	}
+
+	/**
+	 * Makes sure the storage is at least bytes large
+	 */
+	inline void reserve(size_t bytes) {
+		if (bytes <= capacity)
+			return;
+		capacity = bytes;
+		bind();
+		glBufferData(target, capacity, NULL, GL_STREAM_DRAW);
+		unbind();
+	}
+
+	inline void bind() {
+		glBindBuffer(target, buffer_name);
+	}
+
+	inline void unbind() {
+		glBindBuffer(target, 0);
+	}
+
+	/**
+	 * Binds part of the buffer to an indexed binding point
+	 * (GL_UNIFORM_BUFFER buffers)
+	 */
+	inline void bindRange(GLuint index, size_t offset, size_t bytes) {
+		glBindBufferRange(target, index, buffer_name, offset, bytes);
+	}
+
+	inline GLuint name() {
+		return buffer_name;
+	}
+
+	inline size_t getCapacity() {
+		return capacity;
+	}
+
+private:
+	StreamBuffer() {}
+	GLuint buffer_name; //< Buffer name
+	GLenum target;
+	size_t capacity; //< Bytes of storage
+};
+
+};//namespace GLUtils
+
+#endif
@@ -1,41 +1,50 @@
-#ifndef _VBO_HPP__
-#define _VBO_HPP__
-
-#include <GL/glew.h>
-
-namespace GLUtils {
-
-class VBO {
-public:
-	VBO(const void* data, unsigned int bytes, int usage=GL_STATIC_DRAW) {
-		glGenBuffers(1, &vbo_name);
-		bind();
-		glBufferData(GL_ARRAY_BUFFER, bytes, data, usage);
-		unbind();
-	}
-
-	~VBO() {
-		unbind();
-		glDeleteBuffers(1, &vbo_name);
-	}
-
-	inline void bind() {
-		glBindBuffer(GL_ARRAY_BUFFER, vbo_name);
-	}
-
-	static inline void unbind() {
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
-	}
-
-	inline GLuint name() {
-		return vbo_name;
-	}
-
-private:
-	VBO() {}
-	GLuint vbo_name; //< VBO name
-};
-
-};//namespace GLUtils
-
+#ifndef _VBO_HPP__
+#define _VBO_HPP__
+
+#include <GL/glew.h>
+
+namespace GLUtils {
+
+class VBO {
+public:
+	VBO(const void* data, unsigned int bytes, int usage=GL_STATIC_DRAW) {
+		glGenBuffers(1, &vbo_name);
+		bind();
+		glBufferData(GL_ARRAY_BUFFER, bytes, data, usage);
+		unbind();
+	}
+
+	~VBO() {
+		unbind();
+		glDeleteBuffers(1, &vbo_name);
+	}
+
+	inline void bind() {
+		glBindBuffer(GL_ARRAY_BUFFER, vbo_name);
+	}
+
+	static inline void unbind() {
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	/**
+	 * Replaces bytes bytes of the buffer, starting at offset
+	 */
+	inline void update(const void* data, unsigned int offset, unsigned int bytes) {
+		bind();
+		glBufferSubData(GL_ARRAY_BUFFER, offset, bytes, data);
+		unbind();
+	}
+
+	inline GLuint name() {
+		return vbo_name;
+	}
+
+private:
+	VBO() {}
+	GLuint vbo_name; //< VBO name
+};
+
+};//namespace GLUtils
+
 #endif
\ No newline at end of file
@@ -1,117 +1,415 @@
-#ifndef _GAMEMANAGER_H_
-#define _GAMEMANAGER_H_
-
-#include <memory>
-
-#include <GL/glew.h>
-#include <SDL.h>
-#include <glm/glm.hpp>
-
-#include "Timer.h"
-#include "GLUtils/GLUtils.hpp"
-#include "Model.h"
-#include "VirtualTrackball.h"
-
-
-/**
- * This class handles the game logic and display.
- * Uses SDL as the display manager, and glm for 
- * vector and matrix computations
- */
-class GameManager {
-public:
-
-	/**
-	 * Constructor
-	 */
-	GameManager(std::string model);
-
-	/**
-	 * Destructor
-	 */
-	~GameManager();
-
-	/**
-	 * Initializes the game, including the OpenGL context
-	 * and data required
-	 */
-	void init();
-
-	/**
-	 * The main loop of the game. Runs the SDL main loop
-	 */
-	void play();
-
-	/**
-	 * Quit function
-	 */
-	void quit();
-
-	/**
-	 * Function that handles rendering into the OpenGL context
-	 */
-	void render();
-
-protected:
-	/**
-	 * Creates the OpenGL context using SDL
-	 */
-	void createOpenGLContext();
-
-	/**
-	 * Sets states for OpenGL that we want to keep persistent
-	 * throughout the game
-	 */
-	void setOpenGLStates();
-
-	/**
-	 * Creates the matrices for the OpenGL transformations,
-	 * perspective, etc.
-	 */
-	void createMatrices();
-
-	/**
-	 * Compiles, attaches, links, and sets uniforms for
-	 * a simple OpenGL program
-	 */
-	void createSimpleProgram();
-
-	/**
-	 * Creates vertex array objects
-	 */
-	void createVAO();
-
-	static const unsigned int window_width = 800;
-	static const unsigned int window_height = 600;
-
-private:
-	static void renderMeshRecursive(MeshPart& mesh, const std::shared_ptr<GLUtils::Program>& program, const glm::mat4& modelview, const glm::mat4& transform);
-
-	GLuint vao; //< Vertex array object
-	//GLuint vertex_vbo; //< VBO for vertex data
-	std::shared_ptr<GLUtils::VBO> vertices, normals;
-	//GLuint program; //< OpenGL shader program
-	std::shared_ptr<GLUtils::Program> program;
-
-	std::shared_ptr<Model> model;
-
-	Timer my_timer; //< Timer for machine independent motion
-
-	std::string m_model;
-
-	glm::mat4 projection_matrix; //< OpenGL projection matrix
-	glm::mat4 model_matrix; //< OpenGL model transformation matrix
-	glm::mat4 view_matrix; //< OpenGL camera/view matrix
-	glm::mat3 normal_matrix; //< OpenGL matrix to transfor normals
-	glm::mat4 trackball_view_matrix; //< OpenGL camera matrix for the trackball
-
-	float m_zoom; // Used when zooming (changing fov)
-	float m_zoom_sensitivity; // Also used when zooming (changing fov)
-	float m_fov;
-	
-	VirtualTrackball trackball;
-	SDL_Window* main_window; //< Our window handle
-	SDL_GLContext main_context; //< Our opengl context handle 
-};
-
-#endif // _GAMEMANAGER_H_
+#ifndef _GAMEMANAGER_H_
+#define _GAMEMANAGER_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <future>
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+#include <SDL.h>
+#include <glm/glm.hpp>
+
+#include "Timer.h"
+#include "HeadlessContext.h"
+#include "GLUtils/GLUtils.hpp"
+#include "Model.h"
+#include "TransformKernel.h"
+#include "DrawDataBuffer.h"
+#include "DrawBatch.h"
+#include "BoundingVolumeHierarchy.h"
+#include "LevelOfDetail.h"
+#include "VirtualTrackball.h"
+#include "SoftwareRenderer.h"
+#include "FrameProfiler.h"
+#include "TripleBuffer.h"
+#include "Scene.h"
+
+
+/**
+ * Settings for how the model is drawn
+ */
+struct RenderOptions {
+	RenderOptions() {
+		draw_data_mode = DrawDataBuffer::UNIFORM_BUFFER;
+		batched = true;
+		culling = true;
+		lod = true;
+		lod_tolerance = 1.0f;
+		software = false;
+		render_threads = 0;
+		profile_interval = 5.0;
+		continuous = false;
+		max_fps = 0.0;
+		swap_interval = 1;
+		render_thread = true;
+	}
+
+	DrawDataBuffer::Mode draw_data_mode; //< How the per part matrices reach the shader
+	bool batched; //< Draw all parts with multi-draw calls, if supported (toggled with B)
+	bool culling; //< Skip parts outside the view frustum (toggled with C)
+	bool lod; //< Draw parts at a coarser level of detail when it is not visible (toggled with L)
+	float lod_tolerance; //< Largest error of a level of detail on the screen, in pixels
+	bool software; //< Render on the CPU with SoftwareRenderer instead of OpenGL (headless only)
+	unsigned int render_threads; //< Threads of the software renderer, 0 means one per hardware thread
+	std::string profile_csv; //< Writes the profile of every frame to this file, if not empty
+	double profile_interval; //< Seconds between the frame statistics printed to stdout, 0 for never
+	bool continuous; //< Draw frames back to back, instead of only when the view changes (profiles the frame rate)
+	double max_fps; //< Most frames per second drawn in the window, 0 leaves the pace to vsync
+	int swap_interval; //< Vsync: 1 waits for the vertical blank, 0 does not, -1 is adaptive (late frames do not wait)
+	bool render_thread; //< Draw on a thread of its own, so input is handled while a frame is drawn
+};
+
+/**
+ * This class handles the game logic and display.
+ * Uses SDL as the display manager, and glm for 
+ * vector and matrix computations
+ */
+class GameManager {
+public:
+
+	/**
+	 * Constructor. model is a model file, or a scene file (.scene) with
+	 * many instances of a few models, see Scene. Throws a GameException
+	 * if the scene file cannot be read.
+	 */
+	GameManager(std::string model, const LoadOptions& load_options=LoadOptions(), const RenderOptions& render_options=RenderOptions());
+
+	/**
+	 * Destructor
+	 */
+	~GameManager();
+
+	/**
+	 * Initializes the game, including the OpenGL context
+	 * and data required
+	 */
+	void init();
+
+	/**
+	 * Initializes the game without a window, rendering into an
+	 * offscreen framebuffer of a headless (EGL) OpenGL context
+	 */
+	void initHeadless();
+
+	/**
+	 * Initializes the game without a window or OpenGL, rendering
+	 * with the SoftwareRenderer on the CPU. Used instead of
+	 * initHeadless() on machines without a GPU.
+	 */
+	void initSoftware();
+
+	/**
+	 * The main loop of the game. Runs the SDL main loop. Unless
+	 * RenderOptions::continuous is set, it sleeps in SDL_WaitEvent
+	 * until something changes the view, and only then draws a frame.
+	 * With RenderOptions::render_thread, the frames are drawn on a
+	 * thread of their own, see playThreaded().
+	 */
+	void play();
+
+	/**
+	 * Waits for the model to load, then renders n_frames frames of
+	 * a trackball orbit and prints frame time statistics. Requires
+	 * initHeadless() or initSoftware(). If frame_prefix is not empty, every frame is
+	 * saved as <frame_prefix>NNNN.ppm.
+	 */
+	void playHeadless(unsigned int n_frames, const std::string& frame_prefix="");
+
+	/**
+	 * Quit function
+	 */
+	void quit();
+
+	/**
+	 * Function that handles rendering into the OpenGL context
+	 */
+	void render();
+
+protected:
+	/**
+	 * Creates the OpenGL context using SDL
+	 */
+	void createOpenGLContext();
+
+	/**
+	 * Sets states for OpenGL that we want to keep persistent
+	 * throughout the game
+	 */
+	void setOpenGLStates();
+
+	/**
+	 * Creates the matrices for the OpenGL transformations,
+	 * perspective, etc.
+	 */
+	void createMatrices();
+
+	/**
+	 * Compiles, attaches, links, and sets uniforms for
+	 * a simple OpenGL program
+	 */
+	void createSimpleProgram();
+
+	/**
+	 * Creates vertex array objects, and starts loading the
+	 * model on a background thread
+	 */
+	void createVAO();
+
+	/**
+	 * Starts loading the model, or every model of the scene, on a
+	 * background thread. The models of a scene are loaded one after
+	 * another, as each already prepares its meshes on a pool of
+	 * threads.
+	 */
+	void startModelLoading();
+
+	/**
+	 * Called once per frame: creates the model when the loader
+	 * thread is done, and uploads the next chunk of it. Returns true
+	 * if more of the model can be drawn than before.
+	 */
+	bool updateModelLoading();
+
+	/**
+	 * updateModelLoading() of a scene: the models are created as their
+	 * loader threads finish, and uploaded one chunk of one model per frame
+	 */
+	bool updateSceneLoading();
+
+	/**
+	 * Sets up the vertex attributes and index buffer of
+	 * model in the vertex array object vao
+	 */
+	void attachModel(GLuint vao, Model& model);
+
+	/**
+	 * Creates the frame profiler, measuring GPU times if gpu_timing
+	 */
+	void createProfiler(bool gpu_timing);
+
+	/**
+	 * Sets the swap interval, and the frame period from
+	 * RenderOptions::max_fps
+	 */
+	void setupFramePacing();
+
+	/**
+	 * What input changes about the frames: the camera and the toggles.
+	 * Input events change the copy of the event thread, and frames are
+	 * drawn with the latest snapshot of it.
+	 */
+	struct ViewState {
+		glm::mat4 trackball_view_matrix;
+		float fov;
+		bool batched;
+		bool culling;
+		bool lod;
+	};
+
+	/**
+	 * Applies an input or window event to the input state. Returns
+	 * false if it asks to quit.
+	 */
+	bool handleEvent(const SDL_Event& event);
+
+	/**
+	 * Draws the next frames with state, printing the toggles that changed
+	 */
+	void applyViewState(const ViewState& state);
+
+	/**
+	 * The main loop with a render thread: this (the event) thread sleeps
+	 * in SDL_WaitEvent, applies the events, and publishes snapshots of
+	 * the input state. The render thread owns the OpenGL context and draws
+	 * every frame with the latest snapshot, so a slow frame does not hold
+	 * up input, and a burst of input does not hold up a frame. While the
+	 * render thread has not taken the last snapshot, the events only
+	 * change the input state, and the trackball is turned and a snapshot
+	 * published once the render thread takes it.
+	 */
+	void playThreaded();
+
+	/**
+	 * Hands a snapshot of the input state to the render thread, and wakes it
+	 */
+	void publishViewState();
+
+	/**
+	 * The loop of the render thread, until stop_rendering is set
+	 */
+	void renderLoop();
+
+	/**
+	 * Sleeps on the render thread until there is something new to draw: a
+	 * snapshot of the input, or more of the model. Returns false when
+	 * rendering should stop.
+	 */
+	bool waitForSnapshot();
+
+	/**
+	 * Whether the next frame shows more of the model: it is being
+	 * uploaded, or the loader thread just finished it
+	 */
+	bool hasModelUpdate();
+
+	/**
+	 * Continues loading the model, renders, and swaps the buffers, after
+	 * FrameProfiler::beginFrame()
+	 */
+	void drawFrame();
+
+	/**
+	 * Turns the trackball of the input state to the last mouse position
+	 * of a drag, if the mouse moved since it was last turned. Mouse motion
+	 * events only record the position, so the trackball is turned once
+	 * per frame (or snapshot) however many events came in.
+	 */
+	void applyMouseMotion();
+
+	/**
+	 * Sleeps until there is something new to draw: an event that changes
+	 * the view, or more of the model. Returns false if an event asks to quit.
+	 */
+	bool waitForRedraw();
+
+	/**
+	 * Sleeps until the next frame is due with RenderOptions::max_fps.
+	 * next_frame is when it is due, in nanoseconds of Timer::getNanoseconds().
+	 */
+	void paceFrame(uint64_t& next_frame);
+
+	static const unsigned int window_width = 800;
+	static const unsigned int window_height = 600;
+	static const size_t upload_bytes_per_frame = 4 << 20; //< Limits the stall per frame while uploading
+	static const int loading_poll_ms = 10; //< How often an idle window checks on the model loader thread
+
+private:
+	void saveFrame(const std::string& filename, const std::vector<unsigned char>& pixels);
+
+	/**
+	 * Uniforms of the program, resolved once after linking
+	 */
+	struct Uniforms {
+		GLUtils::Uniform<glm::mat4> projection_matrix;
+		GLUtils::Uniform<GLint> draw_id;
+		GLUtils::Uniform<glm::mat4> view_matrix; //< Only in the program for scenes
+	};
+
+	/**
+	 * A model of the scene, loaded and uploaded once for all its
+	 * instances. The instances are drawn together, with their model
+	 * matrices in a per instance vertex attribute.
+	 */
+	struct SceneAsset {
+		SceneAsset() : uploaded(false), vao(0) {}
+
+		std::shared_ptr<Model> model;
+		std::shared_ptr<PreparedModel> software_model; //< The model in software mode
+		std::future<std::shared_ptr<PreparedModel> > loader;
+		bool uploaded;
+		GLuint vao; //< The model and the instance matrices
+		std::shared_ptr<GLUtils::VBO> instance_matrices;
+		std::shared_ptr<DrawBatch> draw_batch; //< Parts of the model, drawn for every instance
+	};
+
+	/**
+	 * Draws every part of the model that is inside the view frustum, at
+	 * the coarsest level of detail that is within the tolerance, in
+	 * one linear sweep. Parts (or the ends of them) that are not uploaded
+	 * yet are not drawn.
+	 */
+	void renderMeshParts(const glm::mat4& view_matrix);
+
+	/**
+	 * Draws all instances of every (partly) uploaded model of the scene,
+	 * each part with one instanced draw, or one multi-draw call per model
+	 * when batched. Instances are not culled, and drawn at the full level
+	 * of detail.
+	 */
+	void renderScene(const glm::mat4& view_matrix);
+
+	/**
+	 * Adds the instance matrices of asset to its vertex array object
+	 */
+	void attachInstances(SceneAsset& asset, const std::vector<glm::mat4>& instances);
+
+	/**
+	 * Triangles and parts drawn in the last frame, of all instances
+	 */
+	size_t getNumTriangles() const;
+	size_t getNumDrawnParts() const;
+
+	/**
+	 * Adds the parts drawn at each level of detail in the last frame, of
+	 * all instances, to level_draws (which grows to the number of levels)
+	 */
+	void addLevelDraws(std::vector<size_t>& level_draws) const;
+
+	// Declared first, so the context outlives the OpenGL objects below
+	std::shared_ptr<HeadlessContext> headless_context;
+	std::shared_ptr<GLUtils::FBO> framebuffer; //< Render target in headless mode
+	std::shared_ptr<SoftwareRenderer> software_renderer; //< Renders instead of OpenGL, with RenderOptions::software
+	std::shared_ptr<FrameProfiler> profiler; //< Times the phases of every frame
+
+	GLuint vao; //< Vertex array object
+	//GLuint vertex_vbo; //< VBO for vertex data
+	std::shared_ptr<GLUtils::VBO> vertices, normals;
+	//GLuint program; //< OpenGL shader program
+	std::shared_ptr<GLUtils::Program> program;
+	Uniforms uniforms;
+	std::vector<TransformKernel::DrawTransform> draw_transforms; //< Per part matrices, reused every frame
+	std::shared_ptr<DrawDataBuffer> draw_data; //< The per part matrices on the GPU
+	std::shared_ptr<DrawBatch> draw_batch; //< Parts drawn each frame
+	unsigned int draw_calls; //< Draw calls made in the current (or last) frame
+	bool redraw; //< The view changed since the last frame was drawn
+	double frame_period; //< Seconds between frames, 0 for no limit
+	BoundingVolumeHierarchy bvh; //< Model space bounds of the parts, for culling
+	std::vector<unsigned char> visible_parts; //< Per node, reused every frame
+	unsigned int culled_parts; //< Parts culled in the current (or last) frame
+	std::vector<unsigned char> part_levels; //< Level of detail per node, reused every frame
+
+	std::shared_ptr<Model> model;
+	std::shared_ptr<PreparedModel> software_model; //< The model in software mode, where nothing is uploaded
+	std::future<std::shared_ptr<PreparedModel> > model_loader; //< Prepares the model on a background thread
+	bool model_uploaded; //< The model, or every model of the scene, is uploaded
+
+	std::shared_ptr<Scene> scene; //< Drawn instead of the model, if the model is a scene file
+	std::vector<SceneAsset> scene_assets; //< Per asset of the scene
+	std::future<void> scene_loader; //< Prepares the models of the scene, in the order of the assets
+
+	std::string m_model;
+	LoadOptions m_load_options;
+	RenderOptions m_render_options;
+
+	glm::mat4 projection_matrix; //< OpenGL projection matrix
+	glm::mat4 model_matrix; //< OpenGL model transformation matrix
+	glm::mat4 view_matrix; //< OpenGL camera/view matrix
+	glm::mat3 normal_matrix; //< OpenGL matrix to transfor normals
+	glm::mat4 trackball_view_matrix; //< OpenGL camera matrix for the trackball
+
+	float m_zoom; // Used when zooming (changing fov)
+	float m_zoom_sensitivity; // Also used when zooming (changing fov)
+	float m_fov;
+	
+	VirtualTrackball trackball;
+	bool mouse_moved; //< The mouse moved while dragging, and the trackball is not turned there yet
+	int mouse_x, mouse_y; //< Last mouse position while dragging
+
+	ViewState input; //< Changed by input events, on the event thread
+	TripleBuffer<ViewState> view_snapshots; //< The input state, from the event thread to the render thread
+	TripleBuffer<std::string> titles; //< Window titles, from the render thread to the event thread
+	Uint32 title_event; //< Pushed by the render thread when there is a new title
+	Uint32 snapshot_event; //< Pushed by the render thread when it took a snapshot the event thread waits on
+	std::atomic<bool> snapshot_waiting; //< The event thread has input to publish once the render thread takes the last snapshot
+	std::atomic<bool> stop_rendering; //< Tells the render thread to finish
+	std::mutex render_mutex; //< Only to sleep on render_wakeup, the snapshots need no lock
+	std::condition_variable render_wakeup; //< Wakes the render thread for a snapshot, or to stop
+	SDL_Window* main_window; //< Our window handle
+	SDL_GLContext main_context; //< Our opengl context handle 
+};
+
+#endif // _GAMEMANAGER_H_
@@ -0,0 +1,28 @@
+#ifndef _HEADLESSCONTEXT_H__
+#define _HEADLESSCONTEXT_H__
+
+/**
+ * OpenGL 3.3 core context without a window, created through EGL.
+ * Prefers Mesa's surfaceless platform, so it also works without a
+ * display server or GPU (llvmpipe). There is no default framebuffer:
+ * render into a GLUtils::FBO. The context is current as long as the
+ * object lives.
+ */
+class HeadlessContext {
+public:
+	/**
+	 * Creates the context and makes it current. Throws a GameException
+	 * if EGL (or a surfaceless OpenGL context) is not available.
+	 */
+	HeadlessContext();
+	~HeadlessContext();
+
+private:
+	HeadlessContext(const HeadlessContext&);
+	HeadlessContext& operator=(const HeadlessContext&);
+
+	void* display; //< EGLDisplay
+	void* context; //< EGLContext
+};
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef _IMPORTPROFILE_H__
+#define _IMPORTPROFILE_H__
+
+#include <string>
+
+#include <assimp/cimport.h>
+#include <assimp/scene.h>
+
+/**
+ * Sets of assimp post-processing steps to import models with. The
+ * renderer only uses triangles with positions and normals, and welds
+ * and reorders the vertices itself, so most of what the realtime
+ * presets do is thrown away.
+ */
+namespace ImportProfile {
+
+	enum Profile {
+		MINIMAL, //< Only what the renderer needs: triangles with normals
+		FAST, //< Also drops degenerate triangles, invalid data and unused components
+		QUALITY //< aiProcessPreset_TargetRealtime_Quality, what we used to import with
+	};
+
+	const unsigned int n_profiles = 3;
+
+	/**
+	 * The assimp post-processing flags of a profile
+	 */
+	unsigned int getFlags(Profile profile);
+
+	const char* getName(Profile profile);
+
+	/**
+	 * Finds a profile by its name. Returns false if there is none.
+	 */
+	bool fromName(const std::string& name, Profile& profile);
+
+	/**
+	 * Imports filename with the steps (and step settings) of profile.
+	 * Returns NULL if assimp could not import it.
+	 */
+	const aiScene* importFile(const std::string& filename, Profile profile);
+
+}
+
+#endif
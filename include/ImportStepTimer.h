@@ -0,0 +1,52 @@
+#ifndef _IMPORTSTEPTIMER_H__
+#define _IMPORTSTEPTIMER_H__
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <assimp/cimport.h>
+
+#include "Timer.h"
+
+/**
+ * Times the steps of an assimp import from its log. While the object
+ * lives it listens to assimp's (verbose) log, where every post-processing
+ * step starts with "<Step>Process begin", and charges the time between
+ * those messages to the steps. The time before the first step is the
+ * reading of the file. Assimp's log is global, so only one import at
+ * a time can be timed.
+ */
+class ImportStepTimer {
+public:
+	ImportStepTimer();
+	~ImportStepTimer();
+
+	/**
+	 * Ends the last step. Called after the import returns.
+	 */
+	void finish();
+
+	/**
+	 * Prints every step with its time and share of the whole import
+	 */
+	void print() const;
+
+	inline const std::vector<std::pair<std::string, double> >& getSteps() const {return steps;}
+
+private:
+	ImportStepTimer(const ImportStepTimer&);
+	ImportStepTimer& operator=(const ImportStepTimer&);
+
+	static void logCallback(const char* message, char* user);
+	void onMessage(const std::string& message);
+	void endStep();
+
+	aiLogStream stream;
+	Timer timer;
+	std::string step; //< The step running now, empty when none is
+	double step_start;
+	std::vector<std::pair<std::string, double> > steps; //< Name and seconds
+};
+
+#endif
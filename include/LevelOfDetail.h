@@ -0,0 +1,27 @@
+#ifndef _LEVELOFDETAIL_H__
+#define _LEVELOFDETAIL_H__
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "MeshHierarchy.h"
+
+/**
+ * Picks the level of detail every part is drawn with, from how large the
+ * error of each level would be on the screen
+ */
+namespace LevelOfDetail {
+
+	/**
+	 * Sets levels[i] to the coarsest level of node i whose error, projected
+	 * at the nearest depth of the bounds of the node, is at most tolerance
+	 * pixels. Nodes the camera is inside of get the full level. If visible
+	 * is given, nodes flagged 0 are skipped (and get level 0).
+	 */
+	void selectLevels(const MeshHierarchy& hierarchy, const glm::mat4& view_model, const glm::mat4& projection,
+			float viewport_height, float tolerance, const unsigned char* visible, std::vector<unsigned char>& levels);
+
+}
+
+#endif
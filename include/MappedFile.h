@@ -0,0 +1,42 @@
+#ifndef _MAPPEDFILE_H__
+#define _MAPPEDFILE_H__
+
+#include <string>
+#include <cstddef>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+/**
+ * Read-only memory mapping of a whole file. The mapping lives
+ * as long as the object.
+ */
+class MappedFile {
+public:
+	/**
+	 * Maps filename into memory. Throws a GameException if the
+	 * file cannot be opened or mapped.
+	 */
+	MappedFile(const std::string& filename);
+	~MappedFile();
+
+	inline const unsigned char* data() const {return mapped_data;}
+	inline size_t size() const {return mapped_size;}
+
+private:
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+
+	const unsigned char* mapped_data;
+	size_t mapped_size;
+
+#ifdef _WIN32
+	HANDLE file_handle;
+	HANDLE mapping_handle;
+#else
+	int fd;
+#endif
+};
+
+#endif
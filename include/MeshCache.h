@@ -0,0 +1,83 @@
+#ifndef _MESHCACHE_H__
+#define _MESHCACHE_H__
+
+#include <memory>
+#include <string>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "ImportProfile.h"
+#include "MappedFile.h"
+#include "Model.h"
+
+/**
+ * Binary file holding an already imported model, in the layout we upload
+ * to OpenGL. The file is laid out as
+ *   header | node hierarchy (parents first) | levels of detail | interleaved vertices | indices
+ * where the vertex and index blocks can be handed to the buffer objects
+ * directly from the memory mapped file. The header records the size,
+ * modification time and hash of the file the cache was built from.
+ */
+class MeshCache {
+public:
+	/**
+	 * Memory maps a cache file. Throws a GameException if the file
+	 * is not a valid mesh cache.
+	 */
+	MeshCache(const std::string& cache_filename);
+	~MeshCache();
+
+	/**
+	 * Returns true if cache_filename exists and was built from the current
+	 * contents of source_filename. If the size and modification time of
+	 * the source match we trust the cache, otherwise we fall back to
+	 * comparing the hash of the source file. If only the modification
+	 * time changed, the cache is updated to it, so the file is hashed once.
+	 */
+	static bool isUpToDate(const std::string& cache_filename, const std::string& source_filename);
+
+	/**
+	 * Writes data to cache_filename, tagged with source_filename. The file is
+	 * written under a temporary name first, so a failed write never leaves
+	 * a half written cache behind.
+	 */
+	static void write(const std::string& cache_filename, const std::string& source_filename, const MeshData& data);
+
+	inline const MeshHierarchy& getHierarchy() const {return hierarchy;}
+	inline glm::vec3 getMinDim() const {return min_dim;}
+	inline glm::vec3 getMaxDim() const {return max_dim;}
+
+	inline const void* getVertices() const {return vertices;}
+	inline unsigned int getVertexBytes() const {return n_vertices * 6 * sizeof(float);}
+	inline unsigned int getNumVertices() const {return n_vertices;}
+
+	inline const void* getIndices() const {return indices;}
+	inline unsigned int getIndexBytes() const {return n_indices * (index_type == GL_UNSIGNED_SHORT ? 2 : 4);}
+	inline unsigned int getNumIndices() const {return n_indices;}
+	inline GLenum getIndexType() const {return index_type;}
+
+	inline unsigned int getNumSoupVertices() const {return n_soup_vertices;}
+	inline bool isOptimized() const {return optimized;}
+	inline bool isObjReader() const {return obj_reader;}
+	inline ImportProfile::Profile getImportProfile() const {return import_profile;}
+
+private:
+	std::shared_ptr<MappedFile> file;
+
+	MeshHierarchy hierarchy;
+	glm::vec3 min_dim;
+	glm::vec3 max_dim;
+
+	const void* vertices; //< Points into the mapped file
+	const void* indices; //< Points into the mapped file
+	unsigned int n_vertices;
+	unsigned int n_indices;
+	unsigned int n_soup_vertices;
+	GLenum index_type;
+	bool optimized; //< The meshes were reordered by MeshOptimizer
+	bool obj_reader; //< The model was read by ObjReader, not assimp
+	ImportProfile::Profile import_profile;
+};
+
+#endif
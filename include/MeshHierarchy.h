@@ -0,0 +1,154 @@
+#ifndef _MESHHIERARCHY_H__
+#define _MESHHIERARCHY_H__
+
+#include <vector>
+#include <cstddef>
+
+#include <glm/glm.hpp>
+
+/**
+ * The node hierarchy of a model, flattened into arrays (one entry per
+ * node in each) in topological order: a parent always comes before its
+ * children. Every node has a local transform, a world transform relative
+ * to the model and a range of indices to draw. World transforms are only
+ * recomputed for nodes whose (or whose ancestors') local transform
+ * changed, so updating a static model costs nothing, and drawing it is
+ * a linear sweep over the arrays.
+ */
+class MeshHierarchy {
+public:
+	MeshHierarchy();
+	~MeshHierarchy();
+
+	/**
+	 * Appends a node and returns its index. The parent (-1 for a root)
+	 * must already have been added. first and count is the range of
+	 * the index buffer the node draws.
+	 */
+	unsigned int addNode(int parent, const glm::mat4& local_transform, unsigned int first, unsigned int count);
+
+	void reserve(unsigned int n_nodes);
+	void clear();
+
+	/**
+	 * Sets the number of levels of detail. Level 0 is the full mesh, given
+	 * to addNode(), and every other level draws the same range until it is
+	 * set with setLevel(). Must be called on an empty hierarchy, with at
+	 * most max_levels levels.
+	 */
+	void setNumLevels(unsigned int n_levels);
+	inline unsigned int getNumLevels() const {return n_levels;}
+
+	static const unsigned int max_levels = 16; //< Each level halves the triangles, so more would be empty
+
+	/**
+	 * Sets the range of indices a node draws at a level of detail, and the
+	 * largest distance (in the space of the node) the level is off the
+	 * full mesh
+	 */
+	void setLevel(unsigned int node, unsigned int level, unsigned int first, unsigned int count, float error);
+	inline unsigned int getFirst(unsigned int node, unsigned int level) const {return firsts[node * n_levels + level];}
+	inline unsigned int getCount(unsigned int node, unsigned int level) const {return counts[node * n_levels + level];}
+	inline float getError(unsigned int node, unsigned int level) const {return errors[node * n_levels + level];}
+
+	inline unsigned int size() const {return static_cast<unsigned int>(parents.size());}
+
+	inline int getParent(unsigned int node) const {return parents[node];}
+	inline const glm::mat4& getLocalTransform(unsigned int node) const {return local_transforms[node];}
+	inline unsigned int getFirst(unsigned int node) const {return firsts[node * n_levels];}
+	inline unsigned int getCount(unsigned int node) const {return counts[node * n_levels];}
+
+	/**
+	 * Sets the axis-aligned bounding box of the geometry of a node, in the
+	 * space of the node. Nodes start out with an empty box (min > max).
+	 */
+	void setBounds(unsigned int node, const glm::vec3& min, const glm::vec3& max);
+	inline const glm::vec3& getBoundsMin(unsigned int node) const {return bounds_min[node];}
+	inline const glm::vec3& getBoundsMax(unsigned int node) const {return bounds_max[node];}
+	inline bool hasBounds(unsigned int node) const {return bounds_min[node].x <= bounds_max[node].x;}
+
+	/**
+	 * Sets the transform from the vertices as they are stored to the space
+	 * of the nodes, the same for all nodes, e.g. to undo a quantization.
+	 * Only the vertex world transforms include it.
+	 */
+	void setVertexTransform(const glm::mat4& vertex_transform);
+	inline const glm::mat4& getVertexTransform() const {return vertex_transform;}
+
+	/**
+	 * Changes the local transform of a node. The world transforms of the
+	 * node and its descendants are updated by updateWorldTransforms().
+	 */
+	void setLocalTransform(unsigned int node, const glm::mat4& local_transform);
+
+	/**
+	 * Recomputes the world (and normal) transforms of the nodes that
+	 * changed since the last call, and of their descendants
+	 */
+	void updateWorldTransforms();
+
+	/**
+	 * Transform from the node to model space. Only valid after
+	 * updateWorldTransforms().
+	 */
+	inline const glm::mat4& getWorldTransform(unsigned int node) const {return world_transforms[node];}
+
+	/**
+	 * Transpose of the inverse of the upper 3x3 of the world transform,
+	 * for transforming normals, in the upper 3x3 of a mat4 so the batch
+	 * kernels can load it as whole columns. Only valid after
+	 * updateWorldTransforms().
+	 */
+	inline const glm::mat4& getNormalTransform(unsigned int node) const {return normal_transforms[node];}
+
+	/**
+	 * The world and normal transforms of all nodes, as arrays of size()
+	 */
+	inline const glm::mat4* getWorldTransforms() const {return world_transforms.empty() ? NULL : &world_transforms[0];}
+	inline const glm::mat4* getNormalTransforms() const {return normal_transforms.empty() ? NULL : &normal_transforms[0];}
+
+	/**
+	 * Transforms from the stored vertices to model space: the world
+	 * transforms times the vertex transform, as an array of size()
+	 */
+	inline const glm::mat4* getVertexWorldTransforms() const {
+		return has_vertex_transform ? (vertex_world_transforms.empty() ? NULL : &vertex_world_transforms[0]) : getWorldTransforms();
+	}
+
+	/**
+	 * Bounding box of the node in model space: the box of its geometry
+	 * transformed by the world transform. Only valid after
+	 * updateWorldTransforms().
+	 */
+	inline const glm::vec3& getWorldBoundsMin(unsigned int node) const {return world_bounds_min[node];}
+	inline const glm::vec3& getWorldBoundsMax(unsigned int node) const {return world_bounds_max[node];}
+
+	/**
+	 * Changes every time updateWorldTransforms() moves a node, so users
+	 * of the world transforms or bounds know when to recompute
+	 */
+	inline unsigned int getVersion() const {return version;}
+
+private:
+	std::vector<int> parents; //< Index of the parent node, -1 for roots
+	std::vector<glm::mat4> local_transforms;
+	std::vector<glm::mat4> world_transforms;
+	std::vector<glm::mat4> normal_transforms;
+	std::vector<glm::mat4> vertex_world_transforms; //< Only used with a vertex transform
+	std::vector<unsigned int> firsts; //< First index in the element buffer, per node and level
+	std::vector<unsigned int> counts; //< Number of indices to draw, per node and level
+	std::vector<float> errors; //< Distance to the full mesh, per node and level
+	std::vector<glm::vec3> bounds_min; //< Bounding box in the space of the node
+	std::vector<glm::vec3> bounds_max;
+	std::vector<glm::vec3> world_bounds_min; //< Bounding box in model space
+	std::vector<glm::vec3> world_bounds_max;
+	std::vector<unsigned char> dirty; //< Local transform changed since the last update
+
+	unsigned int first_dirty; //< No node before this one is dirty
+	unsigned int version;
+	unsigned int n_levels;
+	glm::mat4 vertex_transform;
+	bool has_vertex_transform;
+};
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef _MESHOPTIMIZER_H__
+#define _MESHOPTIMIZER_H__
+
+#include <cstddef>
+
+/**
+ * Reorders the triangles and vertices of an indexed mesh for the GPU:
+ * triangles for the post-transform vertex cache, then groups of them
+ * for less overdraw, then the vertices in the order they are fetched.
+ * None of it changes what is drawn, only how fast.
+ */
+namespace MeshOptimizer {
+
+	/**
+	 * Size of the FIFO cache the average cache miss ratio is measured with
+	 */
+	const unsigned int fifo_cache_size = 16;
+
+	/**
+	 * Average cache miss ratio: vertices transformed per triangle with a
+	 * FIFO cache of cache_size vertices. 3 is the worst, 0.5 about the
+	 * best a large regular mesh can do.
+	 */
+	float getACMR(const unsigned int* indices, size_t n_indices, unsigned int n_vertices, unsigned int cache_size=fifo_cache_size);
+
+	/**
+	 * Reorders the triangles so they reuse recently used vertices
+	 * (Tom Forsyth, "Linear-Speed Vertex Cache Optimisation")
+	 */
+	void optimizeVertexCache(unsigned int* indices, size_t n_indices, unsigned int n_vertices);
+
+	/**
+	 * Splits triangles ordered by optimizeVertexCache into clusters where
+	 * the cache miss ratio allows it (at most threshold times worse), and
+	 * sorts the clusters so the ones facing out from the middle of the
+	 * mesh come first, and hide what is behind them (Sander et al., "Fast
+	 * Triangle Reordering for Vertex Locality and Reduced Overdraw").
+	 * vertices holds the positions as the first three of stride floats.
+	 */
+	void optimizeOverdraw(unsigned int* indices, size_t n_indices, const float* vertices, size_t stride, unsigned int n_vertices,
+			float threshold=1.05f);
+
+	/**
+	 * Moves the vertices into the order the indices first use them, and
+	 * renumbers the indices. Vertices that are not used go last.
+	 */
+	void optimizeVertexFetch(unsigned int* indices, size_t n_indices, float* vertices, size_t stride, unsigned int n_vertices);
+
+}
+
+#endif
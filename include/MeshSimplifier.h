@@ -0,0 +1,96 @@
+#ifndef _MESHSIMPLIFIER_H__
+#define _MESHSIMPLIFIER_H__
+
+#include <cstddef>
+#include <vector>
+
+/**
+ * Simplifies an indexed triangle mesh by collapsing edges in the order of
+ * their quadric error (Garland and Heckbert). A vertex is always collapsed
+ * onto one of its neighbours, so the result only uses the existing
+ * vertices and can be drawn from the same vertex buffer with a smaller
+ * index buffer.
+ *
+ * Vertices on open borders, and vertices that share their position with
+ * other vertices (seams where the normal changes), are never removed, so
+ * the outline of the mesh and its hard edges stay in place.
+ */
+class MeshSimplifier {
+public:
+	/**
+	 * vertices holds n_vertices vertices of stride floats, starting with
+	 * the position. indices (triangles) refer to vertices in [0, n_vertices).
+	 * The vertices are only read, and must outlive the simplifier.
+	 */
+	MeshSimplifier(const float* vertices, size_t stride, unsigned int n_vertices, const unsigned int* indices, size_t n_indices);
+	~MeshSimplifier();
+
+	/**
+	 * Collapses edges until at most target_indices indices are left, or no
+	 * collapse is left. Each call continues from the result of the previous
+	 * one, so a series of calls with smaller targets gives a series of
+	 * coarser levels. Returns the number of indices left.
+	 */
+	size_t simplify(size_t target_indices);
+
+	/**
+	 * The triangles of the current result
+	 */
+	inline const std::vector<unsigned int>& getIndices() const {return indices;}
+
+	/**
+	 * Largest distance a collapse so far has moved the surface, estimated
+	 * as the square root of the quadric error, in the units of the positions
+	 */
+	inline float getError() const {return error;}
+
+private:
+	MeshSimplifier(const MeshSimplifier&);
+	MeshSimplifier& operator=(const MeshSimplifier&);
+
+	/**
+	 * Symmetric 4x4 matrix: the sum of the squared distances to a set of
+	 * planes, for a point (x, y, z, 1)
+	 */
+	struct Quadric {
+		double a[10];
+	};
+
+	struct Collapse {
+		double cost;
+		unsigned int from;
+		unsigned int to;
+	};
+
+	inline const float* getPosition(unsigned int vertex) const {return vertices + vertex * stride;}
+	double evaluate(const Quadric& quadric, unsigned int vertex) const;
+
+	/**
+	 * True if moving from onto to turns any triangle around from (almost) over
+	 */
+	bool flipsTriangle(unsigned int from, unsigned int to) const;
+
+	/**
+	 * One round of collapses of vertices that do not touch each other.
+	 * Returns the number of collapses.
+	 */
+	size_t collapsePass(size_t target_indices);
+
+	const float* vertices;
+	size_t stride;
+	unsigned int n_vertices;
+
+	std::vector<unsigned int> indices;
+	std::vector<unsigned int> positions; //< The first vertex with the same position, per vertex
+	std::vector<unsigned char> locked; //< Per position: never removed
+	std::vector<Quadric> quadrics; //< Per position
+
+	// Triangles around every vertex, rebuilt every pass
+	std::vector<unsigned int> adjacency_offsets;
+	std::vector<unsigned int> adjacency;
+
+	std::vector<Collapse> collapses;
+	float error;
+};
+
+#endif
@@ -1,61 +1,290 @@
-#ifndef _MODEL_H__
-#define _MODEL_H__
-
-#include <memory>
-#include <string>
-#include <vector>
-
-#include <assimp/cimport.h>
-#include <assimp/scene.h>
-#include <assimp/postprocess.h>
-
-#include <glm/glm.hpp>
-#include <glm/gtc/type_ptr.hpp>
-
-#include "GLUtils/VBO.hpp"
-
-struct MeshPart {
-	MeshPart() {
-		transform = glm::mat4(1.0f);
-		first = 0;
-		count = 0;
-	}
-
-	glm::mat4 transform;
-	unsigned int first;
-	unsigned int count;
-	std::vector<MeshPart> children;
-};
-
-class Model {
-public:
-	Model(std::string filename, bool invert=0);
-	~Model();
-
-	inline MeshPart getMesh() {return root;}
-	inline std::shared_ptr<GLUtils::VBO> getVertices() {return vertices;}
-	inline std::shared_ptr<GLUtils::VBO> getNormals() {return normals;}
-
-private:
-	static void loadRecursive(MeshPart& part, bool invert,
-			std::vector<float>& vertex_data, std::vector<float>& normal_data, const aiScene* scene, const aiNode* node);
-	void MakeBoundingBox();
-	const aiScene* scene;
-	MeshPart root;
-
-	std::shared_ptr<GLUtils::VBO> normals;
-	std::shared_ptr<GLUtils::VBO> vertices;
-
-	glm::vec3 min_dim;
-	glm::vec3 max_dim;
-
-	void MakeBoudingBox(std::vector<float> vertex_data);
-	glm::vec3 FindScaleVector();
-	glm::vec3 FindTranslateVector();
-
-	std::vector<float> MakeInterleavedVBO(std::vector<float> vertex_data, std::vector<float> normal_data);
-
-	unsigned int n_vertices;
-};
-
+#ifndef _MODEL_H__
+#define _MODEL_H__
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <assimp/cimport.h>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "GLUtils/VBO.hpp"
+#include "GLUtils/IBO.hpp"
+#include "ImportProfile.h"
+#include "MeshHierarchy.h"
+#include "VertexQuantizer.h"
+
+/**
+ * CPU side copy of a model, in the same layout as it is
+ * uploaded to OpenGL
+ */
+struct MeshData {
+	MeshData() {
+		n_soup_vertices = 0;
+		optimized = false;
+		obj_reader = false;
+		import_profile = ImportProfile::FAST;
+	}
+
+	MeshHierarchy hierarchy;
+	std::vector<float> vertices; //< Interleaved position and normal
+	std::vector<unsigned int> indices; //< The full meshes, followed by each coarser level of detail
+	glm::vec3 min_dim; //< Axis-aligned bounding box, before the node transforms
+	glm::vec3 max_dim;
+	unsigned int n_soup_vertices; //< Number of vertices if the mesh was drawn as a triangle soup
+	bool optimized; //< Triangles and vertices are reordered by MeshOptimizer
+	bool obj_reader; //< Read by ObjReader, so import_profile does not apply
+	ImportProfile::Profile import_profile; //< Assimp steps the model was imported with
+};
+
+class MeshCache;
+class ObjReader;
+class ThreadPool;
+
+/**
+ * A model ready to be uploaded: the contents of the buffer objects
+ * in their final layout, either in memory or mapped from the mesh
+ * cache. Preparing a model does not touch OpenGL, so it can be done
+ * on any thread.
+ */
+struct PreparedModel {
+	PreparedModel() {
+		n_vertices = 0;
+		n_indices = 0;
+		n_soup_vertices = 0;
+		index_type = GL_UNSIGNED_INT;
+		vertex_data = NULL;
+		vertex_bytes = 0;
+		index_data = NULL;
+		index_bytes = 0;
+		prepare_time = 0.0;
+		quantized = false;
+	}
+
+	std::string filename;
+	MeshHierarchy hierarchy;
+	glm::vec3 min_dim;
+	glm::vec3 max_dim;
+	unsigned int n_vertices;
+	unsigned int n_indices;
+	unsigned int n_soup_vertices;
+	GLenum index_type;
+
+	const void* vertex_data; //< Contents of the VBO
+	size_t vertex_bytes;
+	const void* index_data; //< Contents of the IBO
+	size_t index_bytes;
+
+	double prepare_time; //< Seconds spent importing or mapping the model
+
+	bool quantized; //< The vertices are VertexQuantizer::QuantizedVertex, not six floats
+	VertexQuantizer::Error quantization_error;
+
+	// Owners of the memory the pointers above point into
+	std::shared_ptr<MeshCache> cache;
+	MeshData data;
+	std::vector<unsigned short> short_indices;
+	std::vector<VertexQuantizer::QuantizedVertex> quantized_vertices;
+};
+
+/**
+ * Settings for importing a model
+ */
+struct LoadOptions {
+	LoadOptions() {
+		threads = 0;
+		lod_levels = 4;
+		quantize = false;
+		optimize = true;
+		obj_reader = true;
+		import_profile = ImportProfile::FAST;
+		import_timing = false;
+	}
+
+	unsigned int threads; //< Threads used to convert the meshes, 0 means one per core
+	unsigned int lod_levels; //< Levels of detail, including the full mesh, each with half the triangles of the one before (at most MeshHierarchy::max_levels)
+	bool quantize; //< Upload the vertices in the 12 byte layout of VertexQuantizer
+	bool optimize; //< Reorder triangles and vertices with MeshOptimizer
+	bool obj_reader; //< Read .obj files with ObjReader, and only other formats with assimp
+	ImportProfile::Profile import_profile; //< Assimp post-processing steps
+	bool import_timing; //< Print the time of every assimp import step
+};
+
+class Model {
+public:
+	/**
+	  * Loads the model from its mesh cache if the cache is up to date,
+	  * or imports it with assimp and (re)writes the cache otherwise
+	  */
+	Model(std::string filename, bool invert=0, const LoadOptions& options=LoadOptions());
+
+	/**
+	  * Creates (empty) buffer objects for a prepared model. They are
+	  * filled by calling upload() until it returns true.
+	  */
+	Model(std::shared_ptr<PreparedModel> prepared);
+	~Model();
+
+	/**
+	  * Loads the model from its mesh cache if the cache is up to date,
+	  * or imports it with assimp and (re)writes the cache otherwise.
+	  * Does not touch OpenGL, so it can run on a background thread.
+	  */
+	static std::shared_ptr<PreparedModel> prepare(std::string filename, bool invert=0, const LoadOptions& options=LoadOptions());
+
+	/**
+	  * Uploads at most max_bytes more of the prepared model to the
+	  * buffer objects. The vertices go first, then whole triangles of
+	  * indices. Returns true when everything is uploaded.
+	  */
+	bool upload(size_t max_bytes);
+
+	/**
+	  * Number of indices (from the start of the index buffer) that
+	  * have been uploaded and can be drawn
+	  */
+	inline unsigned int getNumUploadedIndices() {return n_uploaded_indices;}
+
+	/**
+	  * Imports the model with assimp and writes its mesh cache, without
+	  * creating any OpenGL objects. Used to pre-build the caches offline.
+	  */
+	static void bake(std::string filename, bool invert=0, const LoadOptions& options=LoadOptions());
+
+	/**
+	  * Imports the model into data, without touching OpenGL. OBJ files
+	  * are read by ObjReader, everything else (and OBJ files it cannot
+	  * read) by assimp.
+	  */
+	static void import(const std::string& filename, bool invert, MeshData& data, const LoadOptions& options=LoadOptions());
+
+	/**
+	  * Converts an imported assimp scene into data. The meshes are converted
+	  * in parallel, each into its own range of the buffers, so the result
+	  * does not depend on the number of threads.
+	  */
+	static void convertScene(const aiScene* scene, bool invert, MeshData& data, const LoadOptions& options=LoadOptions());
+
+	/**
+	  * Converts the groups of an OBJ file into data, the same way
+	  * convertScene converts the meshes of a scene
+	  */
+	static void convertObj(const ObjReader& reader, MeshData& data, const LoadOptions& options, ThreadPool& pool);
+
+	/**
+	  * Returns the name of the mesh cache file belonging to a model file
+	  */
+	static std::string getCacheFilename(const std::string& filename);
+
+	/**
+	  * Returns GL_UNSIGNED_SHORT if every vertex can be addressed
+	  * with a 16-bit index, and GL_UNSIGNED_INT otherwise
+	  */
+	static GLenum getIndexType(unsigned int n_vertices);
+
+	/**
+	  * True if the vertices are in the layout of VertexQuantizer: positions
+	  * as three GL_SHORT and normals as GL_INT_2_10_10_10_REV, 12 bytes in
+	  * all. The hierarchy then has the transform back to the original
+	  * positions as its vertex transform.
+	  */
+	inline bool isQuantized() const {return quantized;}
+	inline unsigned int getVertexSize() const {return quantized ? sizeof(VertexQuantizer::QuantizedVertex) : 6 * sizeof(float);}
+
+	inline MeshHierarchy& getHierarchy() {return hierarchy;}
+	inline std::shared_ptr<GLUtils::VBO> getVertices() {return vertices;}
+	inline std::shared_ptr<GLUtils::VBO> getNormals() {return normals;}
+	inline std::shared_ptr<GLUtils::IBO> getIndices() {return indices;}
+
+private:
+	struct MeshJob;
+
+	void createBuffers(std::shared_ptr<PreparedModel> prepared);
+
+	/**
+	  * Replaces the float vertices of a prepared model by quantized ones
+	  */
+	static void quantizeVertices(PreparedModel& prepared);
+
+	/**
+	  * Adds node and its children to the hierarchy, and lists the
+	  * meshes in them together with where their indices go and
+	  * the largest range of vertices they can need
+	  */
+	static void loadRecursive(MeshHierarchy& hierarchy, int parent, bool invert, std::vector<MeshJob>& jobs, size_t& n_indices, size_t& max_vertices,
+			unsigned int& n_soup_vertices, const aiScene* scene, const aiNode* node);
+
+	/**
+	  * Writes the welded vertices and the (mesh relative) indices of
+	  * one mesh into its ranges of the buffers in data
+	  */
+	static void weldMesh(MeshJob& job, MeshData& data);
+
+	/**
+	  * Packs the welded meshes together, optimizes and simplifies them,
+	  * and fits the model into the unit cube. The part of the conversion
+	  * that does not depend on where the meshes came from.
+	  */
+	static void finishMeshes(std::vector<MeshJob>& jobs, MeshData& data, const LoadOptions& options, ThreadPool& pool);
+
+	/**
+	  * Reorders the triangles and vertices of a welded mesh for the
+	  * vertex cache, overdraw and vertex fetch, and measures its
+	  * average cache miss ratio before and after
+	  */
+	static void optimizeMesh(MeshJob& job, MeshData& data);
+
+	/**
+	  * Simplifies a welded mesh into the coarser levels of detail,
+	  * with indices relative to the mesh like its full level
+	  */
+	static void simplifyMesh(MeshJob& job, const MeshData& data, unsigned int n_levels, bool optimize);
+
+	/**
+	  * Appends the coarser levels of all meshes to the index buffer,
+	  * level by level, and sets the ranges of the nodes
+	  */
+	static void addLevels(std::vector<MeshJob>& jobs, MeshData& data);
+
+	/**
+	  * Prints the average cache miss ratio of the largest meshes, and of
+	  * all of them, before and after optimizeMesh
+	  */
+	static void PrintOptimizationStats(const std::vector<MeshJob>& jobs);
+	MeshHierarchy hierarchy;
+
+	std::shared_ptr<GLUtils::VBO> normals;
+	std::shared_ptr<GLUtils::VBO> vertices;
+	std::shared_ptr<GLUtils::IBO> indices;
+
+	glm::vec3 min_dim;
+	glm::vec3 max_dim;
+
+	static glm::vec3 FindScaleVector(const glm::vec3& min_dim, const glm::vec3& max_dim);
+	static glm::vec3 FindTranslateVector(const glm::vec3& min_dim, const glm::vec3& max_dim);
+
+	/**
+	  * Prints the size of the indexed mesh compared to the
+	  * triangle soup it replaces
+	  */
+	void PrintStats(const std::string& filename, unsigned int n_soup_vertices, unsigned int n_indices, double load_time);
+
+	/**
+	  * Prints the number of triangles of every level of detail
+	  */
+	void PrintLevelStats();
+
+	unsigned int n_vertices; //< Number of (unique) vertices in the VBO
+	bool quantized;
+
+	std::shared_ptr<PreparedModel> prepared; //< Data still to be uploaded
+	size_t uploaded_vertex_bytes;
+	size_t uploaded_index_bytes;
+	unsigned int n_uploaded_indices;
+};
+
 #endif
\ No newline at end of file
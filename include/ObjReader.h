@@ -0,0 +1,79 @@
+#ifndef _OBJREADER_H__
+#define _OBJREADER_H__
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+class ThreadPool;
+
+/**
+ * Fast reader for Wavefront OBJ files, used instead of assimp for the
+ * (often large) plain .obj models. The file is memory mapped and split
+ * into chunks of whole lines that are parsed in parallel: one pass counts
+ * the positions, normals and triangles of every chunk, so the second pass
+ * knows where each chunk writes its part of the arrays. Only geometry is
+ * read: v, vn, f (triangulated as fans) and o/g to split the meshes.
+ * Corners without a normal get the smooth normal of their position.
+ */
+class ObjReader {
+public:
+	/**
+	 * A run of triangles started by an o or g line
+	 */
+	struct Group {
+		std::string name;
+		size_t first_triangle;
+		size_t n_triangles;
+	};
+
+	/**
+	 * Reads filename using the threads of pool. Throws a GameException
+	 * if the file cannot be mapped or has a line we cannot parse.
+	 */
+	ObjReader(const std::string& filename, ThreadPool& pool);
+
+	/**
+	 * Returns true if filename has the .obj extension (in any case)
+	 */
+	static bool isObjFile(const std::string& filename);
+
+	inline size_t getNumGroups() const {return groups.size();}
+	inline const Group& getGroup(size_t group) const {return groups[group];}
+	inline size_t getNumTriangles() const {return corner_positions.size() / 3;}
+
+	/**
+	 * Writes the position and normal of a corner (three per
+	 * triangle) to vertex[0..5]
+	 */
+	inline void getVertex(size_t corner, float* vertex) const {
+		unsigned int position = corner_positions[corner];
+		unsigned int normal = corner_normals[corner];
+		const float* p = &positions[static_cast<size_t>(position) * 3];
+		const float* n = (normal != no_normal) ? &normals[static_cast<size_t>(normal) * 3] : &smooth_normals[static_cast<size_t>(position) * 3];
+		vertex[0] = p[0]; vertex[1] = p[1]; vertex[2] = p[2];
+		vertex[3] = n[0]; vertex[4] = n[1]; vertex[5] = n[2];
+	}
+
+	static const unsigned int no_normal = ~0u; //< Corner normal of a face without vn indices
+
+private:
+	struct Chunk;
+
+	void countChunk(Chunk& chunk) const;
+	void parseChunk(Chunk& chunk);
+	void generateSmoothNormals(ThreadPool& pool);
+
+	std::string filename;
+	size_t n_file_positions; //< Totals of the whole file, known after counting
+	size_t n_file_normals;
+
+	std::vector<float> positions;
+	std::vector<float> normals;
+	std::vector<float> smooth_normals; //< Per position, only if some corner has no normal
+	std::vector<unsigned int> corner_positions;
+	std::vector<unsigned int> corner_normals;
+	std::vector<Group> groups;
+};
+
+#endif
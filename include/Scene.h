@@ -0,0 +1,77 @@
+#ifndef _SCENE_H__
+#define _SCENE_H__
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+/**
+ * A scene description: the models of a scene, and the transforms of
+ * the instances of each. Every model file is listed once however many
+ * instances it has, so it is loaded and uploaded once, and its
+ * instances are drawn together.
+ *
+ * A scene file is text, one statement per line, # starts a comment:
+ *   instance <model> <x> <y> <z> [yaw] [scale]
+ *       one instance at (x, y, z), turned yaw degrees around the y axis
+ *   grid <model> <nx> <nz> <spacing> [scale]
+ *       nx by nz instances on the xz plane, spacing apart, centered
+ *       around the origin
+ * Model paths are relative to the scene file. Models are fit into the
+ * unit cube when they are loaded, so scale is the size of an instance.
+ * Scales are uniform, so the rotation part of an instance transform
+ * also transforms its normals.
+ */
+class Scene {
+public:
+	/**
+	 * A model file and all its instances
+	 */
+	struct Asset {
+		std::string filename;
+		std::vector<glm::mat4> instances; //< Model matrix of every instance
+	};
+
+	/**
+	 * Reads a scene file. Throws a GameException if it cannot be read,
+	 * has a line we cannot parse, or has no instances.
+	 */
+	Scene(const std::string& filename);
+
+	/**
+	 * Returns true if filename has the .scene extension (in any case)
+	 */
+	static bool isSceneFile(const std::string& filename);
+
+	inline const std::vector<Asset>& getAssets() const {return assets;}
+	inline size_t getNumInstances() const {return n_instances;}
+
+	/**
+	 * Sphere around all instances, each taken as the sphere around its
+	 * unit cube
+	 */
+	inline const glm::vec3& getCenter() const {return center;}
+	inline float getRadius() const {return radius;}
+
+private:
+	/**
+	 * Index of the asset of a model file, added if it is new
+	 */
+	unsigned int getAsset(const std::string& filename);
+
+	void addInstance(unsigned int asset, const glm::vec3& position, float yaw, float scale);
+
+	std::vector<Asset> assets;
+	std::map<std::string, unsigned int> asset_indices; //< Asset of every model file
+	std::string directory; //< Of the scene file, with a trailing separator
+	size_t n_instances;
+
+	glm::vec3 min_dim; //< Bounds of the instance spheres
+	glm::vec3 max_dim;
+	glm::vec3 center;
+	float radius;
+};
+
+#endif
@@ -0,0 +1,89 @@
+#ifndef _SOFTWARERENDERER_H__
+#define _SOFTWARERENDERER_H__
+
+#include <memory>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "DrawBatch.h"
+#include "Model.h"
+#include "ThreadPool.h"
+#include "TransformKernel.h"
+
+/**
+ * Renders a model on the CPU, for machines without a GPU. It draws the
+ * same draw list with the same matrices as the OpenGL path, and does
+ * what shaders/test.vert and test.frag do with the fixed function state
+ * of GameManager: near plane clipping, back face culling, a LEQUAL depth
+ * test and per pixel Blinn-Phong lighting.
+ *
+ * Drawing has two parallel passes. The triangles are split into jobs,
+ * and every job transforms, clips and sets up its triangles and sorts
+ * them into bins, one per screen tile. Then every tile is rasterized
+ * on its own, going through the bins of the jobs in order, so triangles
+ * are drawn in the order OpenGL draws them.
+ */
+class SoftwareRenderer {
+public:
+	/**
+	 * Creates the color and depth buffers. n_threads is the number of
+	 * threads to draw with, 0 means one per hardware thread.
+	 */
+	SoftwareRenderer(unsigned int width, unsigned int height, unsigned int n_threads=0);
+	~SoftwareRenderer();
+
+	/**
+	 * Clears the color buffer to color, and the depth buffer to the far plane
+	 */
+	void clear(const glm::vec3& color);
+
+	/**
+	 * Draws the draw list of model, draw i with the matrices transforms[i].
+	 * Returns the number of triangles left after clipping and culling.
+	 */
+	size_t draw(const PreparedModel& model, const DrawBatch& batch, const TransformKernel::DrawTransform* transforms,
+			const glm::mat4& projection_matrix);
+
+	/**
+	 * Copies the color buffer to pixels, as RGB with the top row
+	 * first (the layout of GLUtils::FBO::readPixels)
+	 */
+	void readPixels(std::vector<unsigned char>& pixels) const;
+
+	inline unsigned int getWidth() const {return width;}
+	inline unsigned int getHeight() const {return height;}
+	inline unsigned int getNumThreads() const {return pool.getNumThreads();}
+
+	static const unsigned int tile_size = 64; //< Side of a screen tile in pixels
+	static const int subpixel_bits = 8; //< Precision of the vertex positions on the screen
+
+private:
+	SoftwareRenderer(const SoftwareRenderer&);
+	SoftwareRenderer& operator=(const SoftwareRenderer&);
+
+	struct Vertex;
+	struct Triangle;
+	struct Job;
+
+	void setupJob(Job& job, const PreparedModel& model, const DrawBatch& batch, const TransformKernel::DrawTransform* transforms,
+			const glm::mat4& projection_matrix);
+	void setupTriangle(Job& job, const Vertex& a, const Vertex& b, const Vertex& c);
+	void rasterizeTile(unsigned int tile);
+	void rasterizeTriangle(const Triangle& triangle, int min_x, int min_y, int max_x, int max_y);
+
+	unsigned int width;
+	unsigned int height;
+	unsigned int tiles_x;
+	unsigned int tiles_y;
+
+	std::vector<unsigned char> color_buffer; //< RGB, top row first
+	std::vector<float> depth_buffer; //< Window space depth, 0 to 1
+
+	ThreadPool pool;
+	std::vector<Job> jobs; //< Kept between frames, so the bins do not reallocate
+	size_t n_jobs; //< Jobs used in the current frame
+	std::vector<size_t> draw_starts; //< First triangle of every draw, in the current frame
+};
+
+#endif
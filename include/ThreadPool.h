@@ -0,0 +1,62 @@
+#ifndef _THREADPOOL_H__
+#define _THREADPOOL_H__
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * A fixed set of worker threads that run the iterations of
+ * a loop in parallel. The thread that calls parallelFor takes
+ * part in the work, so a pool of one thread runs everything
+ * on the calling thread.
+ */
+class ThreadPool {
+public:
+	/**
+	 * Creates a pool of n_threads threads, including the calling
+	 * thread. 0 means one thread per hardware thread.
+	 */
+	ThreadPool(unsigned int n_threads=0);
+	~ThreadPool();
+
+	inline unsigned int getNumThreads() const {return n_threads;}
+
+	/**
+	 * Calls function(i) for every i in [0, count) and returns when
+	 * all calls are done. Iterations are handed out one at a time,
+	 * so uneven work is balanced between the threads. If function
+	 * throws, the remaining iterations are skipped and the first
+	 * exception is rethrown here. Must not be called from inside
+	 * function.
+	 */
+	void parallelFor(size_t count, const std::function<void(size_t)>& function);
+
+private:
+	ThreadPool(const ThreadPool&);
+	ThreadPool& operator=(const ThreadPool&);
+
+	void workerLoop();
+	void runIterations();
+
+	unsigned int n_threads;
+	std::vector<std::thread> workers;
+
+	std::mutex mutex; //< Protects everything below except next_index
+	std::condition_variable start_condition; //< Signals a new loop (or shutdown) to the workers
+	std::condition_variable done_condition; //< Signals the caller that all workers are done
+	unsigned long long generation; //< Incremented for every loop
+	unsigned int busy_workers;
+	bool stopping;
+
+	const std::function<void(size_t)>* loop_function;
+	size_t loop_count;
+	std::atomic<size_t> next_index;
+	std::exception_ptr loop_error;
+};
+
+#endif
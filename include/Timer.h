@@ -1,75 +1,188 @@
 #ifndef _TIMER_H_
 #define _TIMER_H_
 
-#ifdef _WIN32
-#include <sys/timeb.h>
-#include <windows.h>
-#include <time.h>
+#include <atomic>
+#include <chrono>
+#include <stdint.h>
+
+#if defined(TIMER_USE_TSC) && (defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86))
+#ifdef _MSC_VER
+#include <intrin.h>
 #else
-#include <sys/time.h>
-#include <unistd.h>
+#include <x86intrin.h>
+#endif
+#define TIMER_HAVE_TSC
 #endif
 
 
 /**
  *  A very basic timer class, suitable for FPS counters etc.
+ *  It runs on a monotonic clock with nanosecond resolution, so
+ *  it does not jump when the system time is adjusted.
  */
 class Timer {
 
 public:
-	Timer() : startTime_(getCurrentTime()) {};
+	Timer() : startTime_(getNanoseconds()) {};
 
 	/**
 	 * Report the elapsed time in seconds (it will return a double,
 	 * so the fractional part is subsecond part).
 	 */
 	inline double elapsed() const {
-		return getCurrentTime() - startTime_;
+		return (getNanoseconds() - startTime_) * 1e-9;
+	};
+
+	/**
+	 * Report the elapsed time in nanoseconds.
+	 */
+	inline uint64_t elapsedNanoseconds() const {
+		return getNanoseconds() - startTime_;
 	};
 
-	/** 
+	/**
 	 * Report the elapsed time in seconds, and reset the timer.
 	 */
 	inline double elapsedAndRestart() {
-		double now = getCurrentTime();
-		double elapsed = now - startTime_;
+		uint64_t now = getNanoseconds();
+		uint64_t elapsed = now - startTime_;
 		startTime_ = now;
-		return elapsed;
+		return elapsed * 1e-9;
 	};
 
 	/**
 	 * Restart the timer.
 	 */
 	inline void restart() {
-		startTime_ = getCurrentTime();
+		startTime_ = getNanoseconds();
 	};
 
-	/** 
-	 * Return the current time as number of elapsed seconds of this day.
+	/**
+	 * Return the current time as number of seconds since
+	 * an arbitrary point, like the start of the system.
 	 */
 	double static getCurrentTime() {
-#ifdef WIN32
-#if 1
-    LARGE_INTEGER f;
-    LARGE_INTEGER t;
-    QueryPerformanceFrequency(&f);
-    QueryPerformanceCounter(&t);
-    return t.QuadPart/(double) f.QuadPart;
-#else
-    struct _timeb ts;
-		_ftime(&ts);
-		return (ts.time + 0.001 * ts.millitm);
-#endif
+		return getNanoseconds() * 1e-9;
+	};
+
+	/**
+	 * Return the current time in nanoseconds since an arbitrary point.
+	 */
+	static inline uint64_t getNanoseconds() {
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count());
+	};
+
+	/**
+	 * The cheapest clock there is, for timing very short scopes: the
+	 * time stamp counter of the CPU with TIMER_USE_TSC defined (on x86),
+	 * nanoseconds otherwise. getTickSeconds() converts them to seconds.
+	 */
+	static inline uint64_t getTicks() {
+#ifdef TIMER_HAVE_TSC
+		return __rdtsc();
 #else
-    struct timeval tv;
-    struct timezone tz;
-    gettimeofday(&tv, &tz);
-    return tv.tv_sec+tv.tv_usec*1e-6;
+		return getNanoseconds();
 #endif
-  };
+	};
+
+	/**
+	 * Seconds per tick of getTicks(). With the time stamp counter, it
+	 * is measured against the monotonic clock on the first call.
+	 */
+	static double getTickSeconds();
+
+
+private:
+	uint64_t startTime_; //< Nanoseconds
+};
+
+
+/**
+ * A named total of time, to see where the time of a phase that runs
+ * many times goes, for example per frame. The scopes to time are
+ * marked with TIMED_SCOPE, which adds their time to an accumulator of
+ * that name. Accumulators live as long as the program, and
+ * TimerAccumulator::printAll() lists all of them.
+ *
+ * Adding is two relaxed atomic additions, so scopes can be timed on
+ * several threads at once. TIMED_SCOPE and PRINT_TIMED_SCOPES compile to
+ * nothing unless TIMED_SCOPES is defined.
+ */
+class TimerAccumulator {
+public:
+	/**
+	 * Creates an accumulator and registers it for printAll(). Meant for
+	 * objects with static storage duration, as TIMED_SCOPE creates.
+	 */
+	TimerAccumulator(const char* name);
+
+	inline void add(uint64_t ticks) {
+		total_ticks.fetch_add(ticks, std::memory_order_relaxed);
+		count.fetch_add(1, std::memory_order_relaxed);
+	};
+
+	inline const char* getName() const {return name;}
+	inline uint64_t getCount() const {return count.load(std::memory_order_relaxed);}
+	inline double getSeconds() const {return total_ticks.load(std::memory_order_relaxed) * Timer::getTickSeconds();}
+
+	/**
+	 * Sets every accumulator back to zero
+	 */
+	static void resetAll();
+
+	/**
+	 * Prints the total time, number of calls and time per call of every
+	 * accumulator that was used, summing the ones with the same name
+	 */
+	static void printAll();
+
+private:
+	TimerAccumulator(const TimerAccumulator&);
+	TimerAccumulator& operator=(const TimerAccumulator&);
+
+	const char* name;
+	std::atomic<uint64_t> total_ticks;
+	std::atomic<uint64_t> count;
+	TimerAccumulator* next; //< The accumulator registered before this one
+};
+
 
+/**
+ * Adds the time from its construction to its destruction to an accumulator
+ */
+class ScopedTimer {
+public:
+	inline ScopedTimer(TimerAccumulator& accumulator) : accumulator(accumulator), start(Timer::getTicks()) {};
+	inline ~ScopedTimer() {
+		accumulator.add(Timer::getTicks() - start);
+	};
 
 private:
-	double startTime_;
+	ScopedTimer(const ScopedTimer&);
+	ScopedTimer& operator=(const ScopedTimer&);
+
+	TimerAccumulator& accumulator;
+	uint64_t start;
 };
+
+
+#define TIMER_CONCATENATE_(a, b) a##b
+#define TIMER_CONCATENATE(a, b) TIMER_CONCATENATE_(a, b)
+
+#ifdef TIMED_SCOPES
+/**
+ * Adds the time until the end of the enclosing scope to the accumulator
+ * called name (a string literal)
+ */
+#define TIMED_SCOPE(name) TIMED_SCOPE_WITH_ID(name, __COUNTER__)
+#define TIMED_SCOPE_WITH_ID(name, id) \
+	static TimerAccumulator TIMER_CONCATENATE(timer_accumulator_, id)(name); \
+	ScopedTimer TIMER_CONCATENATE(scoped_timer_, id)(TIMER_CONCATENATE(timer_accumulator_, id))
+#define PRINT_TIMED_SCOPES() TimerAccumulator::printAll()
+#else
+#define TIMED_SCOPE(name) do {} while (0)
+#define PRINT_TIMED_SCOPES() do {} while (0)
+#endif
+
 #endif // _TIMER_H_
@@ -0,0 +1,60 @@
+#ifndef _TRANSFORMKERNEL_H__
+#define _TRANSFORMKERNEL_H__
+
+#include <cstddef>
+
+#include <glm/glm.hpp>
+
+/**
+ * Batch computation of the matrices every part of a model is drawn with.
+ * The SIMD versions are picked at runtime from what the CPU supports, so
+ * one binary runs everywhere.
+ */
+namespace TransformKernel {
+
+	/**
+	 * The matrices one part is drawn with. The normal matrix is stored as
+	 * three vec4 columns, which is how std140 lays out a mat3, so an array
+	 * of these can be uploaded to a uniform buffer as is.
+	 */
+	struct DrawTransform {
+		glm::mat4 modelview_matrix;
+		glm::vec4 normal_matrix[3];
+	};
+
+	enum Implementation {
+		SCALAR,
+		SSE, //< SSE2, 4 floats at a time
+		AVX2 //< AVX2 + FMA, two matrix columns at a time
+	};
+
+	/**
+	 * The fastest implementation the CPU supports
+	 */
+	Implementation getBestImplementation();
+
+	bool isSupported(Implementation implementation);
+	const char* getName(Implementation implementation);
+
+	/**
+	 * For i = 0 .. count-1, with n = nodes[i] (or n = i if nodes is NULL),
+	 * computes
+	 *   out[i].modelview_matrix = view_model * world[n]
+	 *   out[i].normal_matrix = view_model_normal * world_normal[n]
+	 * where the normal matrices are the upper 3x3 of the mat4s. With the
+	 * normal matrices of the parts precomputed (see MeshHierarchy), this
+	 * gives the transpose of the inverse of the modelview matrix without
+	 * inverting anything per part.
+	 */
+	void transformParts(const glm::mat4& view_model, const glm::mat4& view_model_normal,
+			const glm::mat4* world, const glm::mat4* world_normal, const unsigned int* nodes, size_t count, DrawTransform* out);
+
+	/**
+	 * Same as above, with a given implementation, which must be supported
+	 */
+	void transformParts(Implementation implementation, const glm::mat4& view_model, const glm::mat4& view_model_normal,
+			const glm::mat4* world, const glm::mat4* world_normal, const unsigned int* nodes, size_t count, DrawTransform* out);
+
+};
+
+#endif
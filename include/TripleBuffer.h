@@ -0,0 +1,76 @@
+#ifndef _TRIPLEBUFFER_H__
+#define _TRIPLEBUFFER_H__
+
+#include <atomic>
+
+/**
+ * Hands the latest value of something from one thread to another,
+ * without locks and without either thread ever waiting for the other.
+ * The producer writes into its own buffer and publishes it; the
+ * consumer picks up the most recently published buffer, skipping the
+ * ones it was too slow to see. Meant for state that is snapshotted
+ * whole, like the camera, where only the newest one matters.
+ *
+ * There are three buffers: the producer's, the consumer's, and the
+ * one in the middle. Publishing and picking up swap a buffer with the
+ * middle one in one atomic exchange, so each thread always owns its
+ * buffer alone. Exactly one thread may produce, and one consume.
+ */
+template <typename T>
+class TripleBuffer {
+public:
+	TripleBuffer() : middle(1), write_index(0), read_index(2) {}
+
+	/**
+	 * The buffer the producer writes the next value into. It keeps
+	 * whatever was in it before, which is not necessarily the value
+	 * published last.
+	 */
+	inline T& getWriteBuffer() {return buffers[write_index];}
+
+	/**
+	 * Makes the write buffer the latest value (producer only)
+	 */
+	inline void publish() {
+		unsigned int old = middle.exchange(write_index | new_flag, std::memory_order_acq_rel);
+		write_index = old & index_mask;
+	}
+
+	/**
+	 * Whether a value was published since the consumer last picked one up
+	 */
+	inline bool hasNew() const {
+		return (middle.load(std::memory_order_acquire) & new_flag) != 0;
+	}
+
+	/**
+	 * Picks up the latest value, if there is a new one, and returns
+	 * whether there was (consumer only)
+	 */
+	inline bool update() {
+		if (!hasNew())
+			return false;
+		unsigned int old = middle.exchange(read_index, std::memory_order_acq_rel);
+		read_index = old & index_mask;
+		return true;
+	}
+
+	/**
+	 * The value picked up last by update() (consumer only)
+	 */
+	inline const T& getReadBuffer() const {return buffers[read_index];}
+
+private:
+	TripleBuffer(const TripleBuffer&);
+	TripleBuffer& operator=(const TripleBuffer&);
+
+	static const unsigned int index_mask = 3;
+	static const unsigned int new_flag = 4; //< Set in middle when it holds an unread value
+
+	T buffers[3];
+	std::atomic<unsigned int> middle; //< Index of the middle buffer, and new_flag
+	unsigned int write_index; //< Owned by the producer
+	unsigned int read_index; //< Owned by the consumer
+};
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef _VERTEXQUANTIZER_H__
+#define _VERTEXQUANTIZER_H__
+
+#include <cstddef>
+#include <stdint.h>
+
+#include <glm/glm.hpp>
+
+/**
+ * Packs the interleaved float vertices (position and normal, 24 bytes)
+ * into 12 bytes. Positions become 16-bit integers spread over the
+ * bounding box of the model, and are drawn as unnormalized GL_SHORT: the
+ * integers reach the shader as they are, and the transform back to the
+ * bounding box goes in front of the modelview matrix. Normals become
+ * GL_INT_2_10_10_10_REV, normalized, which the shader reads as floats.
+ * The shader is the same for both layouts.
+ */
+namespace VertexQuantizer {
+
+	struct QuantizedVertex {
+		int16_t position[4]; //< The fourth is padding, to keep the normal aligned
+		uint32_t normal; //< x, y and z in 10 bits each, from the lowest bits up
+	};
+
+	/**
+	 * The largest difference between the original and the drawn vertices
+	 */
+	struct Error {
+		Error() {
+			position = 0.0f;
+			normal_degrees = 0.0f;
+		}
+
+		float position; //< Distance, in the units of the model
+		float normal_degrees; //< Angle between the normals
+	};
+
+	/**
+	 * The transform from the quantized positions of vertices in the box
+	 * [min_dim, max_dim] back to the original positions
+	 */
+	glm::mat4 getDequantizationTransform(const glm::vec3& min_dim, const glm::vec3& max_dim);
+
+	/**
+	 * Quantizes n_vertices interleaved vertices (six floats each) into out,
+	 * and grows error to the largest error of them
+	 */
+	void quantize(const float* vertices, size_t n_vertices, const glm::vec3& min_dim, const glm::vec3& max_dim,
+			QuantizedVertex* out, Error& error);
+
+}
+
+#endif
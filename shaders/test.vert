@@ -1,21 +1,87 @@
-#version 130
-uniform mat4 projection_matrix;
-uniform mat4 modelview_matrix;
-uniform mat3 normal_matrix;
-
-in  vec3 position;
-in  vec3 normal;
-
-flat out vec3 color;
-smooth out vec3 v;
-smooth out vec3 l;
-smooth out vec3 normal_smooth;
-
-void main() {
-	vec4 pos = modelview_matrix * vec4(position, 1.0);
-	v = normalize(-pos.xyz);
-	l = normalize(vec3(200.0f, 200.0f, 200.0f) - pos.xyz);
-	gl_Position = projection_matrix * pos;
-	color = vec3(0.5f, 0.5f, 1.0f);
-	normal_smooth = normal_matrix*normal;
+#version 330 core
+#ifdef HAVE_DRAW_PARAMETERS
+#extension GL_ARB_shader_draw_parameters : require
+#endif
+
+uniform mat4 projection_matrix;
+uniform int draw_id; // Selects the matrices of the part being drawn
+
+// In a multi-draw call every draw gets its own gl_DrawIDARB, counting
+// from draw_id, for a single draw it is 0
+int getDrawId() {
+#ifdef HAVE_DRAW_PARAMETERS
+	return draw_id + gl_DrawIDARB;
+#else
+	return draw_id;
+#endif
+}
+
+#ifdef DRAW_DATA_TEXTURE_BUFFER
+// Seven RGBA32F texels per part: the four columns of the modelview
+// matrix, then the three columns of the normal matrix
+uniform samplerBuffer draw_transforms;
+
+mat4 getModelviewMatrix() {
+	int base = getDrawId() * 7;
+	return mat4(texelFetch(draw_transforms, base), texelFetch(draw_transforms, base + 1),
+		texelFetch(draw_transforms, base + 2), texelFetch(draw_transforms, base + 3));
+}
+
+mat3 getNormalMatrix() {
+	int base = getDrawId() * 7 + 4;
+	return mat3(texelFetch(draw_transforms, base).xyz, texelFetch(draw_transforms, base + 1).xyz,
+		texelFetch(draw_transforms, base + 2).xyz);
+}
+#else
+struct DrawTransform {
+	mat4 modelview_matrix;
+	mat3 normal_matrix;
+};
+
+// The chunk of parts the draw id indexes into
+layout(std140) uniform DrawTransforms {
+	DrawTransform draw_transforms[DRAW_DATA_CHUNK_SIZE];
+};
+
+mat4 getModelviewMatrix() {
+	return draw_transforms[getDrawId()].modelview_matrix;
+}
+
+mat3 getNormalMatrix() {
+	return draw_transforms[getDrawId()].normal_matrix;
+}
+#endif
+
+in  vec3 position;
+in  vec3 normal;
+
+#ifdef INSTANCED
+// The instances of a scene model share the matrices of its parts, which
+// leave out the view, and each has its own model matrix. Instances are
+// only turned and uniformly scaled, so the 3x3 part of their matrix also
+// transforms normals (the fragment shader normalizes them).
+in  mat4 instance_matrix;
+uniform mat4 view_matrix;
+#endif
+
+flat out vec3 color;
+smooth out vec3 v;
+smooth out vec3 l;
+smooth out vec3 normal_smooth;
+
+void main() {
+#ifdef INSTANCED
+	mat4 instance_view_matrix = view_matrix * instance_matrix;
+	mat4 modelview_matrix = instance_view_matrix * getModelviewMatrix();
+	mat3 normal_matrix = mat3(instance_view_matrix) * getNormalMatrix();
+#else
+	mat4 modelview_matrix = getModelviewMatrix();
+	mat3 normal_matrix = getNormalMatrix();
+#endif
+	vec4 pos = modelview_matrix * vec4(position, 1.0);
+	v = normalize(-pos.xyz);
+	l = normalize(vec3(200.0f, 200.0f, 200.0f) - pos.xyz);
+	gl_Position = projection_matrix * pos;
+	color = vec3(0.5f, 0.5f, 1.0f);
+	normal_smooth = normal_matrix*normal;
 }
\ No newline at end of file
@@ -0,0 +1,126 @@
+#include "BoundingVolumeHierarchy.h"
+
+#include <algorithm>
+
+BoundingVolumeHierarchy::BoundingVolumeHierarchy() : n_hierarchy_nodes(0), built(false), built_version(0) {
+
+}
+
+BoundingVolumeHierarchy::~BoundingVolumeHierarchy() {
+
+}
+
+void BoundingVolumeHierarchy::update(const MeshHierarchy& hierarchy) {
+	if (built && hierarchy.getVersion() == built_version && hierarchy.size() == n_hierarchy_nodes)
+		return;
+
+	n_hierarchy_nodes = hierarchy.size();
+	part_min.resize(n_hierarchy_nodes);
+	part_max.resize(n_hierarchy_nodes);
+	parts.clear();
+	for (unsigned int i = 0; i < n_hierarchy_nodes; ++i) {
+		if (hierarchy.getCount(i) == 0 || !hierarchy.hasBounds(i))
+			continue;
+		part_min[i] = hierarchy.getWorldBoundsMin(i);
+		part_max[i] = hierarchy.getWorldBoundsMax(i);
+		parts.push_back(i);
+	}
+
+	nodes.clear();
+	if (!parts.empty()) {
+		nodes.reserve(2 * (parts.size() / max_leaf_parts + 1));
+		build(0, size());
+	}
+
+	built = true;
+	built_version = hierarchy.getVersion();
+}
+
+unsigned int BoundingVolumeHierarchy::build(unsigned int first, unsigned int count) {
+	unsigned int index = static_cast<unsigned int>(nodes.size());
+	nodes.push_back(Node());
+
+	Node node;
+	node.first = first;
+	node.count = count;
+	node.right = 0;
+	node.min = part_min[parts[first]];
+	node.max = part_max[parts[first]];
+	glm::vec3 center_min = (node.min + node.max) * 0.5f;
+	glm::vec3 center_max = center_min;
+	for (unsigned int i = first + 1; i < first + count; ++i) {
+		unsigned int part = parts[i];
+		node.min = glm::min(node.min, part_min[part]);
+		node.max = glm::max(node.max, part_max[part]);
+		glm::vec3 center = (part_min[part] + part_max[part]) * 0.5f;
+		center_min = glm::min(center_min, center);
+		center_max = glm::max(center_max, center);
+	}
+
+	if (count > max_leaf_parts) {
+		// Split at the median of the centers along the axis they spread the most
+		glm::vec3 extent = center_max - center_min;
+		int axis = (extent.x > extent.y) ? 0 : 1;
+		if (extent.z > extent[axis])
+			axis = 2;
+
+		unsigned int half = count / 2;
+		std::vector<unsigned int>::iterator begin = parts.begin() + first;
+		std::nth_element(begin, begin + half, begin + count, [&](unsigned int a, unsigned int b) {
+			return part_min[a][axis] + part_max[a][axis] < part_min[b][axis] + part_max[b][axis];
+		});
+
+		build(first, half);
+		node.right = build(first + half, count - half);
+	}
+
+	nodes[index] = node;
+	return index;
+}
+
+unsigned int BoundingVolumeHierarchy::cull(const Frustum& frustum, std::vector<unsigned char>& visible) const {
+	visible.assign(n_hierarchy_nodes, 0);
+	if (nodes.empty())
+		return 0;
+
+	unsigned int n_visible = 0;
+	struct Entry {
+		unsigned int node;
+		unsigned int plane_mask; //< Planes the parent was not entirely inside of
+	};
+	Entry stack[64];
+	unsigned int stack_size = 0;
+	Entry root = { 0, Frustum::all_planes };
+	stack[stack_size++] = root;
+
+	while (stack_size > 0) {
+		Entry entry = stack[--stack_size];
+		const Node& node = nodes[entry.node];
+
+		Frustum::Result result = frustum.test(node.min, node.max, entry.plane_mask);
+		if (result == Frustum::OUTSIDE)
+			continue;
+
+		if (node.right == 0 || result == Frustum::INSIDE) {
+			// A leaf, or the whole subtree is visible: no need to test each part
+			bool test_parts = (result != Frustum::INSIDE && node.count > 1);
+			for (unsigned int i = node.first; i < node.first + node.count; ++i) {
+				unsigned int part = parts[i];
+				if (test_parts) {
+					unsigned int plane_mask = entry.plane_mask;
+					if (frustum.test(part_min[part], part_max[part], plane_mask) == Frustum::OUTSIDE)
+						continue;
+				}
+				visible[part] = 1;
+				++n_visible;
+			}
+			continue;
+		}
+
+		Entry left = { entry.node + 1, entry.plane_mask };
+		Entry right = { node.right, entry.plane_mask };
+		stack[stack_size++] = right;
+		stack[stack_size++] = left;
+	}
+	return n_visible;
+}
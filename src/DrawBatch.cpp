@@ -0,0 +1,132 @@
+#include "DrawBatch.h"
+
+#include <algorithm>
+
+DrawBatch::DrawBatch(bool use_indirect) : use_indirect(use_indirect), commands_uploaded(false), command_instances(1), n_culled(0), n_triangles(0),
+		built_size(0), built_indices(0), built_per_frame(false) {
+	if (use_indirect)
+		indirect_buffer.reset(new GLUtils::StreamBuffer(GL_DRAW_INDIRECT_BUFFER));
+}
+
+DrawBatch::~DrawBatch() {
+
+}
+
+bool DrawBatch::isSupported() {
+	return GLEW_ARB_shader_draw_parameters || GLEW_VERSION_4_6;
+}
+
+bool DrawBatch::isIndirectSupported() {
+	return GLEW_ARB_multi_draw_indirect || GLEW_VERSION_4_3;
+}
+
+std::string DrawBatch::getShaderDefines() {
+	return "#define HAVE_DRAW_PARAMETERS\n";
+}
+
+void DrawBatch::update(const MeshHierarchy& hierarchy, unsigned int available_indices, size_t index_size,
+		const unsigned char* visible, const unsigned char* levels) {
+	bool per_frame = (visible != NULL || levels != NULL);
+	if (!per_frame && !built_per_frame && hierarchy.size() == built_size && available_indices == built_indices)
+		return;
+
+	nodes.clear();
+	counts.clear();
+	offsets.clear();
+	commands.clear();
+	n_culled = 0;
+	n_triangles = 0;
+	level_draws.assign(hierarchy.getNumLevels(), 0);
+
+	for (unsigned int i = 0; i < hierarchy.size(); ++i) {
+		//The coarser levels are uploaded after the full one
+		unsigned int level = (levels != NULL) ? levels[i] : 0;
+		if (hierarchy.getFirst(i, level) + hierarchy.getCount(i, level) > available_indices)
+			level = 0;
+
+		//Only draw the part of the mesh that has been uploaded so far
+		unsigned int first = hierarchy.getFirst(i, level);
+		if (hierarchy.getCount(i, level) == 0 || first >= available_indices)
+			continue;
+		unsigned int count = std::min(hierarchy.getCount(i, level), available_indices - first);
+		if (visible != NULL && !visible[i]) {
+			++n_culled;
+			continue;
+		}
+
+		nodes.push_back(i);
+		n_triangles += count / 3;
+		++level_draws[level];
+		counts.push_back(static_cast<GLsizei>(count));
+		offsets.push_back(reinterpret_cast<const GLvoid*>(static_cast<size_t>(first) * index_size));
+
+		if (use_indirect) {
+			DrawElementsIndirectCommand command = { count, command_instances, first, 0, 0 };
+			commands.push_back(command);
+		}
+	}
+	commands_uploaded = false;
+
+	built_size = hierarchy.size();
+	built_indices = available_indices;
+	built_per_frame = per_frame;
+}
+
+unsigned int DrawBatch::draw(GLenum index_type, DrawDataBuffer& draw_data, const GLUtils::Uniform<GLint>& draw_id,
+		unsigned int instances) {
+	//There is no instanced glMultiDrawElements
+	if (!use_indirect && instances != 1)
+		return drawSeparately(index_type, draw_data, draw_id, instances);
+
+	unsigned int n_draws = size();
+	unsigned int parts_per_call = draw_data.getPartsPerCall();
+	unsigned int n_calls = 0;
+
+	if (use_indirect) {
+		if (instances != command_instances) {
+			for (unsigned int i = 0; i < commands.size(); ++i)
+				commands[i].instance_count = instances;
+			command_instances = instances;
+			commands_uploaded = false;
+		}
+
+		//Only upload the commands when the list changed
+		if (!commands_uploaded) {
+			indirect_buffer->upload(commands.empty() ? NULL : &commands[0], commands.size() * sizeof(DrawElementsIndirectCommand));
+			commands_uploaded = true;
+		}
+		indirect_buffer->bind();
+	}
+
+	//One call per chunk of the draw data, gl_DrawIDARB starts at 0 in each
+	for (unsigned int first = 0; first < n_draws; first += parts_per_call) {
+		GLsizei n_call_draws = static_cast<GLsizei>(std::min(parts_per_call, n_draws - first));
+		draw_id.set(draw_data.selectDraw(first));
+
+		if (use_indirect) {
+			const GLvoid* commands_offset = reinterpret_cast<const GLvoid*>(first * sizeof(DrawElementsIndirectCommand));
+			glMultiDrawElementsIndirect(GL_TRIANGLES, index_type, commands_offset, n_call_draws, 0);
+		}
+		else {
+			glMultiDrawElements(GL_TRIANGLES, &counts[first], index_type, &offsets[first], n_call_draws);
+		}
+		++n_calls;
+	}
+
+	if (use_indirect)
+		indirect_buffer->unbind();
+
+	return n_calls;
+}
+
+unsigned int DrawBatch::drawSeparately(GLenum index_type, DrawDataBuffer& draw_data, const GLUtils::Uniform<GLint>& draw_id,
+		unsigned int instances) {
+	for (unsigned int i = 0; i < size(); ++i) {
+		draw_id.set(draw_data.selectDraw(i));
+		if (instances == 1)
+			glDrawElements(GL_TRIANGLES, counts[i], index_type, offsets[i]);
+		else
+			glDrawElementsInstanced(GL_TRIANGLES, counts[i], index_type, offsets[i], instances);
+	}
+	return size();
+}
@@ -0,0 +1,102 @@
+#include "DrawDataBuffer.h"
+
+#include "GameException.h"
+
+#include <algorithm>
+#include <sstream>
+
+namespace {
+	const unsigned int no_chunk = ~0u;
+
+	unsigned int greatestCommonDivisor(unsigned int a, unsigned int b) {
+		while (b != 0) {
+			unsigned int t = a % b;
+			a = b;
+			b = t;
+		}
+		return a;
+	}
+}
+
+DrawDataBuffer::DrawDataBuffer(Mode mode) : mode(mode), texture(0), parts_per_chunk(1), bound_chunk(no_chunk), n_parts(0) {
+	if (mode == UNIFORM_BUFFER) {
+		buffer.reset(new GLUtils::StreamBuffer(GL_UNIFORM_BUFFER));
+
+		GLint max_block_size, offset_alignment;
+		glGetIntegerv(GL_MAX_UNIFORM_BLOCK_SIZE, &max_block_size);
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &offset_alignment);
+
+		// A chunk has to start at a multiple of the offset alignment, so
+		// the number of parts in it is a multiple of alignment / gcd(...).
+		// Stay at 64 KiB, drivers reporting more tend to be slow with it.
+		unsigned int part_size = sizeof(TransformKernel::DrawTransform);
+		unsigned int alignment = static_cast<unsigned int>(std::max(offset_alignment, 1));
+		unsigned int step = alignment / greatestCommonDivisor(part_size, alignment);
+		unsigned int max_parts = static_cast<unsigned int>(std::min(max_block_size, 65536)) / part_size;
+		parts_per_chunk = (max_parts / step) * step;
+		if (parts_per_chunk == 0)
+			THROW_EXCEPTION("Uniform blocks are too small for the per draw data");
+	}
+	else {
+		buffer.reset(new GLUtils::StreamBuffer(GL_TEXTURE_BUFFER));
+		buffer->reserve(sizeof(TransformKernel::DrawTransform));
+		glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_BUFFER, texture);
+		glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, buffer->name());
+		glBindTexture(GL_TEXTURE_BUFFER, 0);
+	}
+	CHECK_GL_ERROR();
+}
+
+DrawDataBuffer::~DrawDataBuffer() {
+	if (texture != 0)
+		glDeleteTextures(1, &texture);
+}
+
+std::string DrawDataBuffer::getShaderDefines() const {
+	std::stringstream defines;
+	if (mode == TEXTURE_BUFFER)
+		defines << "#define DRAW_DATA_TEXTURE_BUFFER" << std::endl;
+	else
+		defines << "#define DRAW_DATA_CHUNK_SIZE " << parts_per_chunk << std::endl;
+	return defines.str();
+}
+
+void DrawDataBuffer::attachProgram(GLUtils::Program& program) {
+	if (mode == UNIFORM_BUFFER)
+		program.setUniformBlockBinding("DrawTransforms", block_binding);
+	else {
+		GLint unit = texture_unit;
+		program.getUniformHandle<GLint>("draw_transforms").set(unit);
+	}
+}
+
+void DrawDataBuffer::upload(const std::vector<TransformKernel::DrawTransform>& transforms) {
+	n_parts = transforms.size();
+	size_t bytes = n_parts * sizeof(TransformKernel::DrawTransform);
+
+	// Every chunk is bound at its full size, so the storage has to cover
+	// the last chunk completely
+	if (mode == UNIFORM_BUFFER) {
+		size_t chunk_bytes = parts_per_chunk * sizeof(TransformKernel::DrawTransform);
+		size_t n_chunks = std::max<size_t>(1, (n_parts + parts_per_chunk - 1) / parts_per_chunk);
+		buffer->reserve(n_chunks * chunk_bytes);
+	}
+
+	buffer->upload(transforms.empty() ? NULL : &transforms[0], bytes);
+	bound_chunk = no_chunk;
+}
+
+void DrawDataBuffer::bind() {
+	if (mode == TEXTURE_BUFFER) {
+		glActiveTexture(GL_TEXTURE0 + texture_unit);
+		glBindTexture(GL_TEXTURE_BUFFER, texture);
+	}
+	bound_chunk = no_chunk;
+}
+
+void DrawDataBuffer::bindChunk(unsigned int chunk) {
+	size_t chunk_bytes = parts_per_chunk * sizeof(TransformKernel::DrawTransform);
+	buffer->bindRange(block_binding, chunk * chunk_bytes, chunk_bytes);
+	bound_chunk = chunk;
+}
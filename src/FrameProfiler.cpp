@@ -0,0 +1,229 @@
+#include "FrameProfiler.h"
+
+#include "GameException.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace {
+	// Value at fraction p of the sorted values
+	double percentile(std::vector<double>& values, double p) {
+		if (values.empty())
+			return 0.0;
+		size_t n = std::min(values.size() - 1, static_cast<size_t>(p * values.size()));
+		std::nth_element(values.begin(), values.begin() + n, values.end());
+		return values[n];
+	}
+}
+
+FrameProfiler::FrameProfiler(bool gpu_timing) : gpu_timing(gpu_timing), next_query(0), phase_start(0.0), frame_interval(0.0), idle_start(-1.0), idle(0.0),
+		phase(EVENTS), n_frames(0), print_interval(0.0), last_print(0.0) {
+	this->gpu_timing = gpu_timing && (GLEW_ARB_timer_query || GLEW_VERSION_3_3);
+	if (gpu_timing && !this->gpu_timing)
+		std::cout << "GL_ARB_timer_query is not supported, frames are profiled without their GPU time" << std::endl;
+	if (this->gpu_timing)
+		glGenQueries(n_queries, queries);
+	std::fill(query_busy, query_busy + n_queries, false);
+	current = Frame();
+	current.start = -1.0;
+}
+
+FrameProfiler::~FrameProfiler() {
+	if (gpu_timing)
+		glDeleteQueries(n_queries, queries);
+}
+
+void FrameProfiler::openCsv(const std::string& filename) {
+	csv.open(filename.c_str());
+	if (!csv.good())
+		THROW_EXCEPTION("Could not write " + filename);
+
+	csv << "frame,time_s,interval_ms";
+	for (int i = 0; i < n_phases; ++i)
+		csv << "," << getPhaseName(static_cast<Phase>(i)) << "_ms";
+	csv << ",cpu_ms,gpu_ms,draw_calls,triangles" << std::endl;
+}
+
+void FrameProfiler::beginFrame() {
+	double now = clock.elapsed();
+	frame_interval = (current.start >= 0.0) ? now - current.start - idle : 0.0;
+	idle = 0.0;
+
+	current = Frame();
+	current.index = n_frames++;
+	current.start = now;
+	current.interval = frame_interval * 1000.0;
+	current.gpu = -1.0;
+	current.query = -1;
+	phase = EVENTS;
+	phase_start = now;
+
+	// A frame gets no GPU time if its query is still in use by a frame
+	// a few frames back, rather than waiting for the GPU. The first frame
+	// is not measured either, as some drivers count the time since the
+	// context was created in the first query.
+	if (gpu_timing) {
+		collectQueries(false);
+		reportFrames();
+		if (!query_busy[next_query] && n_frames > 1) {
+			glBeginQuery(GL_TIME_ELAPSED, queries[next_query]);
+			query_busy[next_query] = true;
+			current.query = static_cast<int>(next_query);
+			next_query = (next_query + 1) % n_queries;
+		}
+	}
+}
+
+void FrameProfiler::beginIdle() {
+	idle_start = clock.elapsed();
+}
+
+void FrameProfiler::endIdle() {
+	if (idle_start >= 0.0)
+		idle += clock.elapsed() - idle_start;
+	idle_start = -1.0;
+}
+
+void FrameProfiler::beginPhase(Phase phase) {
+	double now = clock.elapsed();
+	current.phases[this->phase] += (now - phase_start) * 1000.0;
+	this->phase = phase;
+	phase_start = now;
+}
+
+void FrameProfiler::endFrame(size_t draw_calls, size_t triangles) {
+	double now = clock.elapsed();
+	current.phases[phase] += (now - phase_start) * 1000.0;
+	current.cpu = (now - current.start) * 1000.0;
+	current.draw_calls = draw_calls;
+	current.triangles = triangles;
+	if (current.query >= 0)
+		glEndQuery(GL_TIME_ELAPSED);
+
+	pending.push_back(current);
+	reportFrames();
+
+	if (print_interval > 0.0 && now - last_print >= print_interval) {
+		print();
+		last_print = now;
+	}
+}
+
+void FrameProfiler::finish() {
+	if (gpu_timing)
+		collectQueries(true);
+	reportFrames();
+	print();
+}
+
+void FrameProfiler::collectQueries(bool wait) {
+	// Queries finish in the order they were issued
+	for (size_t i = 0; i < pending.size(); ++i) {
+		Frame& frame = pending[i];
+		if (frame.query < 0)
+			continue;
+
+		GLuint query = queries[frame.query];
+		if (!wait) {
+			GLint available = GL_FALSE;
+			glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+			if (!available)
+				break;
+		}
+		GLuint64 nanoseconds = 0;
+		glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+		frame.gpu = nanoseconds * 1e-6;
+		query_busy[frame.query] = false;
+		frame.query = -1;
+	}
+}
+
+void FrameProfiler::reportFrames() {
+	while (!pending.empty() && pending.front().query < 0) {
+		report(pending.front());
+		pending.pop_front();
+	}
+}
+
+void FrameProfiler::report(const Frame& frame) {
+	history.push_back(frame);
+	if (history.size() > window_size)
+		history.pop_front();
+
+	if (csv.is_open()) {
+		csv << frame.index << "," << frame.start << "," << frame.interval;
+		for (int i = 0; i < n_phases; ++i)
+			csv << "," << frame.phases[i];
+		csv << "," << frame.cpu << ",";
+		if (frame.gpu >= 0.0)
+			csv << frame.gpu;
+		csv << "," << frame.draw_calls << "," << frame.triangles << "\n";
+	}
+}
+
+void FrameProfiler::print() const {
+	if (history.empty())
+		return;
+
+	// Percentiles of the frame interval, every phase, and the CPU and GPU time
+	const unsigned int n_rows = n_phases + 3;
+	std::vector<double> values[n_rows];
+	size_t draw_calls = 0, triangles = 0;
+	for (size_t i = 0; i < history.size(); ++i) {
+		const Frame& frame = history[i];
+		values[0].push_back(frame.interval);
+		for (int j = 0; j < n_phases; ++j)
+			values[1 + j].push_back(frame.phases[j]);
+		values[n_phases + 1].push_back(frame.cpu);
+		if (frame.gpu >= 0.0)
+			values[n_phases + 2].push_back(frame.gpu);
+		draw_calls += frame.draw_calls;
+		triangles += frame.triangles;
+	}
+
+	std::cout << "Frames " << history.front().index << "-" << history.back().index << ":" << std::endl;
+	std::cout << "  " << std::setw(8) << "ms" << std::setw(9) << "p50" << std::setw(9) << "p95" << std::setw(9) << "p99" << std::endl;
+	std::ios::fmtflags flags = std::cout.flags();
+	std::cout << std::fixed << std::setprecision(3);
+	for (unsigned int i = 0; i < n_rows; ++i) {
+		if (values[i].empty())
+			continue;
+		const char* name = (i == 0) ? "frame" : (i <= n_phases) ? getPhaseName(static_cast<Phase>(i - 1))
+			: (i == n_phases + 1) ? "cpu" : "gpu";
+		std::cout << "  " << std::setw(8) << name << std::setw(9) << percentile(values[i], 0.5)
+			<< std::setw(9) << percentile(values[i], 0.95) << std::setw(9) << percentile(values[i], 0.99) << std::endl;
+	}
+	std::cout.flags(flags);
+	std::cout << "  draw calls per frame: " << draw_calls / history.size()
+		<< ", triangles per frame: " << triangles / history.size() << std::endl;
+}
+
+std::string FrameProfiler::getSummary() const {
+	std::vector<double> intervals, gpu;
+	for (size_t i = 0; i < history.size(); ++i) {
+		intervals.push_back(history[i].interval);
+		if (history[i].gpu >= 0.0)
+			gpu.push_back(history[i].gpu);
+	}
+
+	std::stringstream summary;
+	summary << std::fixed << std::setprecision(1) << "frame p50 " << percentile(intervals, 0.5)
+		<< " ms, p99 " << percentile(intervals, 0.99) << " ms";
+	if (!gpu.empty())
+		summary << ", gpu p50 " << percentile(gpu, 0.5) << " ms";
+	if (!history.empty())
+		summary << ", " << history.back().draw_calls << " draw calls, " << history.back().triangles << " triangles";
+	return summary.str();
+}
+
+const char* FrameProfiler::getPhaseName(Phase phase) {
+	switch (phase) {
+	case EVENTS: return "events";
+	case UPDATE: return "update";
+	case DRAW: return "draw";
+	case SWAP: return "swap";
+	default: return "unknown";
+	}
+}
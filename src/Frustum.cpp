@@ -0,0 +1,37 @@
+#include "Frustum.h"
+
+Frustum::Frustum(const glm::mat4& clip_matrix) {
+	// A point is inside when -w <= x, y, z <= w in clip space, so each plane
+	// is the fourth row of the matrix plus or minus one of the other rows
+	// (Gribb and Hartmann). glm stores the matrix column major.
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; ++i)
+		rows[i] = glm::vec4(clip_matrix[0][i], clip_matrix[1][i], clip_matrix[2][i], clip_matrix[3][i]);
+
+	for (int i = 0; i < 3; ++i) {
+		planes[2*i] = rows[3] + rows[i];
+		planes[2*i+1] = rows[3] - rows[i];
+	}
+}
+
+Frustum::Result Frustum::test(const glm::vec3& min, const glm::vec3& max, unsigned int& plane_mask) const {
+	Result result = INSIDE;
+	for (unsigned int i = 0; i < 6; ++i) {
+		if (!(plane_mask & (1 << i)))
+			continue;
+		const glm::vec4& plane = planes[i];
+
+		// The corner furthest along the normal decides if the box is
+		// outside, the nearest one if it is entirely inside
+		glm::vec3 far_corner(plane.x >= 0.0f ? max.x : min.x, plane.y >= 0.0f ? max.y : min.y, plane.z >= 0.0f ? max.z : min.z);
+		glm::vec3 near_corner(plane.x >= 0.0f ? min.x : max.x, plane.y >= 0.0f ? min.y : max.y, plane.z >= 0.0f ? min.z : max.z);
+
+		if (plane.x * far_corner.x + plane.y * far_corner.y + plane.z * far_corner.z + plane.w < 0.0f)
+			return OUTSIDE;
+		if (plane.x * near_corner.x + plane.y * near_corner.y + plane.z * near_corner.z + plane.w < 0.0f)
+			result = INTERSECTS;
+		else
+			plane_mask &= ~(1u << i);
+	}
+	return result;
+}
@@ -1,239 +1,1065 @@
-#include "GameManager.h"
-#include <iostream>
-#include <string>
-#include <sstream>
-#include <vector>
-#include <assert.h>
-#include <stdexcept>
-
-#include <glm/glm.hpp>
-#include <glm/gtc/matrix_transform.hpp>
-#include <glm/gtc/type_ptr.hpp>
-
-using std::cerr;
-using std::endl;
-using GLUtils::VBO;
-using GLUtils::Program;
-using GLUtils::readFile;
-
-GameManager::GameManager(std::string model) : m_zoom(0.0f), m_zoom_sensitivity(2.5f), m_fov(45.0f) {
-	my_timer.restart();
-	m_model = model;
-}
-
-GameManager::~GameManager() {
-}
-
-void GameManager::createOpenGLContext() {
-	//Set OpenGL major an minor versions
-	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
-	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
-
-	// Set OpenGL attributes
-	SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1); // Use double buffering
-	SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 16); // Use framebuffer with 16 bit depth buffer
-	SDL_GL_SetAttribute(SDL_GL_RED_SIZE, 8); // Use framebuffer with 8 bit for red
-	SDL_GL_SetAttribute(SDL_GL_GREEN_SIZE, 8); // Use framebuffer with 8 bit for green
-	SDL_GL_SetAttribute(SDL_GL_BLUE_SIZE, 8); // Use framebuffer with 8 bit for blue
-	SDL_GL_SetAttribute(SDL_GL_ALPHA_SIZE, 8); // Use framebuffer with 8 bit for alpha
-
-	// Initalize video
-	main_window = SDL_CreateWindow("Westerdals - PG6200 Assignment 2", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
-		window_width, window_height, SDL_WINDOW_OPENGL | SDL_WINDOW_SHOWN);
-	if (!main_window) {
-		THROW_EXCEPTION("SDL_CreateWindow failed");
-	}
-
-	//Create OpenGL context
-	main_context = SDL_GL_CreateContext(main_window);
-	trackball.setWindowSize(window_width, window_height);
-
-	// Init glew
-	// glewExperimental is required in openGL 3.3
-	// to create forward compatible contexts 
-	glewExperimental = GL_TRUE;
-	GLenum glewErr = glewInit();
-	if (glewErr != GLEW_OK) {
-		std::stringstream err;
-		err << "Error initializing GLEW: " << glewGetErrorString(glewErr);
-		THROW_EXCEPTION(err.str());
-	}
-
-	// Unfortunately glewInit generates an OpenGL error, but does what it's
-	// supposed to (setting function pointers for core functionality).
-	// Lets do the ugly thing of swallowing the error....
-	glGetError();
-}
-
-void GameManager::setOpenGLStates() {
-	glEnable(GL_DEPTH_TEST);
-	glDepthFunc(GL_LEQUAL);
-	glEnable(GL_CULL_FACE);
-	glCullFace(GL_BACK);
-	glClearColor(0.0, 0.0, 0.5, 1.0);
-}
-
-void GameManager::createMatrices() {
-	projection_matrix = glm::perspective(m_fov,	window_width / (float) window_height, 1.0f, 10.f);
-	
-	model_matrix = glm::scale(glm::mat4(1.0f), glm::vec3(3));
-	
-	view_matrix = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -5.0f));
-	
-}
-
-void GameManager::createSimpleProgram() {
-	std::string fs_src = readFile("shaders/test.frag");
-	std::string vs_src = readFile("shaders/test.vert");
-
-	//Compile shaders, attach to program object, and link
-	program.reset(new Program(vs_src, fs_src));
-
-	//Set uniforms for the program.
-	program->use();
-	glUniformMatrix4fv(program->getUniform("projection_matrix"), 1, 0, glm::value_ptr(projection_matrix));
-	program->disuse();
-}
-
-void GameManager::createVAO() {
-	glGenVertexArrays(1, &vao);
-	glBindVertexArray(vao);
-	CHECK_GL_ERROR();
-
-	model.reset(new Model(m_model.c_str(), false));
-	
-	GLint k = 6 * sizeof(float);
-
-	model->getVertices()->bind();
-	program->setAttributePointer("position", 3, GL_FLOAT, GL_FALSE, k, 0);
-	CHECK_GL_ERROR();
-	
-	program->setAttributePointer("normal", 3, GL_FLOAT, GL_FALSE, k, reinterpret_cast<void *>(3 * sizeof(float)));
-	CHECK_GL_ERROR();
-	
-	//Unbind VBOs and VAO
-	vertices->unbind(); //Unbinds both vertices and normals
-	glBindVertexArray(0);
-	CHECK_GL_ERROR();
-}
-
-void GameManager::init() {
-	// Initialize SDL
-	if (SDL_Init(SDL_INIT_EVERYTHING) < 0) {
-		std::stringstream err;
-		err << "Could not initialize SDL: " << SDL_GetError();
-		THROW_EXCEPTION(err.str());
-	}
-	atexit( SDL_Quit);
-
-	createOpenGLContext();
-	setOpenGLStates();
-	createMatrices();
-	createSimpleProgram();
-	createVAO();
-}
-
-void GameManager::renderMeshRecursive(MeshPart& mesh, const std::shared_ptr<Program>& program, 
-		const glm::mat4& view_matrix, const glm::mat4& model_matrix) {
-	//Create modelview matrix
-	glm::mat4 meshpart_model_matrix = model_matrix*mesh.transform;
-	glm::mat4 modelview_matrix = view_matrix*meshpart_model_matrix;
-	glUniformMatrix4fv(program->getUniform("modelview_matrix"), 1, 0, glm::value_ptr(modelview_matrix));
-
-	//Create normal matrix, the transpose of the inverse
-	//3x3 leading submatrix of the modelview matrix
-	glm::mat3 normal_matrix = glm::transpose(glm::inverse(glm::mat3(modelview_matrix)));
-	glUniformMatrix3fv(program->getUniform("normal_matrix"), 1, 0, glm::value_ptr(normal_matrix));
-
-	glDrawArrays(GL_TRIANGLES, mesh.first, mesh.count);
-	for (unsigned int i=0; i<mesh.children.size(); ++i)
-		renderMeshRecursive(mesh.children.at(i), program, view_matrix, meshpart_model_matrix);
-}
-
-void GameManager::render() {
-	//Clear screen, and set the correct program
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	program->use();
-	
-	glm::mat4 view_matrix_new = view_matrix*trackball_view_matrix;
-
-	// If the user is zooming, change fov
-	if(m_zoom != 0)
-	{
-		m_fov += m_zoom;
-		m_zoom = 0;
-
-#ifdef MORE_DEBUG_INFO
-		std::cout << "new fov: " << m_fov << std::endl;
-		std::cout << "Projection_matrix: \n" << GLUtils::mat4toString(projection_matrix) << std::endl;
-#endif
-
-		projection_matrix = glm::perspective(m_fov, window_width / static_cast<float>(window_height), 1.0f, 10.0f);
-
-		
-		glUniformMatrix4fv(program->getUniform("projection_matrix"), 1, 0, glm::value_ptr(projection_matrix));
-		
-	}
-
-	//Render geometry
-	glBindVertexArray(vao);
-	
-	renderMeshRecursive(model->getMesh(), program, view_matrix_new, model_matrix);
-
-	glBindVertexArray(0);
-	CHECK_GL_ERROR();
-}
-
-void GameManager::play() {
-	bool doExit = false;
-
-	//SDL main loop
-	while (!doExit) {
-		SDL_Event event;
-		while (SDL_PollEvent(&event)) {// poll for pending events
-			switch (event.type) {
-			case SDL_MOUSEBUTTONDOWN:
-				trackball.rotateBegin(event.motion.x, event.motion.y);
-				break;
-			case SDL_MOUSEBUTTONUP:
-				trackball.rotateEnd(event.motion.x, event.motion.y);
-				break;
-			case SDL_MOUSEMOTION:
-				trackball_view_matrix = trackball.rotate(event.motion.x, event.motion.y);
-				break;
-			case SDL_KEYDOWN:
-				if (event.key.keysym.sym == SDLK_ESCAPE) //Esc
-				{
-					doExit = true;
-				}
-				else
-				if (event.key.keysym.sym == SDLK_q
-						&& event.key.keysym.mod & KMOD_CTRL) //Ctrl+q
-				{
-					doExit = true;
-				}
-				else
-				if (event.key.keysym.sym == SDLK_PAGEUP)
-				{
-					m_zoom += m_zoom_sensitivity;
-				}
-				else
-				if (event.key.keysym.sym == SDLK_PAGEDOWN) {
-					m_zoom -= m_zoom_sensitivity;
-				}
-				break;
-			case SDL_QUIT: //e.g., user clicks the upper right x
-				doExit = true;
-				break;
-			}
-		}
-		//Render, and swap front and back buffers
-		render();
-		SDL_GL_SwapWindow(main_window);
-	}
-	quit();
-}
-
-void GameManager::quit() {
-	std::cout << "Bye bye..." << std::endl;
-}
+#include "GameManager.h"
+#include <iostream>
+#include <string>
+#include <sstream>
+#include <vector>
+#include <assert.h>
+#include <stdexcept>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <thread>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+using std::cerr;
+using std::endl;
+using GLUtils::VBO;
+using GLUtils::Program;
+using GLUtils::readFile;
+
+GameManager::GameManager(std::string model, const LoadOptions& load_options, const RenderOptions& render_options) : draw_calls(0), redraw(true), frame_period(0.0), culled_parts(0), model_uploaded(false), m_zoom(0.0f), m_zoom_sensitivity(2.5f), m_fov(45.0f), mouse_moved(false), mouse_x(0), mouse_y(0), title_event(0), snapshot_event(0), snapshot_waiting(false), stop_rendering(false) {
+	m_model = model;
+	m_load_options = load_options;
+	m_render_options = render_options;
+
+	if (Scene::isSceneFile(m_model))
+		scene.reset(new Scene(m_model));
+}
+
+GameManager::~GameManager() {
+}
+
+void GameManager::createOpenGLContext() {
+	//Set OpenGL major an minor versions
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
+
+	// Set OpenGL attributes
+	SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1); // Use double buffering
+	SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 16); // Use framebuffer with 16 bit depth buffer
+	SDL_GL_SetAttribute(SDL_GL_RED_SIZE, 8); // Use framebuffer with 8 bit for red
+	SDL_GL_SetAttribute(SDL_GL_GREEN_SIZE, 8); // Use framebuffer with 8 bit for green
+	SDL_GL_SetAttribute(SDL_GL_BLUE_SIZE, 8); // Use framebuffer with 8 bit for blue
+	SDL_GL_SetAttribute(SDL_GL_ALPHA_SIZE, 8); // Use framebuffer with 8 bit for alpha
+
+	// Initalize video
+	main_window = SDL_CreateWindow("Westerdals - PG6200 Assignment 2", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
+		window_width, window_height, SDL_WINDOW_OPENGL | SDL_WINDOW_SHOWN);
+	if (!main_window) {
+		THROW_EXCEPTION("SDL_CreateWindow failed");
+	}
+
+	//Create OpenGL context
+	main_context = SDL_GL_CreateContext(main_window);
+	trackball.setWindowSize(window_width, window_height);
+
+	// Init glew
+	// glewExperimental is required in openGL 3.3
+	// to create forward compatible contexts 
+	glewExperimental = GL_TRUE;
+	GLenum glewErr = glewInit();
+	if (glewErr != GLEW_OK) {
+		std::stringstream err;
+		err << "Error initializing GLEW: " << glewGetErrorString(glewErr);
+		THROW_EXCEPTION(err.str());
+	}
+
+	// Unfortunately glewInit generates an OpenGL error, but does what it's
+	// supposed to (setting function pointers for core functionality).
+	// Lets do the ugly thing of swallowing the error....
+	glGetError();
+}
+
+void GameManager::setupFramePacing() {
+	// Adaptive vsync is not supported everywhere, then wait for every vertical blank
+	int swap_interval = m_render_options.swap_interval;
+	if (SDL_GL_SetSwapInterval(swap_interval) != 0 && swap_interval < 0) {
+		std::cout << "Adaptive vsync is not supported, using vsync" << std::endl;
+		swap_interval = 1;
+		SDL_GL_SetSwapInterval(swap_interval);
+	}
+	bool vsync = (SDL_GL_GetSwapInterval() != 0);
+
+	// Without the vsync that was asked for, continuous rendering would draw
+	// as fast as it can, so the refresh rate of the display is the limit
+	double max_fps = m_render_options.max_fps;
+	if (max_fps <= 0.0 && swap_interval != 0 && !vsync) {
+		SDL_DisplayMode mode;
+		max_fps = (SDL_GetWindowDisplayMode(main_window, &mode) == 0 && mode.refresh_rate > 0) ? mode.refresh_rate : 60.0;
+	}
+	frame_period = (max_fps > 0.0) ? 1.0 / max_fps : 0.0;
+
+	std::cout << (m_render_options.continuous ? "Drawing continuously" : "Drawing when the view changes")
+		<< ", vsync " << (vsync ? "on" : "off");
+	if (frame_period > 0.0)
+		std::cout << ", at most " << max_fps << " frames per second";
+	std::cout << std::endl;
+}
+
+void GameManager::setOpenGLStates() {
+	glEnable(GL_DEPTH_TEST);
+	glDepthFunc(GL_LEQUAL);
+	glEnable(GL_CULL_FACE);
+	glCullFace(GL_BACK);
+	glClearColor(0.0, 0.0, 0.5, 1.0);
+}
+
+void GameManager::createMatrices() {
+	projection_matrix = glm::perspective(m_fov,	window_width / (float) window_height, 1.0f, 10.f);
+	
+	model_matrix = glm::scale(glm::mat4(1.0f), glm::vec3(3));
+
+	view_matrix = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -5.0f));
+
+	//A scene is fit into about the sphere the model would fill, so the
+	//same depth range takes all of it in, and looked at from 30 degrees
+	//above, as scenes are mostly laid out on the ground
+	if (scene) {
+		model_matrix = glm::scale(glm::mat4(1.0f), glm::vec3(2.0f / scene->getRadius()));
+		model_matrix = glm::translate(model_matrix, -scene->getCenter());
+		view_matrix = glm::lookAt(glm::vec3(0.0f, 2.5f, 4.330127f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	}
+	
+}
+
+void GameManager::createSimpleProgram() {
+	//The matrices of the parts come from a buffer, the shader reads them
+	//the way the buffer stores them
+	draw_data.reset(new DrawDataBuffer(m_render_options.draw_data_mode));
+	std::string defines = draw_data->getShaderDefines();
+
+	//Batching needs the draw id of each draw in a multi-draw call
+	draw_batch.reset(new DrawBatch());
+	if (DrawBatch::isSupported()) {
+		defines += DrawBatch::getShaderDefines();
+	}
+	else if (m_render_options.batched) {
+		std::cout << "GL_ARB_shader_draw_parameters is not supported, drawing every part separately" << std::endl;
+		m_render_options.batched = false;
+	}
+
+	//The models of a scene are drawn for all their instances at once
+	if (scene)
+		defines += "#define INSTANCED\n";
+
+	std::string fs_src = GLUtils::addShaderDefines(readFile("shaders/test.frag"), defines);
+	std::string vs_src = GLUtils::addShaderDefines(readFile("shaders/test.vert"), defines);
+
+	//Compile shaders, attach to program object, and link
+	program.reset(new Program(vs_src, fs_src));
+
+	//Resolve the uniforms once, so rendering never looks them up by name
+	uniforms.projection_matrix = program->getUniformHandle<glm::mat4>("projection_matrix");
+	uniforms.draw_id = program->getUniformHandle<GLint>("draw_id");
+	uniforms.view_matrix = program->getUniformHandle<glm::mat4>("view_matrix");
+
+	//Set uniforms for the program.
+	program->use();
+	uniforms.projection_matrix.set(projection_matrix);
+	draw_data->attachProgram(*program);
+	program->disuse();
+}
+
+void GameManager::createVAO() {
+	glGenVertexArrays(1, &vao);
+	glBindVertexArray(vao);
+	CHECK_GL_ERROR();
+
+	glBindVertexArray(0);
+
+	startModelLoading();
+}
+
+void GameManager::startModelLoading() {
+	// Import (or map the cache of) the model on a background thread, so the
+	// window stays responsive while it loads. See updateModelLoading().
+	LoadOptions load_options = m_load_options;
+	if (scene) {
+		//Every model once, however many instances it has
+		const std::vector<Scene::Asset>& assets = scene->getAssets();
+		std::cout << "Loading " << assets.size() << " models for " << scene->getNumInstances()
+			<< " instances of " << m_model << std::endl;
+		scene_assets.resize(assets.size());
+
+		//One loader thread for all of them: Model::prepare already uses a
+		//thread per core, so preparing the models at the same time would
+		//only start more threads than there are cores. Each asset gets its
+		//model as soon as it is prepared.
+		typedef std::promise<std::shared_ptr<PreparedModel> > ModelPromise;
+		std::shared_ptr<std::vector<ModelPromise> > promises(new std::vector<ModelPromise>(assets.size()));
+		std::vector<std::string> filenames;
+		for (unsigned int i = 0; i < assets.size(); ++i) {
+			scene_assets[i].loader = (*promises)[i].get_future();
+			filenames.push_back(assets[i].filename);
+		}
+		scene_loader = std::async(std::launch::async, [promises, filenames, load_options]() {
+			for (unsigned int i = 0; i < filenames.size(); ++i) {
+				try {
+					(*promises)[i].set_value(Model::prepare(filenames[i], false, load_options));
+				}
+				catch (...) {
+					//The scene is not shown without this model, so stop here,
+					//and hand the error to the models not loaded as well, so
+					//nothing waits on them forever
+					for (unsigned int j = i; j < filenames.size(); ++j)
+						(*promises)[j].set_exception(std::current_exception());
+					return;
+				}
+			}
+		});
+		return;
+	}
+
+	std::string filename = m_model;
+	model_loader = std::async(std::launch::async, [filename, load_options]() {
+		return Model::prepare(filename, false, load_options);
+	});
+}
+
+bool GameManager::updateModelLoading() {
+	TIMED_SCOPE("GameManager::updateModelLoading");
+	if (model_uploaded)
+		return false;
+	if (scene)
+		return updateSceneLoading();
+
+	if (!model) {
+		if (!model_loader.valid()
+				|| model_loader.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+			return false;
+
+		// Rethrows any exception from the loader thread
+		if (software_renderer) {
+			software_model = model_loader.get();
+			model_uploaded = true;
+			return true;
+		}
+		model.reset(new Model(model_loader.get()));
+		attachModel(vao, *model);
+	}
+
+	model_uploaded = model->upload(upload_bytes_per_frame);
+	return true;
+}
+
+bool GameManager::updateSceneLoading() {
+	const std::vector<Scene::Asset>& assets = scene->getAssets();
+	bool updated = false;
+	bool uploaded_chunk = false; //< Only one chunk of one model per frame, like a single model
+	model_uploaded = true;
+
+	for (unsigned int i = 0; i < scene_assets.size(); ++i) {
+		SceneAsset& asset = scene_assets[i];
+		if (!asset.uploaded && !asset.model && asset.loader.valid()
+				&& asset.loader.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+			// Rethrows any exception from the loader thread
+			if (software_renderer) {
+				asset.software_model = asset.loader.get();
+				asset.draw_batch.reset(new DrawBatch(false));
+				asset.uploaded = true;
+				updated = true;
+			}
+			else if (!uploaded_chunk) {
+				asset.model.reset(new Model(asset.loader.get()));
+				asset.draw_batch.reset(new DrawBatch());
+				glGenVertexArrays(1, &asset.vao);
+				attachModel(asset.vao, *asset.model);
+				attachInstances(asset, assets[i].instances);
+			}
+		}
+		if (!asset.uploaded && asset.model && !uploaded_chunk) {
+			asset.uploaded = asset.model->upload(upload_bytes_per_frame);
+			uploaded_chunk = true;
+			updated = true;
+		}
+		model_uploaded = model_uploaded && asset.uploaded;
+	}
+	return updated;
+}
+
+void GameManager::attachModel(GLuint vao, Model& model) {
+	glBindVertexArray(vao);
+	CHECK_GL_ERROR();
+
+	GLint k = model.getVertexSize();
+
+	model.getVertices()->bind();
+	if (model.isQuantized()) {
+		//The integer positions go through as they are, the modelview
+		//matrices include the transform back to the model
+		program->setAttributePointer("position", 3, GL_SHORT, GL_FALSE, k, 0);
+		CHECK_GL_ERROR();
+
+		program->setAttributePointer("normal", 4, GL_INT_2_10_10_10_REV, GL_TRUE, k, reinterpret_cast<void *>(4 * sizeof(GLshort)));
+		CHECK_GL_ERROR();
+	}
+	else {
+		program->setAttributePointer("position", 3, GL_FLOAT, GL_FALSE, k, 0);
+		CHECK_GL_ERROR();
+
+		program->setAttributePointer("normal", 3, GL_FLOAT, GL_FALSE, k, reinterpret_cast<void *>(3 * sizeof(float)));
+		CHECK_GL_ERROR();
+	}
+
+	//The element buffer binding is stored in the VAO
+	model.getIndices()->bind();
+	CHECK_GL_ERROR();
+	
+	//Unbind VBOs and VAO
+	VBO::unbind(); //Unbinds both vertices and normals
+	glBindVertexArray(0);
+	CHECK_GL_ERROR();
+}
+
+void GameManager::attachInstances(SceneAsset& asset, const std::vector<glm::mat4>& instances) {
+	asset.instance_matrices.reset(new VBO(&instances[0], static_cast<unsigned int>(instances.size() * sizeof(glm::mat4))));
+
+	glBindVertexArray(asset.vao);
+	asset.instance_matrices->bind();
+
+	//A mat4 attribute takes four locations, one per column, and advances
+	//once per instance instead of once per vertex
+	GLint location = program->getAttribute("instance_matrix");
+	for (GLint column = 0; column < 4; ++column) {
+		glVertexAttribPointer(location + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), reinterpret_cast<void *>(column * sizeof(glm::vec4)));
+		glEnableVertexAttribArray(location + column);
+		glVertexAttribDivisor(location + column, 1);
+	}
+	CHECK_GL_ERROR();
+
+	VBO::unbind();
+	glBindVertexArray(0);
+	CHECK_GL_ERROR();
+}
+
+void GameManager::createProfiler(bool gpu_timing) {
+	profiler.reset(new FrameProfiler(gpu_timing));
+	profiler->setPrintInterval(m_render_options.profile_interval);
+	if (!m_render_options.profile_csv.empty())
+		profiler->openCsv(m_render_options.profile_csv);
+}
+
+void GameManager::init() {
+	// Initialize SDL
+	if (SDL_Init(SDL_INIT_EVERYTHING) < 0) {
+		std::stringstream err;
+		err << "Could not initialize SDL: " << SDL_GetError();
+		THROW_EXCEPTION(err.str());
+	}
+	atexit( SDL_Quit);
+
+	createOpenGLContext();
+	setupFramePacing();
+	setOpenGLStates();
+	createMatrices();
+	createSimpleProgram();
+	createVAO();
+	createProfiler(true);
+}
+
+void GameManager::initHeadless() {
+	headless_context.reset(new HeadlessContext());
+	trackball.setWindowSize(window_width, window_height);
+
+	glewExperimental = GL_TRUE;
+	GLenum glewErr = glewInit();
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+	// GLEW built for GLX complains about the missing X display after
+	// it has loaded the core functions, which is all we need
+	if (glewErr == GLEW_ERROR_NO_GLX_DISPLAY)
+		glewErr = GLEW_OK;
+#endif
+	if (glewErr != GLEW_OK) {
+		std::stringstream err;
+		err << "Error initializing GLEW: " << glewGetErrorString(glewErr);
+		THROW_EXCEPTION(err.str());
+	}
+	glGetError();
+
+	// There is no default framebuffer, so render into an FBO
+	framebuffer.reset(new GLUtils::FBO(window_width, window_height));
+	framebuffer->bind();
+	glViewport(0, 0, window_width, window_height);
+	CHECK_GL_ERROR();
+
+	setOpenGLStates();
+	createMatrices();
+	createSimpleProgram();
+	createVAO();
+	createProfiler(true);
+}
+
+void GameManager::initSoftware() {
+	software_renderer.reset(new SoftwareRenderer(window_width, window_height, m_render_options.render_threads));
+	trackball.setWindowSize(window_width, window_height);
+	std::cout << "Rendering on the CPU with " << software_renderer->getNumThreads() << " threads" << std::endl;
+
+	// The draw list is built the same way, but never touches OpenGL
+	draw_batch.reset(new DrawBatch(false));
+	m_render_options.batched = false;
+
+	createMatrices();
+	startModelLoading();
+	createProfiler(false);
+}
+
+void GameManager::renderMeshParts(const glm::mat4& view_matrix) {
+	TIMED_SCOPE("GameManager::renderMeshParts");
+	// In software mode, the whole model is available at once
+	MeshHierarchy& hierarchy = software_model ? software_model->hierarchy : model->getHierarchy();
+	unsigned int available_indices = software_model ? software_model->n_indices : model->getNumUploadedIndices();
+	size_t index_size = software_model ? ((software_model->index_type == GL_UNSIGNED_SHORT) ? 2 : 4) : model->getIndices()->indexSize();
+	hierarchy.updateWorldTransforms();
+
+	glm::mat4 view_model_matrix = view_matrix*model_matrix;
+
+	//The normal matrix is the transpose of the inverse of the 3x3 leading
+	//submatrix of the modelview matrix. It factors into the one of the view
+	//and model matrix times the precomputed one of each part.
+	glm::mat4 view_model_normal_matrix = glm::mat4(glm::transpose(glm::inverse(glm::mat3(view_model_matrix))));
+
+	//Only the nodes with uploaded geometry are drawn, and with culling
+	//only the ones whose bounds intersect the view frustum
+	const unsigned char* visible = NULL;
+	if (m_render_options.culling) {
+		TIMED_SCOPE("GameManager::renderMeshParts culling");
+		bvh.update(hierarchy);
+		bvh.cull(Frustum(projection_matrix * view_model_matrix), visible_parts);
+		visible = visible_parts.data();
+	}
+
+	//Parts far enough away are drawn at a coarser level of detail
+	const unsigned char* levels = NULL;
+	if (m_render_options.lod && hierarchy.getNumLevels() > 1) {
+		TIMED_SCOPE("GameManager::renderMeshParts levels of detail");
+		LevelOfDetail::selectLevels(hierarchy, view_model_matrix, projection_matrix, static_cast<float>(window_height),
+			m_render_options.lod_tolerance, visible, part_levels);
+		levels = part_levels.data();
+	}
+	draw_batch->update(hierarchy, available_indices, index_size, visible, levels);
+	culled_parts = draw_batch->getNumCulled();
+	const std::vector<unsigned int>& nodes = draw_batch->getNodes();
+
+	//Compute the matrices of all drawn parts in one batch, and upload them
+	//all at once. The buffer only grows when the hierarchy does, so this
+	//does not allocate per frame.
+	draw_transforms.resize(nodes.size());
+	TransformKernel::transformParts(view_model_matrix, view_model_normal_matrix,
+		hierarchy.getVertexWorldTransforms(), hierarchy.getNormalTransforms(), nodes.data(), nodes.size(), draw_transforms.data());
+	if (software_renderer) {
+		//Counted as one draw per part, like drawing them separately
+		software_renderer->draw(*software_model, *draw_batch, draw_transforms.data(), projection_matrix);
+		draw_calls += draw_batch->size();
+		return;
+	}
+	draw_data->upload(draw_transforms);
+	draw_data->bind();
+
+	//All parts in one multi-draw call (per chunk of the draw data), or one call each
+	if (m_render_options.batched && DrawBatch::isSupported())
+		draw_calls += draw_batch->draw(model->getIndices()->type(), *draw_data, uniforms.draw_id);
+	else
+		draw_calls += draw_batch->drawSeparately(model->getIndices()->type(), *draw_data, uniforms.draw_id);
+}
+
+void GameManager::renderScene(const glm::mat4& view_matrix) {
+	TIMED_SCOPE("GameManager::renderScene");
+	const std::vector<Scene::Asset>& assets = scene->getAssets();
+	glm::mat4 view_model_matrix = view_matrix*model_matrix;
+	if (!software_renderer)
+		uniforms.view_matrix.set(view_model_matrix);
+
+	for (unsigned int i = 0; i < scene_assets.size(); ++i) {
+		SceneAsset& asset = scene_assets[i];
+		const std::vector<glm::mat4>& instances = assets[i].instances;
+		if (!asset.model && !asset.software_model)
+			continue;
+
+		// In software mode, the whole model is available at once
+		MeshHierarchy& hierarchy = asset.software_model ? asset.software_model->hierarchy : asset.model->getHierarchy();
+		unsigned int available_indices = asset.software_model ? asset.software_model->n_indices : asset.model->getNumUploadedIndices();
+		size_t index_size = asset.software_model ? ((asset.software_model->index_type == GL_UNSIGNED_SHORT) ? 2 : 4) : asset.model->getIndices()->indexSize();
+		hierarchy.updateWorldTransforms();
+		asset.draw_batch->update(hierarchy, available_indices, index_size);
+		const std::vector<unsigned int>& nodes = asset.draw_batch->getNodes();
+		draw_transforms.resize(nodes.size());
+
+		//The software renderer has no instancing, it draws the parts of
+		//every instance with matrices of their own
+		if (software_renderer) {
+			for (unsigned int j = 0; j < instances.size(); ++j) {
+				glm::mat4 instance_view_matrix = view_model_matrix*instances[j];
+				glm::mat4 instance_normal_matrix = glm::mat4(glm::transpose(glm::inverse(glm::mat3(instance_view_matrix))));
+				TransformKernel::transformParts(instance_view_matrix, instance_normal_matrix,
+					hierarchy.getVertexWorldTransforms(), hierarchy.getNormalTransforms(), nodes.data(), nodes.size(), draw_transforms.data());
+				software_renderer->draw(*asset.software_model, *asset.draw_batch, draw_transforms.data(), projection_matrix);
+				draw_calls += asset.draw_batch->size();
+			}
+			continue;
+		}
+
+		//The matrices of the parts leave out the view, the shader puts the
+		//view and the matrix of each instance in front of them
+		TransformKernel::transformParts(glm::mat4(1.0f), glm::mat4(1.0f),
+			hierarchy.getVertexWorldTransforms(), hierarchy.getNormalTransforms(), nodes.data(), nodes.size(), draw_transforms.data());
+		draw_data->upload(draw_transforms);
+		draw_data->bind();
+
+		glBindVertexArray(asset.vao);
+		GLenum index_type = asset.model->getIndices()->type();
+		unsigned int n_instances = static_cast<unsigned int>(instances.size());
+		if (m_render_options.batched && DrawBatch::isSupported())
+			draw_calls += asset.draw_batch->draw(index_type, *draw_data, uniforms.draw_id, n_instances);
+		else
+			draw_calls += asset.draw_batch->drawSeparately(index_type, *draw_data, uniforms.draw_id, n_instances);
+	}
+	if (!software_renderer)
+		glBindVertexArray(0);
+}
+
+size_t GameManager::getNumTriangles() const {
+	if (!scene)
+		return draw_batch->getNumTriangles();
+
+	size_t triangles = 0;
+	for (unsigned int i = 0; i < scene_assets.size(); ++i) {
+		if (scene_assets[i].draw_batch)
+			triangles += scene_assets[i].draw_batch->getNumTriangles() * scene->getAssets()[i].instances.size();
+	}
+	return triangles;
+}
+
+size_t GameManager::getNumDrawnParts() const {
+	if (!scene)
+		return draw_batch->size();
+
+	size_t parts = 0;
+	for (unsigned int i = 0; i < scene_assets.size(); ++i) {
+		if (scene_assets[i].draw_batch)
+			parts += scene_assets[i].draw_batch->size() * scene->getAssets()[i].instances.size();
+	}
+	return parts;
+}
+
+void GameManager::addLevelDraws(std::vector<size_t>& level_draws) const {
+	for (unsigned int i = 0; i < (scene ? scene_assets.size() : 1); ++i) {
+		const DrawBatch* batch = scene ? scene_assets[i].draw_batch.get() : draw_batch.get();
+		if (!batch)
+			continue;
+		size_t n_instances = scene ? scene->getAssets()[i].instances.size() : 1;
+		const std::vector<unsigned int>& batch_level_draws = batch->getLevelDraws();
+		level_draws.resize(std::max(level_draws.size(), batch_level_draws.size()), 0);
+		for (unsigned int level = 0; level < batch_level_draws.size(); ++level)
+			level_draws[level] += batch_level_draws[level] * n_instances;
+	}
+}
+
+void GameManager::render() {
+	TIMED_SCOPE("GameManager::render");
+	draw_calls = 0;
+	culled_parts = 0;
+
+	//Clear screen, and set the correct program (or clear the buffers of
+	//the software renderer to what setOpenGLStates() clears to)
+	if (software_renderer) {
+		software_renderer->clear(glm::vec3(0.0f, 0.0f, 0.5f));
+	}
+	else {
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		program->use();
+	}
+	
+	glm::mat4 view_matrix_new = view_matrix*trackball_view_matrix;
+
+	// If the user is zooming, change fov
+	if(m_zoom != 0)
+	{
+		m_fov += m_zoom;
+		m_zoom = 0;
+
+#ifdef MORE_DEBUG_INFO
+		std::cout << "new fov: " << m_fov << std::endl;
+		std::cout << "Projection_matrix: \n" << GLUtils::mat4toString(projection_matrix) << std::endl;
+#endif
+
+		projection_matrix = glm::perspective(m_fov, window_width / static_cast<float>(window_height), 1.0f, 10.0f);
+
+		
+		if (program)
+			uniforms.projection_matrix.set(projection_matrix);
+		
+	}
+
+	if (software_renderer) {
+		if (scene)
+			renderScene(view_matrix_new);
+		else if (software_model)
+			renderMeshParts(view_matrix_new);
+		return;
+	}
+
+	//Render geometry (the model is still loading until it exists)
+	if (scene) {
+		renderScene(view_matrix_new);
+	}
+	else if (model) {
+		glBindVertexArray(vao);
+
+		renderMeshParts(view_matrix_new);
+
+		glBindVertexArray(0);
+	}
+	CHECK_GL_ERROR();
+}
+
+bool GameManager::handleEvent(const SDL_Event& event) {
+	switch (event.type) {
+	case SDL_MOUSEBUTTONDOWN:
+		trackball.rotateBegin(event.motion.x, event.motion.y);
+		break;
+	case SDL_MOUSEBUTTONUP:
+		applyMouseMotion();
+		trackball.rotateEnd(event.motion.x, event.motion.y);
+		break;
+	case SDL_MOUSEMOTION:
+		//The mouse only turns the model while a button is held, and
+		//only where it is when the frame is drawn
+		if (trackball.isRotating()) {
+			mouse_x = event.motion.x;
+			mouse_y = event.motion.y;
+			mouse_moved = true;
+			redraw = true;
+		}
+		break;
+	case SDL_KEYDOWN:
+		if (event.key.keysym.sym == SDLK_ESCAPE) //Esc
+		{
+			return false;
+		}
+		else
+		if (event.key.keysym.sym == SDLK_q
+				&& event.key.keysym.mod & KMOD_CTRL) //Ctrl+q
+		{
+			return false;
+		}
+		else
+		if (event.key.keysym.sym == SDLK_PAGEUP)
+		{
+			input.fov += m_zoom_sensitivity;
+			redraw = true;
+		}
+		else
+		if (event.key.keysym.sym == SDLK_PAGEDOWN) {
+			input.fov -= m_zoom_sensitivity;
+			redraw = true;
+		}
+		else
+		if (event.key.keysym.sym == SDLK_b && DrawBatch::isSupported()) //Toggle batching
+		{
+			input.batched = !input.batched;
+			redraw = true;
+		}
+		if (event.key.keysym.sym == SDLK_c) //Toggle frustum culling
+		{
+			input.culling = !input.culling;
+			redraw = true;
+		}
+		if (event.key.keysym.sym == SDLK_l) //Toggle levels of detail
+		{
+			input.lod = !input.lod;
+			redraw = true;
+		}
+		break;
+	case SDL_WINDOWEVENT: //e.g., the window was uncovered, and has to be drawn again
+		if (event.window.event == SDL_WINDOWEVENT_EXPOSED || event.window.event == SDL_WINDOWEVENT_SIZE_CHANGED)
+			redraw = true;
+		break;
+	case SDL_QUIT: //e.g., user clicks the upper right x
+		return false;
+	}
+	return true;
+}
+
+void GameManager::applyMouseMotion() {
+	if (!mouse_moved)
+		return;
+	input.trackball_view_matrix = trackball.rotate(mouse_x, mouse_y);
+	mouse_moved = false;
+}
+
+void GameManager::applyViewState(const ViewState& state) {
+	trackball_view_matrix = state.trackball_view_matrix;
+	m_zoom = state.fov - m_fov;
+
+	//The statistics are of the last frame, drawn before the toggle. Scenes
+	//are drawn without culling and levels of detail, so those toggles
+	//change nothing there.
+	if (state.batched != m_render_options.batched) {
+		m_render_options.batched = state.batched;
+		std::cout << "Batched drawing " << (m_render_options.batched ? "on" : "off")
+			<< " (last frame: " << draw_calls << " draw calls)" << std::endl;
+	}
+	if (state.culling != m_render_options.culling) {
+		m_render_options.culling = state.culling;
+		std::cout << "Frustum culling " << (m_render_options.culling ? "on" : "off");
+		if (scene)
+			std::cout << " (does nothing for scenes, every instance is drawn)" << std::endl;
+		else
+			std::cout << " (last frame: " << getNumDrawnParts() << " parts visible, " << culled_parts << " culled)" << std::endl;
+	}
+	if (state.lod != m_render_options.lod) {
+		m_render_options.lod = state.lod;
+		std::cout << "Levels of detail " << (m_render_options.lod ? "on" : "off");
+		if (scene)
+			std::cout << " (does nothing for scenes, every instance is drawn at the full level)" << std::endl;
+		else
+			std::cout << " (last frame: " << getNumTriangles() << " triangles)" << std::endl;
+	}
+}
+
+bool GameManager::hasModelUpdate() {
+	//The model is uploaded a chunk per frame, and every frame shows more of it
+	if (model_uploaded)
+		return false;
+	for (unsigned int i = 0; i < scene_assets.size(); ++i) {
+		const SceneAsset& asset = scene_assets[i];
+		if (!asset.uploaded && (asset.model || (asset.loader.valid()
+				&& asset.loader.wait_for(std::chrono::seconds(0)) == std::future_status::ready)))
+			return true;
+	}
+	return model || (model_loader.valid()
+		&& model_loader.wait_for(std::chrono::seconds(0)) == std::future_status::ready);
+}
+
+bool GameManager::waitForRedraw() {
+	while (!redraw) {
+		if (hasModelUpdate())
+			return true;
+
+		//While the loader thread runs, wake up every few milliseconds to check on it
+		SDL_Event event;
+		profiler->beginIdle();
+		int has_event = model_uploaded ? SDL_WaitEvent(&event) : SDL_WaitEventTimeout(&event, loading_poll_ms);
+		profiler->endIdle();
+		if (has_event && !handleEvent(event))
+			return false;
+	}
+	return true;
+}
+
+void GameManager::paceFrame(uint64_t& next_frame) {
+	if (frame_period <= 0.0)
+		return;
+
+	//A late frame starts the schedule over, instead of the next
+	//frames catching up back to back (as after idling on demand)
+	uint64_t now = Timer::getNanoseconds();
+	next_frame += static_cast<uint64_t>(frame_period * 1e9);
+	if (next_frame > now)
+		std::this_thread::sleep_for(std::chrono::nanoseconds(next_frame - now));
+	else
+		next_frame = now;
+}
+
+void GameManager::drawFrame() {
+	//Continue loading the model, render, and swap front and back buffers
+	profiler->beginPhase(FrameProfiler::UPDATE);
+	updateModelLoading();
+	profiler->beginPhase(FrameProfiler::DRAW);
+	render();
+	profiler->beginPhase(FrameProfiler::SWAP);
+	SDL_GL_SwapWindow(main_window);
+	profiler->endFrame(draw_calls, getNumTriangles());
+}
+
+void GameManager::play() {
+	input.trackball_view_matrix = trackball_view_matrix;
+	input.fov = m_fov;
+	input.batched = m_render_options.batched;
+	input.culling = m_render_options.culling;
+	input.lod = m_render_options.lod;
+	if (m_render_options.render_thread) {
+		playThreaded();
+		return;
+	}
+
+	bool running = true;
+	Timer title_timer;
+	uint64_t next_frame = Timer::getNanoseconds();
+
+	//SDL main loop
+	while (running) {
+		//Sleep until the view changes, instead of drawing the same frame again
+		if (!m_render_options.continuous && !waitForRedraw())
+			break;
+		paceFrame(next_frame);
+
+		profiler->beginFrame();
+		SDL_Event event;
+		while (SDL_PollEvent(&event)) {// poll for pending events
+			if (!handleEvent(event))
+				running = false;
+		}
+		applyMouseMotion();
+		applyViewState(input);
+		redraw = false;
+		drawFrame();
+
+		//Frame time statistics in the title bar
+		if (title_timer.elapsed() >= 1.0) {
+			title_timer.restart();
+			SDL_SetWindowTitle(main_window, ("Westerdals - PG6200 Assignment 2 (" + profiler->getSummary() + ")").c_str());
+		}
+	}
+	profiler->finish();
+	quit();
+}
+
+void GameManager::playThreaded() {
+	title_event = SDL_RegisterEvents(1);
+	snapshot_event = SDL_RegisterEvents(1);
+	stop_rendering = false;
+	publishViewState();
+
+	//The render thread takes over the OpenGL context. If it fails, it
+	//gives the context back and quits the event loop, and get() below
+	//rethrows its exception.
+	SDL_GL_MakeCurrent(main_window, NULL);
+	std::future<void> render_thread = std::async(std::launch::async, [this]() {
+		try {
+			renderLoop();
+		}
+		catch (...) {
+			SDL_GL_MakeCurrent(main_window, NULL);
+			SDL_Event event;
+			event.type = SDL_QUIT;
+			SDL_PushEvent(&event);
+			throw;
+		}
+	});
+
+	//SDL main loop, on the event thread
+	bool running = true;
+	while (running) {
+		SDL_Event event;
+		if (!SDL_WaitEvent(&event)) {
+			cerr << "SDL_WaitEvent failed: " << SDL_GetError() << endl;
+			break;
+		}
+		//Everything that came in together goes into one snapshot
+		do {
+			if (event.type == title_event) {
+				if (titles.update())
+					SDL_SetWindowTitle(main_window, titles.getReadBuffer().c_str());
+			}
+			else if (event.type == snapshot_event) {
+				//Only wakes this loop up to publish the input that waited
+			}
+			else if (!handleEvent(event)) {
+				running = false;
+			}
+		} while (SDL_PollEvent(&event));
+
+		//Until the render thread takes the last snapshot, the input only
+		//piles up, and the trackball is turned once for all of it. The
+		//flag is set before checking, so the render thread cannot take
+		//the snapshot in between without waking this loop up.
+		if (redraw && snapshot_event != static_cast<Uint32>(-1)) {
+			snapshot_waiting = true;
+			if (view_snapshots.hasNew())
+				continue;
+			snapshot_waiting = false;
+		}
+		if (redraw) {
+			applyMouseMotion();
+			publishViewState();
+		}
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(render_mutex);
+		stop_rendering = true;
+	}
+	render_wakeup.notify_one();
+	render_thread.wait();
+	SDL_GL_MakeCurrent(main_window, main_context);
+	render_thread.get();
+	quit();
+}
+
+void GameManager::publishViewState() {
+	view_snapshots.getWriteBuffer() = input;
+	view_snapshots.publish();
+	redraw = false;
+
+	//Taking the lock orders the wakeup after the render thread checked for
+	//a snapshot, so it cannot be missed
+	{
+		std::lock_guard<std::mutex> lock(render_mutex);
+	}
+	render_wakeup.notify_one();
+}
+
+bool GameManager::waitForSnapshot() {
+	std::unique_lock<std::mutex> lock(render_mutex);
+	while (!stop_rendering && !view_snapshots.hasNew()) {
+		if (hasModelUpdate())
+			return true;
+
+		//While the loader thread runs, wake up every few milliseconds to check on it
+		profiler->beginIdle();
+		if (model_uploaded)
+			render_wakeup.wait(lock);
+		else
+			render_wakeup.wait_for(lock, std::chrono::milliseconds(loading_poll_ms));
+		profiler->endIdle();
+	}
+	return !stop_rendering;
+}
+
+void GameManager::renderLoop() {
+	SDL_GL_MakeCurrent(main_window, main_context);
+	Timer title_timer;
+	uint64_t next_frame = Timer::getNanoseconds();
+
+	while (!stop_rendering) {
+		//Sleep until the view changes, instead of drawing the same frame again
+		if (!m_render_options.continuous && !waitForSnapshot())
+			break;
+		paceFrame(next_frame);
+
+		//The events phase takes the latest input from the event thread
+		profiler->beginFrame();
+		if (view_snapshots.update()) {
+			applyViewState(view_snapshots.getReadBuffer());
+			if (snapshot_waiting.exchange(false)) {
+				SDL_Event event;
+				event.type = snapshot_event;
+				SDL_PushEvent(&event);
+			}
+		}
+		drawFrame();
+
+		//Frame time statistics in the title bar, which the event thread sets
+		if (title_timer.elapsed() >= 1.0 && title_event != static_cast<Uint32>(-1)) {
+			title_timer.restart();
+			titles.getWriteBuffer() = "Westerdals - PG6200 Assignment 2 (" + profiler->getSummary() + ")";
+			titles.publish();
+			SDL_Event event;
+			event.type = title_event;
+			SDL_PushEvent(&event);
+		}
+	}
+	profiler->finish();
+	SDL_GL_MakeCurrent(main_window, NULL);
+}
+
+void GameManager::playHeadless(unsigned int n_frames, const std::string& frame_prefix) {
+	// Frame times should not include loading the model
+	while (!model_uploaded) {
+		if (!model && model_loader.valid())
+			model_loader.wait();
+		for (unsigned int i = 0; i < scene_assets.size(); ++i) {
+			if (scene_assets[i].loader.valid())
+				scene_assets[i].loader.wait();
+		}
+		updateModelLoading();
+	}
+	if (!software_renderer)
+		glFinish();
+
+	// Scripted orbit: drag the trackball horizontally a few pixels per frame
+	const int center_x = window_width / 2;
+	const int center_y = window_height / 2;
+	const int drag = window_width / 100;
+
+	std::vector<double> frame_times;
+	frame_times.reserve(n_frames);
+	size_t total_draw_calls = 0;
+	size_t total_visible_parts = 0, total_culled_parts = 0;
+	size_t total_triangles = 0;
+	std::vector<size_t> total_level_draws;
+	std::vector<unsigned char> pixels;
+	Timer total_timer;
+
+	for (unsigned int i=0; i<n_frames; ++i) {
+		profiler->beginFrame();
+		profiler->beginPhase(FrameProfiler::UPDATE);
+		trackball.rotateBegin(center_x, center_y);
+		trackball_view_matrix = trackball.rotate(center_x + drag, center_y);
+		trackball.rotateEnd(center_x + drag, center_y);
+
+		// glFinish makes the frame time include the rendering itself,
+		// not just queueing the commands
+		Timer frame_timer;
+		profiler->beginPhase(FrameProfiler::DRAW);
+		render();
+		profiler->beginPhase(FrameProfiler::SWAP);
+		if (!software_renderer)
+			glFinish();
+		frame_times.push_back(frame_timer.elapsed());
+		profiler->endFrame(draw_calls, getNumTriangles());
+		total_draw_calls += draw_calls;
+		total_visible_parts += getNumDrawnParts();
+		total_culled_parts += culled_parts;
+		total_triangles += getNumTriangles();
+		addLevelDraws(total_level_draws);
+
+		if (!frame_prefix.empty()) {
+			if (software_renderer)
+				software_renderer->readPixels(pixels);
+			else
+				framebuffer->readPixels(pixels);
+			std::stringstream filename;
+			filename << frame_prefix << std::setw(4) << std::setfill('0') << i << ".ppm";
+			saveFrame(filename.str(), pixels);
+		}
+	}
+	double total_time = total_timer.elapsed();
+
+	if (!frame_times.empty()) {
+		double sum = 0.0;
+		for (unsigned int i=0; i<frame_times.size(); ++i)
+			sum += frame_times[i];
+		double mean = sum / frame_times.size();
+		double min = *std::min_element(frame_times.begin(), frame_times.end());
+		double max = *std::max_element(frame_times.begin(), frame_times.end());
+
+		std::cout << "Rendered " << n_frames << " frames (" << window_width << "x" << window_height << ") in "
+			<< total_time << " s" << std::endl;
+		std::cout << "  frame time: mean " << mean * 1000.0 << " ms, min " << min * 1000.0
+			<< " ms, max " << max * 1000.0 << " ms (" << 1.0 / mean << " fps)" << std::endl;
+		std::cout << "  draw calls per frame: " << total_draw_calls / frame_times.size()
+			<< (m_render_options.batched ? " (batched)" : "") << std::endl;
+		std::cout << "  parts per frame: " << total_visible_parts / static_cast<double>(frame_times.size()) << " visible, "
+			<< total_culled_parts / static_cast<double>(frame_times.size()) << " culled"
+			<< (m_render_options.culling ? "" : " (culling off)") << std::endl;
+		std::cout << "  triangles per frame: " << total_triangles / frame_times.size();
+		if (total_level_draws.size() > 1) {
+			std::cout << ", parts per level:";
+			for (unsigned int level=0; level<total_level_draws.size(); ++level)
+				std::cout << " " << total_level_draws[level] / static_cast<double>(frame_times.size());
+		}
+		std::cout << (m_render_options.lod ? "" : " (levels of detail off)") << std::endl;
+	}
+	profiler->finish();
+	quit();
+}
+
+void GameManager::saveFrame(const std::string& filename, const std::vector<unsigned char>& pixels) {
+	std::ofstream file(filename.c_str(), std::ios::binary);
+	if (!file.good())
+		THROW_EXCEPTION("Could not write " + filename);
+
+	file << "P6\n" << window_width << " " << window_height << "\n255\n";
+	file.write(reinterpret_cast<const char*>(&pixels[0]), pixels.size());
+}
+
+void GameManager::quit() {
+	PRINT_TIMED_SCOPES();
+	std::cout << "Bye bye..." << std::endl;
+}
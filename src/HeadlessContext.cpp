@@ -0,0 +1,103 @@
+#include "HeadlessContext.h"
+
+#include "GameException.h"
+
+#ifndef _WIN32
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#include <iostream>
+#include <sstream>
+
+#ifdef _WIN32
+
+HeadlessContext::HeadlessContext() : display(NULL), context(NULL) {
+	THROW_EXCEPTION("Headless rendering (EGL) is not supported on this platform");
+}
+
+HeadlessContext::~HeadlessContext() {
+
+}
+
+#else
+
+namespace {
+	void throwEGLError(const char* what) {
+		std::stringstream err;
+		err << what << " failed: EGL error 0x" << std::hex << eglGetError();
+		THROW_EXCEPTION(err.str());
+	}
+}
+
+HeadlessContext::HeadlessContext() : display(EGL_NO_DISPLAY), context(EGL_NO_CONTEXT) {
+	EGLDisplay egl_display = EGL_NO_DISPLAY;
+
+	// The surfaceless platform needs neither X11/Wayland nor a GPU
+#ifdef EGL_PLATFORM_SURFACELESS_MESA
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+		reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+	if (getPlatformDisplay)
+		egl_display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+#endif
+	if (egl_display == EGL_NO_DISPLAY)
+		egl_display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	if (egl_display == EGL_NO_DISPLAY)
+		throwEGLError("eglGetDisplay");
+
+	EGLint major, minor;
+	if (!eglInitialize(egl_display, &major, &minor))
+		throwEGLError("eglInitialize");
+	display = egl_display;
+
+	// The default surface type is a window, which surfaceless displays lack
+	const EGLint config_attributes[] = {
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_RED_SIZE, 8,
+		EGL_GREEN_SIZE, 8,
+		EGL_BLUE_SIZE, 8,
+		EGL_NONE
+	};
+	EGLConfig config;
+	EGLint n_configs = 0;
+	if (!eglChooseConfig(egl_display, config_attributes, &config, 1, &n_configs) || n_configs == 0) {
+		eglTerminate(egl_display);
+		throwEGLError("eglChooseConfig");
+	}
+
+	if (!eglBindAPI(EGL_OPENGL_API)) {
+		eglTerminate(egl_display);
+		throwEGLError("eglBindAPI");
+	}
+
+	const EGLint context_attributes[] = {
+		EGL_CONTEXT_MAJOR_VERSION_KHR, 3,
+		EGL_CONTEXT_MINOR_VERSION_KHR, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK_KHR, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT_KHR,
+		EGL_NONE
+	};
+	EGLContext egl_context = eglCreateContext(egl_display, config, EGL_NO_CONTEXT, context_attributes);
+	if (egl_context == EGL_NO_CONTEXT) {
+		eglTerminate(egl_display);
+		throwEGLError("eglCreateContext");
+	}
+	context = egl_context;
+
+	// Requires EGL_KHR_surfaceless_context, all rendering goes to an FBO
+	if (!eglMakeCurrent(egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE, egl_context)) {
+		eglDestroyContext(egl_display, egl_context);
+		eglTerminate(egl_display);
+		throwEGLError("eglMakeCurrent");
+	}
+
+	std::cout << "Headless EGL " << major << "." << minor << " context" << std::endl;
+}
+
+HeadlessContext::~HeadlessContext() {
+	eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	eglDestroyContext(display, context);
+	eglTerminate(display);
+}
+
+#endif
@@ -0,0 +1,51 @@
+#include "ImportProfile.h"
+
+#include <assimp/postprocess.h>
+
+namespace {
+	const char* profile_names[ImportProfile::n_profiles] = {"minimal", "fast", "quality"};
+
+	// Triangles with normals, and nothing else. Point and line primitives
+	// are dropped by SortByPType (see importFile), so every mesh is triangles.
+	const unsigned int minimal_flags = aiProcess_Triangulate | aiProcess_SortByPType | aiProcess_GenSmoothNormals;
+
+	// Strip what we do not use before the other steps have to carry it along
+	const int removed_components = aiComponent_TANGENTS_AND_BITANGENTS | aiComponent_COLORS | aiComponent_TEXCOORDS
+		| aiComponent_BONEWEIGHTS | aiComponent_ANIMATIONS | aiComponent_TEXTURES | aiComponent_LIGHTS | aiComponent_CAMERAS;
+}
+
+unsigned int ImportProfile::getFlags(Profile profile) {
+	switch (profile) {
+	case MINIMAL:
+		return minimal_flags;
+	case FAST:
+		return minimal_flags | aiProcess_RemoveComponent | aiProcess_FindDegenerates | aiProcess_FindInvalidData;
+	default:
+		return aiProcessPreset_TargetRealtime_Quality;
+	}
+}
+
+const char* ImportProfile::getName(Profile profile) {
+	return profile_names[profile];
+}
+
+bool ImportProfile::fromName(const std::string& name, Profile& profile) {
+	for (unsigned int i = 0; i < n_profiles; ++i) {
+		if (name == profile_names[i]) {
+			profile = static_cast<Profile>(i);
+			return true;
+		}
+	}
+	return false;
+}
+
+const aiScene* ImportProfile::importFile(const std::string& filename, Profile profile) {
+	aiPropertyStore* properties = aiCreatePropertyStore();
+	aiSetImportPropertyInteger(properties, AI_CONFIG_PP_SBP_REMOVE, aiPrimitiveType_POINT | aiPrimitiveType_LINE);
+	aiSetImportPropertyInteger(properties, AI_CONFIG_PP_FD_REMOVE, 1);
+	aiSetImportPropertyInteger(properties, AI_CONFIG_PP_RVC_FLAGS, removed_components);
+
+	const aiScene* scene = aiImportFileExWithProperties(filename.c_str(), getFlags(profile), NULL, properties);
+	aiReleasePropertyStore(properties);
+	return scene;
+}
@@ -0,0 +1,80 @@
+#include "ImportStepTimer.h"
+
+#include <iomanip>
+#include <iostream>
+
+namespace {
+	const std::string step_begin = "Process begin";
+	const std::string pipeline_end = "Leaving post processing pipeline";
+}
+
+ImportStepTimer::ImportStepTimer() : step("reading file"), step_start(0.0) {
+	stream.callback = logCallback;
+	stream.user = reinterpret_cast<char*>(this);
+	aiEnableVerboseLogging(1);
+	aiAttachLogStream(&stream);
+}
+
+ImportStepTimer::~ImportStepTimer() {
+	aiDetachLogStream(&stream);
+	aiEnableVerboseLogging(0);
+}
+
+void ImportStepTimer::finish() {
+	endStep();
+}
+
+void ImportStepTimer::print() const {
+	double total = 0.0;
+	for (size_t i = 0; i < steps.size(); ++i)
+		total += steps[i].second;
+
+	std::ios::fmtflags flags = std::cout.flags();
+	std::streamsize precision = std::cout.precision();
+	std::cout << "assimp import steps:" << std::endl << std::fixed;
+	for (size_t i = 0; i < steps.size(); ++i) {
+		std::cout << "  " << std::left << std::setw(28) << steps[i].first << std::right
+			<< " " << std::setprecision(2) << std::setw(10) << steps[i].second * 1000.0 << " ms"
+			<< " " << std::setprecision(1) << std::setw(6) << ((total > 0.0) ? 100.0 * steps[i].second / total : 0.0) << "%" << std::endl;
+	}
+	std::cout << "  " << std::left << std::setw(28) << "total" << std::right
+		<< " " << std::setprecision(2) << std::setw(10) << total * 1000.0 << " ms" << std::endl;
+	std::cout.flags(flags);
+	std::cout.precision(precision);
+}
+
+void ImportStepTimer::logCallback(const char* message, char* user) {
+	reinterpret_cast<ImportStepTimer*>(user)->onMessage(message);
+}
+
+void ImportStepTimer::onMessage(const std::string& message) {
+	// Messages look like "Debug, T0: TriangulateProcess begin"
+	size_t begin = message.find(step_begin);
+	if (begin != std::string::npos) {
+		size_t name_start = message.rfind(' ', begin);
+		name_start = (name_start == std::string::npos) ? 0 : name_start + 1;
+		endStep();
+		step = message.substr(name_start, begin - name_start);
+		step_start = timer.elapsed();
+	}
+	else if (message.find(pipeline_end) != std::string::npos) {
+		endStep();
+	}
+}
+
+void ImportStepTimer::endStep() {
+	if (step.empty())
+		return;
+
+	// A step can run more than once (ValidateDataStructure does)
+	double time = timer.elapsed() - step_start;
+	for (size_t i = 0; i < steps.size(); ++i) {
+		if (steps[i].first == step) {
+			steps[i].second += time;
+			step.clear();
+			return;
+		}
+	}
+	steps.push_back(std::make_pair(step, time));
+	step.clear();
+}
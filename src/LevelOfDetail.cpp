@@ -0,0 +1,44 @@
+#include "LevelOfDetail.h"
+
+#include <algorithm>
+
+void LevelOfDetail::selectLevels(const MeshHierarchy& hierarchy, const glm::mat4& view_model, const glm::mat4& projection,
+		float viewport_height, float tolerance, const unsigned char* visible, std::vector<unsigned char>& levels) {
+	unsigned int n_nodes = hierarchy.size();
+	unsigned int n_levels = hierarchy.getNumLevels();
+	levels.assign(n_nodes, 0);
+	if (n_levels < 2)
+		return;
+
+	// A unit at depth d in view space covers projection[1][1] / d of half
+	// the viewport. The view and model matrices only scale uniformly.
+	float pixels_per_unit = projection[1][1] * viewport_height * 0.5f;
+	float view_model_scale = glm::length(glm::vec3(view_model[0]));
+
+	for (unsigned int i = 0; i < n_nodes; ++i) {
+		if ((visible != NULL && !visible[i]) || !hierarchy.hasBounds(i))
+			continue;
+
+		const glm::vec3& min = hierarchy.getWorldBoundsMin(i);
+		const glm::vec3& max = hierarchy.getWorldBoundsMax(i);
+		glm::vec4 center = view_model * glm::vec4((min + max) * 0.5f, 1.0f);
+		float radius = glm::length(max - min) * 0.5f * view_model_scale;
+		float depth = -center.z - radius;
+		if (depth <= 0.0f)
+			continue;
+
+		// The errors are in the space of the node, which the world transform
+		// may scale. Take the largest scale of its axes.
+		const glm::mat4& world = hierarchy.getWorldTransform(i);
+		float world_scale = std::max(glm::length(glm::vec3(world[0])),
+			std::max(glm::length(glm::vec3(world[1])), glm::length(glm::vec3(world[2]))));
+		float pixels_per_error = world_scale * view_model_scale * pixels_per_unit / depth;
+
+		for (unsigned int level = n_levels - 1; level > 0; --level) {
+			if (hierarchy.getError(i, level) * pixels_per_error <= tolerance) {
+				levels[i] = static_cast<unsigned char>(level);
+				break;
+			}
+		}
+	}
+}
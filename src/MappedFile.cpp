@@ -0,0 +1,76 @@
+#include "MappedFile.h"
+
+#include "GameException.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string& filename) : mapped_data(NULL), mapped_size(0), mapping_handle(NULL) {
+	file_handle = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file_handle == INVALID_HANDLE_VALUE)
+		THROW_EXCEPTION("Could not open " + filename);
+
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file_handle, &file_size) || file_size.QuadPart == 0) {
+		CloseHandle(file_handle);
+		THROW_EXCEPTION("Could not map empty file " + filename);
+	}
+	mapped_size = static_cast<size_t>(file_size.QuadPart);
+
+	mapping_handle = CreateFileMappingA(file_handle, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping_handle == NULL) {
+		CloseHandle(file_handle);
+		THROW_EXCEPTION("Could not map " + filename);
+	}
+
+	mapped_data = static_cast<const unsigned char*>(MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0));
+	if (mapped_data == NULL) {
+		CloseHandle(mapping_handle);
+		CloseHandle(file_handle);
+		THROW_EXCEPTION("Could not map " + filename);
+	}
+}
+
+MappedFile::~MappedFile() {
+	UnmapViewOfFile(mapped_data);
+	CloseHandle(mapping_handle);
+	CloseHandle(file_handle);
+}
+
+#else
+
+MappedFile::MappedFile(const std::string& filename) : mapped_data(NULL), mapped_size(0) {
+	fd = open(filename.c_str(), O_RDONLY);
+	if (fd < 0)
+		THROW_EXCEPTION("Could not open " + filename);
+
+	struct stat file_stat;
+	if (fstat(fd, &file_stat) != 0 || file_stat.st_size == 0) {
+		close(fd);
+		THROW_EXCEPTION("Could not map empty file " + filename);
+	}
+	mapped_size = static_cast<size_t>(file_stat.st_size);
+
+	void* address = mmap(NULL, mapped_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (address == MAP_FAILED) {
+		close(fd);
+		THROW_EXCEPTION("Could not map " + filename);
+	}
+	mapped_data = static_cast<const unsigned char*>(address);
+
+	// We read everything front to back, so let the kernel read ahead
+	madvise(address, mapped_size, MADV_SEQUENTIAL);
+}
+
+MappedFile::~MappedFile() {
+	munmap(const_cast<unsigned char*>(mapped_data), mapped_size);
+	close(fd);
+}
+
+#endif
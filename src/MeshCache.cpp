@@ -0,0 +1,323 @@
+#include "MeshCache.h"
+
+#include "GameException.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <vector>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+namespace {
+	const char cache_magic[8] = {'P', 'G', 'M', 'E', 'S', 'H', '\0', '\0'};
+	const uint32_t cache_version = 7;
+	const uint64_t block_alignment = 64; //< The vertex and index blocks start on a cache line
+	const uint32_t cache_optimized = 1;
+	const uint32_t cache_obj_reader = 2;
+
+	struct CacheHeader {
+		char magic[8];
+		uint32_t version;
+		uint32_t vertex_size; //< Bytes per vertex in the vertex block
+
+		uint64_t source_size;
+		int64_t source_mtime; //< Nanoseconds since the epoch
+		uint64_t source_hash;
+
+		uint32_t n_parts;
+		uint32_t n_vertices;
+		uint32_t n_indices;
+		uint32_t n_soup_vertices;
+		uint32_t index_type; //< GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+		uint32_t n_levels; //< Levels of detail, including the full one
+		uint32_t flags; //< cache_optimized if the meshes went through MeshOptimizer, cache_obj_reader if ObjReader read the model
+		uint32_t import_profile; //< ImportProfile::Profile the model was imported with, unused with ObjReader
+
+		float min_dim[3];
+		float max_dim[3];
+
+		uint64_t parts_offset;
+		uint64_t vertex_offset;
+		uint64_t index_offset;
+		uint64_t file_size;
+	};
+
+	// One node of the MeshHierarchy, stored in hierarchy order (parents first)
+	struct CachePart {
+		float transform[16]; //< Local transform
+		uint32_t first;
+		uint32_t count;
+		int32_t parent; //< -1 for a root
+		float bounds_min[3]; //< Bounding box of the geometry, in the space of the node
+		float bounds_max[3];
+	};
+
+	// The range of one node at one of the coarser levels of detail. Follows
+	// the nodes, node by node, with the levels 1 .. n_levels-1 of each.
+	struct CacheLevel {
+		uint32_t first;
+		uint32_t count;
+		float error;
+	};
+
+	uint64_t alignOffset(uint64_t offset) {
+		return (offset + block_alignment - 1) & ~(block_alignment - 1);
+	}
+
+	bool statFile(const std::string& filename, uint64_t& size, int64_t& mtime) {
+#ifdef _WIN32
+		struct _stat64 file_stat;
+		if (_stat64(filename.c_str(), &file_stat) != 0)
+			return false;
+#else
+		struct stat file_stat;
+		if (stat(filename.c_str(), &file_stat) != 0)
+			return false;
+#endif
+		size = static_cast<uint64_t>(file_stat.st_size);
+		// Use the full time stamp resolution where we have it, so that
+		// edits within the same second still invalidate the cache
+#if defined(__linux__)
+		mtime = static_cast<int64_t>(file_stat.st_mtim.tv_sec) * 1000000000 + file_stat.st_mtim.tv_nsec;
+#elif defined(__APPLE__)
+		mtime = static_cast<int64_t>(file_stat.st_mtimespec.tv_sec) * 1000000000 + file_stat.st_mtimespec.tv_nsec;
+#else
+		mtime = static_cast<int64_t>(file_stat.st_mtime) * 1000000000;
+#endif
+		return true;
+	}
+
+	// 64-bit FNV-1a hash of the contents of a file
+	uint64_t hashFile(const std::string& filename) {
+		std::ifstream is(filename.c_str(), std::ios::binary);
+		if (!is.good())
+			THROW_EXCEPTION("Could not open " + filename);
+
+		uint64_t hash = 14695981039346656037ULL;
+		std::vector<char> buffer(1 << 20);
+		while (is) {
+			is.read(&buffer[0], buffer.size());
+			std::streamsize n = is.gcount();
+			for (std::streamsize i = 0; i < n; ++i) {
+				hash ^= static_cast<unsigned char>(buffer[i]);
+				hash *= 1099511628211ULL;
+			}
+		}
+		return hash;
+	}
+
+	void writePadding(std::ofstream& os, uint64_t offset) {
+		static const char zeros[block_alignment] = {0};
+		uint64_t position = static_cast<uint64_t>(os.tellp());
+		if (offset > position)
+			os.write(zeros, static_cast<std::streamsize>(offset - position));
+	}
+}
+
+MeshCache::MeshCache(const std::string& cache_filename) {
+	file.reset(new MappedFile(cache_filename));
+
+	if (file->size() < sizeof(CacheHeader))
+		THROW_EXCEPTION("Corrupt mesh cache " + cache_filename);
+
+	CacheHeader header;
+	memcpy(&header, file->data(), sizeof(CacheHeader));
+
+	if (memcmp(header.magic, cache_magic, sizeof(cache_magic)) != 0 || header.version != cache_version
+			|| header.vertex_size != 6 * sizeof(float))
+		THROW_EXCEPTION("Not a mesh cache: " + cache_filename);
+
+	index_type = header.index_type;
+	unsigned int index_size = (index_type == GL_UNSIGNED_SHORT) ? 2 : 4;
+
+	if (header.import_profile >= ImportProfile::n_profiles)
+		THROW_EXCEPTION("Corrupt mesh cache " + cache_filename);
+	if (header.n_levels == 0 || header.n_levels > MeshHierarchy::max_levels)
+		THROW_EXCEPTION("Corrupt mesh cache " + cache_filename);
+	uint64_t levels_offset = header.parts_offset + static_cast<uint64_t>(header.n_parts) * sizeof(CachePart);
+	uint64_t n_cache_levels = static_cast<uint64_t>(header.n_parts) * (header.n_levels - 1);
+
+	if (header.file_size != file->size()
+			|| levels_offset + n_cache_levels * sizeof(CacheLevel) > header.file_size
+			|| header.vertex_offset + static_cast<uint64_t>(header.n_vertices) * header.vertex_size > header.file_size
+			|| header.index_offset + static_cast<uint64_t>(header.n_indices) * index_size > header.file_size)
+		THROW_EXCEPTION("Corrupt mesh cache " + cache_filename);
+
+	n_vertices = header.n_vertices;
+	n_indices = header.n_indices;
+	n_soup_vertices = header.n_soup_vertices;
+	optimized = (header.flags & cache_optimized) != 0;
+	obj_reader = (header.flags & cache_obj_reader) != 0;
+	import_profile = static_cast<ImportProfile::Profile>(header.import_profile);
+	min_dim = glm::vec3(header.min_dim[0], header.min_dim[1], header.min_dim[2]);
+	max_dim = glm::vec3(header.max_dim[0], header.max_dim[1], header.max_dim[2]);
+
+	vertices = file->data() + header.vertex_offset;
+	indices = file->data() + header.index_offset;
+
+	const CachePart* parts = reinterpret_cast<const CachePart*>(file->data() + header.parts_offset);
+	const CacheLevel* levels = reinterpret_cast<const CacheLevel*>(file->data() + levels_offset);
+	hierarchy.setNumLevels(header.n_levels);
+	hierarchy.reserve(header.n_parts);
+	for (uint32_t i = 0; i < header.n_parts; ++i) {
+		glm::mat4 transform;
+		memcpy(&transform[0][0], parts[i].transform, sizeof(parts[i].transform));
+		if (parts[i].parent >= static_cast<int32_t>(i) || parts[i].parent < -1)
+			THROW_EXCEPTION("Corrupt mesh cache: bad node hierarchy in " + cache_filename);
+		hierarchy.addNode(parts[i].parent, transform, parts[i].first, parts[i].count);
+		hierarchy.setBounds(i, glm::vec3(parts[i].bounds_min[0], parts[i].bounds_min[1], parts[i].bounds_min[2]),
+			glm::vec3(parts[i].bounds_max[0], parts[i].bounds_max[1], parts[i].bounds_max[2]));
+		for (uint32_t level = 1; level < header.n_levels; ++level) {
+			const CacheLevel& range = levels[i * (header.n_levels - 1) + level - 1];
+			hierarchy.setLevel(i, level, range.first, range.count, range.error);
+		}
+	}
+}
+
+MeshCache::~MeshCache() {
+
+}
+
+bool MeshCache::isUpToDate(const std::string& cache_filename, const std::string& source_filename) {
+	std::ifstream is(cache_filename.c_str(), std::ios::binary);
+	if (!is.good())
+		return false;
+
+	CacheHeader header;
+	if (!is.read(reinterpret_cast<char*>(&header), sizeof(CacheHeader)))
+		return false;
+	is.close();
+
+	if (memcmp(header.magic, cache_magic, sizeof(cache_magic)) != 0 || header.version != cache_version)
+		return false;
+
+	uint64_t source_size;
+	int64_t source_mtime;
+	if (!statFile(source_filename, source_size, source_mtime) || source_size != header.source_size)
+		return false;
+
+	// Same size and time stamp: assume it is the same file. Otherwise the file
+	// may only have been touched or copied, so compare the contents.
+	if (source_mtime == header.source_mtime)
+		return true;
+
+	if (hashFile(source_filename) != header.source_hash)
+		return false;
+
+	// Record the new time stamp, so the next load does not hash the file
+	// again. A cache we cannot write to is still valid.
+	std::fstream cache(cache_filename.c_str(), std::ios::binary | std::ios::in | std::ios::out);
+	if (cache.good()) {
+		cache.seekp(offsetof(CacheHeader, source_mtime));
+		cache.write(reinterpret_cast<const char*>(&source_mtime), sizeof(source_mtime));
+	}
+	return true;
+}
+
+void MeshCache::write(const std::string& cache_filename, const std::string& source_filename, const MeshData& data) {
+	CacheHeader header;
+	memset(&header, 0, sizeof(CacheHeader));
+	memcpy(header.magic, cache_magic, sizeof(cache_magic));
+	header.version = cache_version;
+	header.vertex_size = 6 * sizeof(float);
+
+	if (!statFile(source_filename, header.source_size, header.source_mtime))
+		THROW_EXCEPTION("Could not stat " + source_filename);
+	header.source_hash = hashFile(source_filename);
+
+	const MeshHierarchy& hierarchy = data.hierarchy;
+	std::vector<CachePart> parts(hierarchy.size());
+	for (unsigned int i = 0; i < hierarchy.size(); ++i) {
+		memcpy(parts[i].transform, &hierarchy.getLocalTransform(i)[0][0], sizeof(parts[i].transform));
+		parts[i].first = hierarchy.getFirst(i);
+		parts[i].count = hierarchy.getCount(i);
+		parts[i].parent = hierarchy.getParent(i);
+		for (int j = 0; j < 3; ++j) {
+			parts[i].bounds_min[j] = hierarchy.getBoundsMin(i)[j];
+			parts[i].bounds_max[j] = hierarchy.getBoundsMax(i)[j];
+		}
+	}
+
+	unsigned int n_levels = hierarchy.getNumLevels();
+	std::vector<CacheLevel> levels;
+	levels.reserve(hierarchy.size() * (n_levels - 1));
+	for (unsigned int i = 0; i < hierarchy.size(); ++i) {
+		for (unsigned int level = 1; level < n_levels; ++level) {
+			CacheLevel range = { hierarchy.getFirst(i, level), hierarchy.getCount(i, level), hierarchy.getError(i, level) };
+			levels.push_back(range);
+		}
+	}
+
+	header.n_parts = static_cast<uint32_t>(parts.size());
+	header.n_vertices = static_cast<uint32_t>(data.vertices.size() / 6);
+	header.n_indices = static_cast<uint32_t>(data.indices.size());
+	header.n_soup_vertices = data.n_soup_vertices;
+	header.index_type = Model::getIndexType(header.n_vertices);
+	header.n_levels = n_levels;
+	header.flags = (data.optimized ? cache_optimized : 0) | (data.obj_reader ? cache_obj_reader : 0);
+	header.import_profile = data.import_profile;
+	unsigned int index_size = (header.index_type == GL_UNSIGNED_SHORT) ? 2 : 4;
+
+	for (int i = 0; i < 3; ++i) {
+		header.min_dim[i] = data.min_dim[i];
+		header.max_dim[i] = data.max_dim[i];
+	}
+
+	header.parts_offset = alignOffset(sizeof(CacheHeader));
+	uint64_t levels_offset = header.parts_offset + parts.size() * sizeof(CachePart);
+	header.vertex_offset = alignOffset(levels_offset + levels.size() * sizeof(CacheLevel));
+	header.index_offset = alignOffset(header.vertex_offset + static_cast<uint64_t>(header.n_vertices) * header.vertex_size);
+	header.file_size = header.index_offset + static_cast<uint64_t>(header.n_indices) * index_size;
+
+	std::string tmp_filename = cache_filename + ".tmp";
+	std::ofstream os(tmp_filename.c_str(), std::ios::binary | std::ios::trunc);
+	if (!os.good())
+		THROW_EXCEPTION("Could not open " + tmp_filename + " for writing");
+
+	os.write(reinterpret_cast<const char*>(&header), sizeof(CacheHeader));
+
+	writePadding(os, header.parts_offset);
+	if (!parts.empty())
+		os.write(reinterpret_cast<const char*>(&parts[0]), parts.size() * sizeof(CachePart));
+	if (!levels.empty())
+		os.write(reinterpret_cast<const char*>(&levels[0]), levels.size() * sizeof(CacheLevel));
+
+	writePadding(os, header.vertex_offset);
+	if (!data.vertices.empty())
+		os.write(reinterpret_cast<const char*>(&data.vertices[0]), data.vertices.size() * sizeof(float));
+
+	writePadding(os, header.index_offset);
+	if (header.index_type == GL_UNSIGNED_SHORT) {
+		// Narrow the indices in chunks, so we never hold a second full copy
+		std::vector<uint16_t> chunk;
+		chunk.reserve(64 * 1024);
+		for (size_t i = 0; i < data.indices.size(); i += chunk.capacity()) {
+			size_t end = std::min(data.indices.size(), i + chunk.capacity());
+			chunk.clear();
+			for (size_t j = i; j < end; ++j)
+				chunk.push_back(static_cast<uint16_t>(data.indices[j]));
+			os.write(reinterpret_cast<const char*>(&chunk[0]), chunk.size() * sizeof(uint16_t));
+		}
+	}
+	else if (!data.indices.empty()) {
+		os.write(reinterpret_cast<const char*>(&data.indices[0]), data.indices.size() * sizeof(uint32_t));
+	}
+
+	bool ok = os.good();
+	os.close();
+	if (!ok) {
+		std::remove(tmp_filename.c_str());
+		THROW_EXCEPTION("Could not write mesh cache " + cache_filename);
+	}
+
+	// rename() does not replace an existing file on Windows
+	std::remove(cache_filename.c_str());
+	if (std::rename(tmp_filename.c_str(), cache_filename.c_str()) != 0) {
+		std::remove(tmp_filename.c_str());
+		THROW_EXCEPTION("Could not write mesh cache " + cache_filename);
+	}
+}
@@ -0,0 +1,169 @@
+#include "MeshHierarchy.h"
+
+#include "GameException.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace {
+	const glm::vec3 empty_min(std::numeric_limits<float>::max());
+	const glm::vec3 empty_max(-std::numeric_limits<float>::max());
+
+	// Box around the transformed box (Arvo): every row of the matrix adds
+	// the smaller and the larger product with each axis range
+	void transformBounds(const glm::mat4& m, const glm::vec3& min, const glm::vec3& max, glm::vec3& out_min, glm::vec3& out_max) {
+		out_min = glm::vec3(m[3]);
+		out_max = glm::vec3(m[3]);
+		for (int j = 0; j < 3; ++j) {
+			glm::vec3 a = glm::vec3(m[j]) * min[j];
+			glm::vec3 b = glm::vec3(m[j]) * max[j];
+			out_min += glm::min(a, b);
+			out_max += glm::max(a, b);
+		}
+	}
+}
+
+MeshHierarchy::MeshHierarchy() : first_dirty(0), version(0), n_levels(1), vertex_transform(1.0f), has_vertex_transform(false) {
+
+}
+
+MeshHierarchy::~MeshHierarchy() {
+
+}
+
+unsigned int MeshHierarchy::addNode(int parent, const glm::mat4& local_transform, unsigned int first, unsigned int count) {
+	unsigned int node = size();
+	if (parent >= static_cast<int>(node))
+		THROW_EXCEPTION("MeshHierarchy: a parent must be added before its children");
+
+	parents.push_back(parent);
+	local_transforms.push_back(local_transform);
+	world_transforms.push_back(local_transform);
+	normal_transforms.push_back(glm::mat4(1.0f));
+	if (has_vertex_transform)
+		vertex_world_transforms.push_back(local_transform * vertex_transform);
+	for (unsigned int level = 0; level < n_levels; ++level) {
+		firsts.push_back(first);
+		counts.push_back(count);
+		errors.push_back(0.0f);
+	}
+	bounds_min.push_back(empty_min);
+	bounds_max.push_back(empty_max);
+	world_bounds_min.push_back(empty_min);
+	world_bounds_max.push_back(empty_max);
+	dirty.push_back(1);
+
+	first_dirty = std::min(first_dirty, node);
+	return node;
+}
+
+void MeshHierarchy::reserve(unsigned int n_nodes) {
+	parents.reserve(n_nodes);
+	local_transforms.reserve(n_nodes);
+	world_transforms.reserve(n_nodes);
+	normal_transforms.reserve(n_nodes);
+	if (has_vertex_transform)
+		vertex_world_transforms.reserve(n_nodes);
+	firsts.reserve(n_nodes * n_levels);
+	counts.reserve(n_nodes * n_levels);
+	errors.reserve(n_nodes * n_levels);
+	bounds_min.reserve(n_nodes);
+	bounds_max.reserve(n_nodes);
+	world_bounds_min.reserve(n_nodes);
+	world_bounds_max.reserve(n_nodes);
+	dirty.reserve(n_nodes);
+}
+
+void MeshHierarchy::clear() {
+	parents.clear();
+	local_transforms.clear();
+	world_transforms.clear();
+	normal_transforms.clear();
+	vertex_world_transforms.clear();
+	firsts.clear();
+	counts.clear();
+	errors.clear();
+	bounds_min.clear();
+	bounds_max.clear();
+	world_bounds_min.clear();
+	world_bounds_max.clear();
+	dirty.clear();
+	first_dirty = 0;
+	++version;
+}
+
+void MeshHierarchy::setNumLevels(unsigned int n_levels) {
+	if (size() > 0)
+		THROW_EXCEPTION("MeshHierarchy: the number of levels must be set before adding nodes");
+	if (n_levels == 0)
+		THROW_EXCEPTION("MeshHierarchy: there must be at least one level");
+	if (n_levels > max_levels)
+		THROW_EXCEPTION("MeshHierarchy: too many levels of detail");
+	this->n_levels = n_levels;
+}
+
+void MeshHierarchy::setLevel(unsigned int node, unsigned int level, unsigned int first, unsigned int count, float error) {
+	firsts[node * n_levels + level] = first;
+	counts[node * n_levels + level] = count;
+	errors[node * n_levels + level] = error;
+}
+
+void MeshHierarchy::setVertexTransform(const glm::mat4& vertex_transform) {
+	this->vertex_transform = vertex_transform;
+	has_vertex_transform = (vertex_transform != glm::mat4(1.0f));
+	vertex_world_transforms.assign(has_vertex_transform ? size() : 0, glm::mat4(1.0f));
+
+	// Every node has to be updated
+	std::fill(dirty.begin(), dirty.end(), 1);
+	first_dirty = 0;
+}
+
+void MeshHierarchy::setBounds(unsigned int node, const glm::vec3& min, const glm::vec3& max) {
+	bounds_min[node] = min;
+	bounds_max[node] = max;
+	dirty[node] = 1;
+	first_dirty = std::min(first_dirty, node);
+}
+
+void MeshHierarchy::setLocalTransform(unsigned int node, const glm::mat4& local_transform) {
+	local_transforms[node] = local_transform;
+	dirty[node] = 1;
+	first_dirty = std::min(first_dirty, node);
+}
+
+void MeshHierarchy::updateWorldTransforms() {
+	unsigned int n_nodes = size();
+	if (first_dirty >= n_nodes)
+		return;
+
+	// Parents come first, so a single sweep sees every parent updated before
+	// its children. A node whose parent moved is marked dirty as well, which
+	// carries the change down the whole subtree.
+	for (unsigned int i = first_dirty; i < n_nodes; ++i) {
+		int parent = parents[i];
+		if (parent >= 0 && dirty[parent])
+			dirty[i] = 1;
+		if (!dirty[i])
+			continue;
+
+		if (parent >= 0)
+			world_transforms[i] = world_transforms[parent] * local_transforms[i];
+		else
+			world_transforms[i] = local_transforms[i];
+		normal_transforms[i] = glm::mat4(glm::transpose(glm::inverse(glm::mat3(world_transforms[i]))));
+		if (has_vertex_transform)
+			vertex_world_transforms[i] = world_transforms[i] * vertex_transform;
+
+		if (hasBounds(i)) {
+			transformBounds(world_transforms[i], bounds_min[i], bounds_max[i], world_bounds_min[i], world_bounds_max[i]);
+		}
+		else {
+			world_bounds_min[i] = empty_min;
+			world_bounds_max[i] = empty_max;
+		}
+	}
+
+	std::fill(dirty.begin() + first_dirty, dirty.end(), 0);
+	first_dirty = n_nodes;
+	++version;
+}
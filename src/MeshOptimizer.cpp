@@ -0,0 +1,285 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+namespace {
+	const unsigned int lru_cache_size = 32; //< Cache optimizeVertexCache models
+	const unsigned int not_cached = ~0u;
+
+	// Score of a vertex (Forsyth): recently used vertices score high, the
+	// last triangle's vertices a bit less so strips do not win, and
+	// vertices with few triangles left are boosted so none get stranded
+	float vertexScore(unsigned int cache_position, unsigned int remaining_triangles) {
+		if (remaining_triangles == 0)
+			return -1.0f;
+
+		float score = 0.0f;
+		if (cache_position != not_cached) {
+			if (cache_position < 3)
+				score = 0.75f;
+			else
+				score = std::pow(1.0f - (cache_position - 3) / static_cast<float>(lru_cache_size - 3), 1.5f);
+		}
+		return score + 2.0f / std::sqrt(static_cast<float>(remaining_triangles));
+	}
+
+	// FIFO cache for measuring misses. A timestamp per vertex tells if
+	// it is still among the last cache_size misses.
+	class FifoCache {
+	public:
+		FifoCache(unsigned int n_vertices, unsigned int cache_size)
+			: timestamps(n_vertices, 0), time(cache_size + 1), cache_size(cache_size) {}
+
+		// Returns 1 if the vertex was not in the cache
+		inline unsigned int access(unsigned int vertex) {
+			if (time - timestamps[vertex] > cache_size) {
+				timestamps[vertex] = time++;
+				return 1;
+			}
+			return 0;
+		}
+
+		inline void clear() {
+			time += cache_size + 1;
+		}
+
+	private:
+		std::vector<unsigned int> timestamps;
+		unsigned int time;
+		unsigned int cache_size;
+	};
+}
+
+float MeshOptimizer::getACMR(const unsigned int* indices, size_t n_indices, unsigned int n_vertices, unsigned int cache_size) {
+	if (n_indices < 3)
+		return 0.0f;
+
+	FifoCache cache(n_vertices, cache_size);
+	size_t misses = 0;
+	for (size_t i = 0; i < n_indices; ++i)
+		misses += cache.access(indices[i]);
+	return misses / static_cast<float>(n_indices / 3);
+}
+
+void MeshOptimizer::optimizeVertexCache(unsigned int* indices, size_t n_indices, unsigned int n_vertices) {
+	size_t n_triangles = n_indices / 3;
+	if (n_triangles < 2)
+		return;
+
+	// The triangles around every vertex. The ones not emitted yet are kept
+	// at the front of each list, remaining_triangles long.
+	std::vector<unsigned int> offsets(n_vertices + 1, 0);
+	for (size_t i = 0; i < n_triangles * 3; ++i)
+		++offsets[indices[i] + 1];
+	for (unsigned int v = 0; v < n_vertices; ++v)
+		offsets[v + 1] += offsets[v];
+	std::vector<unsigned int> adjacency(n_triangles * 3);
+	std::vector<unsigned int> remaining_triangles(n_vertices, 0);
+	for (size_t i = 0; i < n_triangles * 3; ++i) {
+		unsigned int v = indices[i];
+		adjacency[offsets[v] + remaining_triangles[v]++] = static_cast<unsigned int>(i / 3);
+	}
+
+	std::vector<float> vertex_scores(n_vertices);
+	for (unsigned int v = 0; v < n_vertices; ++v)
+		vertex_scores[v] = vertexScore(not_cached, remaining_triangles[v]);
+
+	std::vector<unsigned char> emitted(n_triangles, 0);
+	std::vector<unsigned int> output;
+	output.reserve(n_triangles * 3);
+
+	unsigned int cache[lru_cache_size + 3];
+	unsigned int cache_count = 0;
+	size_t next_unemitted = 0; //< Where to look for a new start, when the cache has nothing left
+
+	size_t best = 0;
+	for (;;) {
+		emitted[best] = 1;
+		const unsigned int* triangle = &indices[best * 3];
+		output.insert(output.end(), triangle, triangle + 3);
+
+		// The emitted triangle is done for its vertices
+		for (int k = 0; k < 3; ++k) {
+			unsigned int v = triangle[k];
+			unsigned int* list = &adjacency[offsets[v]];
+			unsigned int* end = list + remaining_triangles[v];
+			*std::find(list, end, static_cast<unsigned int>(best)) = *(end - 1);
+			--remaining_triangles[v];
+		}
+
+		// Move its vertices to the front of the LRU cache
+		unsigned int new_cache[lru_cache_size + 3];
+		unsigned int new_count = 0;
+		for (int k = 0; k < 3; ++k)
+			new_cache[new_count++] = triangle[k];
+		for (unsigned int i = 0; i < cache_count; ++i) {
+			unsigned int v = cache[i];
+			if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+				new_cache[new_count++] = v;
+		}
+		for (unsigned int i = lru_cache_size; i < new_count; ++i) {
+			unsigned int v = new_cache[i];
+			vertex_scores[v] = vertexScore(not_cached, remaining_triangles[v]);
+		}
+		cache_count = std::min(new_count, lru_cache_size);
+		memcpy(cache, new_cache, cache_count * sizeof(unsigned int));
+
+		// Rescore the vertices in the cache, and pick the best triangle around them
+		for (unsigned int i = 0; i < cache_count; ++i) {
+			unsigned int v = cache[i];
+			vertex_scores[v] = vertexScore(i, remaining_triangles[v]);
+		}
+
+		float best_score = -1.0f;
+		bool found = false;
+		for (unsigned int i = 0; i < cache_count; ++i) {
+			unsigned int v = cache[i];
+			for (unsigned int j = 0; j < remaining_triangles[v]; ++j) {
+				unsigned int t = adjacency[offsets[v] + j];
+				const unsigned int* corners = &indices[t * 3];
+				float score = vertex_scores[corners[0]] + vertex_scores[corners[1]] + vertex_scores[corners[2]];
+				if (score > best_score) {
+					best_score = score;
+					best = t;
+					found = true;
+				}
+			}
+		}
+
+		if (!found) {
+			// Nothing left around the cache: start again at the first
+			// triangle (in the input order) that is not emitted yet
+			while (next_unemitted < n_triangles && emitted[next_unemitted])
+				++next_unemitted;
+			if (next_unemitted == n_triangles)
+				break;
+			best = next_unemitted;
+		}
+	}
+
+	std::copy(output.begin(), output.end(), indices);
+}
+
+void MeshOptimizer::optimizeOverdraw(unsigned int* indices, size_t n_indices, const float* vertices, size_t stride, unsigned int n_vertices,
+		float threshold) {
+	size_t n_triangles = n_indices / 3;
+	if (n_triangles < 2)
+		return;
+
+	// Hard boundaries: triangles that miss all three vertices, where the
+	// cache starts over anyway
+	FifoCache cache(n_vertices, fifo_cache_size);
+	std::vector<size_t> hard_boundaries;
+	for (size_t t = 0; t < n_triangles; ++t) {
+		unsigned int misses = cache.access(indices[t*3]) + cache.access(indices[t*3+1]) + cache.access(indices[t*3+2]);
+		if (t == 0 || misses == 3)
+			hard_boundaries.push_back(t);
+	}
+	hard_boundaries.push_back(n_triangles);
+
+	// Soft boundaries: split a hard cluster wherever the part so far has a
+	// miss ratio within threshold of the whole cluster, starting a cold
+	// cache there, so splitting costs little vertex cache efficiency
+	std::vector<size_t> clusters;
+	for (size_t c = 0; c + 1 < hard_boundaries.size(); ++c) {
+		size_t start = hard_boundaries[c], end = hard_boundaries[c + 1];
+
+		cache.clear();
+		size_t cluster_misses = 0;
+		for (size_t t = start; t < end; ++t)
+			cluster_misses += cache.access(indices[t*3]) + cache.access(indices[t*3+1]) + cache.access(indices[t*3+2]);
+		float cluster_threshold = threshold * cluster_misses / static_cast<float>(end - start);
+
+		cache.clear();
+		clusters.push_back(start);
+		size_t running_misses = 0, running_triangles = 0;
+		for (size_t t = start; t < end; ++t) {
+			running_misses += cache.access(indices[t*3]) + cache.access(indices[t*3+1]) + cache.access(indices[t*3+2]);
+			++running_triangles;
+			if (t + 1 < end && running_misses <= cluster_threshold * running_triangles) {
+				clusters.push_back(t + 1);
+				cache.clear();
+				running_misses = 0;
+				running_triangles = 0;
+			}
+		}
+	}
+	clusters.push_back(n_triangles);
+	size_t n_clusters = clusters.size() - 1;
+
+	// Centroid and normal of every cluster, weighted by area
+	std::vector<double> centroids(n_clusters * 3, 0.0), normals(n_clusters * 3, 0.0);
+	double mesh_centroid[3] = {0.0, 0.0, 0.0}, mesh_area = 0.0;
+	for (size_t c = 0; c < n_clusters; ++c) {
+		double area_sum = 0.0;
+		for (size_t t = clusters[c]; t < clusters[c + 1]; ++t) {
+			const float* p0 = vertices + indices[t*3] * stride;
+			const float* p1 = vertices + indices[t*3+1] * stride;
+			const float* p2 = vertices + indices[t*3+2] * stride;
+			double e1[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+			double e2[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+			double n[3] = {e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0]};
+			double area = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+			for (int k = 0; k < 3; ++k) {
+				centroids[c*3 + k] += (p0[k] + p1[k] + p2[k]) / 3.0 * area;
+				normals[c*3 + k] += n[k];
+			}
+			area_sum += area;
+		}
+		for (int k = 0; k < 3; ++k) {
+			mesh_centroid[k] += centroids[c*3 + k];
+			if (area_sum > 0.0)
+				centroids[c*3 + k] /= area_sum;
+		}
+		mesh_area += area_sum;
+	}
+	if (mesh_area > 0.0)
+		for (int k = 0; k < 3; ++k)
+			mesh_centroid[k] /= mesh_area;
+
+	// Clusters far out along their normal are likely to hide the rest
+	std::vector<float> sort_keys(n_clusters);
+	std::vector<size_t> order(n_clusters);
+	for (size_t c = 0; c < n_clusters; ++c) {
+		const double* n = &normals[c*3];
+		double length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		double dot = 0.0;
+		for (int k = 0; k < 3; ++k)
+			dot += (centroids[c*3 + k] - mesh_centroid[k]) * n[k];
+		sort_keys[c] = (length > 0.0) ? static_cast<float>(dot / length) : 0.0f;
+		order[c] = c;
+	}
+	std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+		return sort_keys[a] > sort_keys[b];
+	});
+
+	std::vector<unsigned int> output;
+	output.reserve(n_triangles * 3);
+	for (size_t i = 0; i < n_clusters; ++i) {
+		size_t c = order[i];
+		output.insert(output.end(), indices + clusters[c] * 3, indices + clusters[c + 1] * 3);
+	}
+	std::copy(output.begin(), output.end(), indices);
+}
+
+void MeshOptimizer::optimizeVertexFetch(unsigned int* indices, size_t n_indices, float* vertices, size_t stride, unsigned int n_vertices) {
+	std::vector<unsigned int> remap(n_vertices, not_cached);
+	unsigned int next = 0;
+	for (size_t i = 0; i < n_indices; ++i) {
+		unsigned int& target = remap[indices[i]];
+		if (target == not_cached)
+			target = next++;
+		indices[i] = target;
+	}
+	for (unsigned int v = 0; v < n_vertices; ++v)
+		if (remap[v] == not_cached)
+			remap[v] = next++;
+
+	std::vector<float> reordered(static_cast<size_t>(n_vertices) * stride);
+	for (unsigned int v = 0; v < n_vertices; ++v)
+		memcpy(&reordered[remap[v] * stride], &vertices[v * stride], stride * sizeof(float));
+	std::copy(reordered.begin(), reordered.end(), vertices);
+}
@@ -0,0 +1,251 @@
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <utility>
+
+namespace {
+	inline void subtract(const float* a, const float* b, double* out) {
+		out[0] = a[0] - b[0];
+		out[1] = a[1] - b[1];
+		out[2] = a[2] - b[2];
+	}
+
+	inline void cross(const double* a, const double* b, double* out) {
+		out[0] = a[1] * b[2] - a[2] * b[1];
+		out[1] = a[2] * b[0] - a[0] * b[2];
+		out[2] = a[0] * b[1] - a[1] * b[0];
+	}
+
+	inline void triangleNormal(const float* p0, const float* p1, const float* p2, double* normal) {
+		double e1[3], e2[3];
+		subtract(p1, p0, e1);
+		subtract(p2, p0, e2);
+		cross(e1, e2, normal);
+	}
+}
+
+MeshSimplifier::MeshSimplifier(const float* vertices, size_t stride, unsigned int n_vertices, const unsigned int* indices, size_t n_indices)
+		: vertices(vertices), stride(stride), n_vertices(n_vertices), indices(indices, indices + n_indices), error(0.0f) {
+	// Vertices that only differ in their normal share a position. Find them
+	// by sorting, and use the first of them to stand for the position.
+	std::vector<unsigned int> order(n_vertices);
+	for (unsigned int i = 0; i < n_vertices; ++i)
+		order[i] = i;
+	std::sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) {
+		const float* pa = getPosition(a);
+		const float* pb = getPosition(b);
+		if (pa[0] != pb[0]) return pa[0] < pb[0];
+		if (pa[1] != pb[1]) return pa[1] < pb[1];
+		if (pa[2] != pb[2]) return pa[2] < pb[2];
+		return a < b;
+	});
+
+	positions.resize(n_vertices);
+	locked.assign(n_vertices, 0);
+	for (unsigned int i = 0; i < n_vertices; ++i) {
+		unsigned int vertex = order[i];
+		if (i > 0 && memcmp(getPosition(vertex), getPosition(order[i-1]), 3 * sizeof(float)) == 0) {
+			positions[vertex] = positions[order[i-1]];
+			locked[positions[vertex]] = 1; // A seam
+		}
+		else {
+			positions[vertex] = vertex;
+		}
+	}
+
+	// Edges used by only one triangle are on a border
+	std::vector<std::pair<unsigned int, unsigned int> > edges;
+	edges.reserve(n_indices);
+	for (size_t t = 0; t + 2 < n_indices; t += 3) {
+		for (int k = 0; k < 3; ++k) {
+			unsigned int a = positions[indices[t + k]];
+			unsigned int b = positions[indices[t + (k+1) % 3]];
+			edges.push_back(std::make_pair(std::min(a, b), std::max(a, b)));
+		}
+	}
+	std::sort(edges.begin(), edges.end());
+	for (size_t i = 0; i < edges.size(); ) {
+		size_t j = i + 1;
+		while (j < edges.size() && edges[j] == edges[i])
+			++j;
+		if (j - i == 1) {
+			locked[edges[i].first] = 1;
+			locked[edges[i].second] = 1;
+		}
+		i = j;
+	}
+
+	// Every position starts with the planes of the triangles around it
+	Quadric zero;
+	memset(&zero, 0, sizeof(Quadric));
+	quadrics.assign(n_vertices, zero);
+	for (size_t t = 0; t + 2 < n_indices; t += 3) {
+		const float* p0 = getPosition(indices[t]);
+		double n[3];
+		triangleNormal(p0, getPosition(indices[t+1]), getPosition(indices[t+2]), n);
+		double length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		if (length == 0.0)
+			continue;
+		n[0] /= length;
+		n[1] /= length;
+		n[2] /= length;
+		double d = -(n[0] * p0[0] + n[1] * p0[1] + n[2] * p0[2]);
+		const double plane[10] = {
+			n[0] * n[0], n[0] * n[1], n[0] * n[2], n[0] * d,
+			n[1] * n[1], n[1] * n[2], n[1] * d,
+			n[2] * n[2], n[2] * d,
+			d * d
+		};
+		for (int k = 0; k < 3; ++k) {
+			Quadric& quadric = quadrics[positions[indices[t + k]]];
+			for (int i = 0; i < 10; ++i)
+				quadric.a[i] += plane[i];
+		}
+	}
+}
+
+MeshSimplifier::~MeshSimplifier() {
+
+}
+
+double MeshSimplifier::evaluate(const Quadric& q, unsigned int vertex) const {
+	const float* p = getPosition(vertex);
+	double x = p[0], y = p[1], z = p[2];
+	return q.a[0] * x * x + 2.0 * q.a[1] * x * y + 2.0 * q.a[2] * x * z + 2.0 * q.a[3] * x
+		+ q.a[4] * y * y + 2.0 * q.a[5] * y * z + 2.0 * q.a[6] * y
+		+ q.a[7] * z * z + 2.0 * q.a[8] * z
+		+ q.a[9];
+}
+
+bool MeshSimplifier::flipsTriangle(unsigned int from, unsigned int to) const {
+	unsigned int to_position = positions[to];
+	for (unsigned int i = adjacency_offsets[from]; i < adjacency_offsets[from + 1]; ++i) {
+		const unsigned int* triangle = &indices[adjacency[i]];
+		if (positions[triangle[0]] == to_position || positions[triangle[1]] == to_position || positions[triangle[2]] == to_position)
+			continue; // Collapses to nothing
+
+		const float* corners[3];
+		const float* moved[3];
+		for (int k = 0; k < 3; ++k) {
+			corners[k] = getPosition(triangle[k]);
+			moved[k] = (triangle[k] == from) ? getPosition(to) : corners[k];
+		}
+		double before[3], after[3];
+		triangleNormal(corners[0], corners[1], corners[2], before);
+		triangleNormal(moved[0], moved[1], moved[2], after);
+		// Turning a triangle far over flips it, or folds it onto its neighbours
+		double dot = before[0] * after[0] + before[1] * after[1] + before[2] * after[2];
+		double lengths = std::sqrt((before[0] * before[0] + before[1] * before[1] + before[2] * before[2])
+			* (after[0] * after[0] + after[1] * after[1] + after[2] * after[2]));
+		if (dot <= 0.25 * lengths)
+			return true;
+	}
+	return false;
+}
+
+size_t MeshSimplifier::collapsePass(size_t target_indices) {
+	size_t n_triangles = indices.size() / 3;
+
+	// The triangles around every vertex, as offsets into indices
+	adjacency_offsets.assign(n_vertices + 1, 0);
+	for (size_t i = 0; i < indices.size(); ++i)
+		++adjacency_offsets[indices[i] + 1];
+	for (unsigned int v = 0; v < n_vertices; ++v)
+		adjacency_offsets[v + 1] += adjacency_offsets[v];
+	adjacency.resize(indices.size());
+	std::vector<unsigned int> fill(adjacency_offsets.begin(), adjacency_offsets.end() - 1);
+	for (size_t i = 0; i < indices.size(); ++i)
+		adjacency[fill[indices[i]]++] = static_cast<unsigned int>(i - i % 3);
+
+	// Both directions of every edge, cheapest first
+	collapses.clear();
+	for (size_t t = 0; t < indices.size(); t += 3) {
+		for (int k = 0; k < 3; ++k) {
+			unsigned int a = indices[t + k];
+			unsigned int b = indices[t + (k+1) % 3];
+			if (positions[a] == positions[b])
+				continue;
+
+			Quadric sum = quadrics[positions[a]];
+			const Quadric& other = quadrics[positions[b]];
+			for (int i = 0; i < 10; ++i)
+				sum.a[i] += other.a[i];
+
+			if (!locked[positions[a]]) {
+				Collapse collapse = { evaluate(sum, b), a, b };
+				collapses.push_back(collapse);
+			}
+			if (!locked[positions[b]]) {
+				Collapse collapse = { evaluate(sum, a), b, a };
+				collapses.push_back(collapse);
+			}
+		}
+	}
+	// A collapse removes two triangles, and some are skipped, so only the
+	// cheapest few times as many as needed are sorted
+	struct CheaperFirst {
+		bool operator()(const Collapse& a, const Collapse& b) const {return a.cost < b.cost;}
+	};
+	size_t n_candidates = std::min(collapses.size(), 4 * (n_triangles - std::min(n_triangles, target_indices / 3)) + 16);
+	std::nth_element(collapses.begin(), collapses.begin() + n_candidates, collapses.end(), CheaperFirst());
+	collapses.resize(n_candidates);
+	std::sort(collapses.begin(), collapses.end(), CheaperFirst());
+
+	// Take the cheapest collapses that do not touch the triangles of an
+	// earlier one in this pass, so each one sees the mesh as it is
+	std::vector<unsigned char> touched(n_vertices, 0);
+	std::vector<unsigned int> remap(n_vertices);
+	for (unsigned int v = 0; v < n_vertices; ++v)
+		remap[v] = v;
+
+	size_t target_triangles = target_indices / 3;
+	size_t n_collapses = 0;
+	for (size_t c = 0; c < collapses.size() && n_triangles > target_triangles; ++c) {
+		const Collapse& collapse = collapses[c];
+		unsigned int from_position = positions[collapse.from];
+		unsigned int to_position = positions[collapse.to];
+		if (touched[from_position] || touched[to_position] || flipsTriangle(collapse.from, collapse.to))
+			continue;
+
+		remap[collapse.from] = collapse.to;
+		Quadric& quadric = quadrics[to_position];
+		for (int i = 0; i < 10; ++i)
+			quadric.a[i] += quadrics[from_position].a[i];
+		error = std::max(error, static_cast<float>(std::sqrt(std::max(collapse.cost, 0.0))));
+
+		for (unsigned int i = adjacency_offsets[collapse.from]; i < adjacency_offsets[collapse.from + 1]; ++i) {
+			const unsigned int* triangle = &indices[adjacency[i]];
+			bool removed = false;
+			for (int k = 0; k < 3; ++k) {
+				touched[positions[triangle[k]]] = 1;
+				removed = removed || (positions[triangle[k]] == to_position);
+			}
+			if (removed)
+				--n_triangles;
+		}
+		++n_collapses;
+	}
+
+	// Move the collapsed vertices, and drop the triangles that lost an area
+	size_t out = 0;
+	for (size_t t = 0; t < indices.size(); t += 3) {
+		unsigned int a = remap[indices[t]], b = remap[indices[t+1]], c = remap[indices[t+2]];
+		if (positions[a] == positions[b] || positions[b] == positions[c] || positions[a] == positions[c])
+			continue;
+		indices[out++] = a;
+		indices[out++] = b;
+		indices[out++] = c;
+	}
+	indices.resize(out);
+	return n_collapses;
+}
+
+size_t MeshSimplifier::simplify(size_t target_indices) {
+	while (indices.size() > target_indices) {
+		if (collapsePass(target_indices) == 0)
+			break;
+	}
+	return indices.size();
+}
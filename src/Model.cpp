@@ -1,189 +1,768 @@
-#include "Model.h"
-
-#include "GameException.h"
-
-#include <iostream>
-#include <glm/gtc/matrix_transform.hpp>
-
-Model::Model(std::string filename, bool invert) : min_dim(std::numeric_limits<float>::max()), max_dim(-std::numeric_limits<float>::max()) {
-	std::vector<float> vertex_data, normal_data;
-	aiMatrix4x4 trafo;
-	aiIdentityMatrix4(&trafo);
-
-	scene = aiImportFile(filename.c_str(), aiProcessPreset_TargetRealtime_Quality);// | aiProcess_FlipWindingOrder);
-	if (!scene) {
-		std::string log = "Unable to load mesh from ";
-		log.append(filename);
-		THROW_EXCEPTION(log);
-	}
-
-	//Load the model recursively into data
-	loadRecursive(root, invert, vertex_data, normal_data, scene, scene->mRootNode);
-
-	n_vertices = vertex_data.size();
-
-	// Create the Axis-aligned bounding box
-	MakeBoudingBox(vertex_data);
-	
-
-	root.transform = glm::scale(root.transform, FindScaleVector());
-	root.transform = glm::translate(root.transform, FindTranslateVector());
-
-
-	//Create the VBOs from the data.
-	if (fmod(static_cast<float>(n_vertices), 3.0f) < 0.000001f) {
-
-		std::vector<float> vertex_attrib_data = MakeInterleavedVBO(vertex_data, normal_data);
-
-		vertices.reset(new GLUtils::VBO(vertex_attrib_data.data(), vertex_attrib_data.size()*sizeof(float)));
-		
-	}
-	else
-		THROW_EXCEPTION("The number of vertices in the mesh is wrong");
-}
-
-Model::~Model() {
-
-}
-
-void Model::loadRecursive(MeshPart& part, bool invert,
-			std::vector<float>& vertex_data, std::vector<float>& normal_data, const aiScene* scene, const aiNode* node) {
-	//update transform matrix. notice that we also transpose it
-	aiMatrix4x4 m = node->mTransformation;
-	for (int j=0; j<4; ++j)
-		for (int i=0; i<4; ++i)
-			part.transform[j][i] = m[i][j];
-
-	// draw all meshes assigned to this node
-	for (unsigned int n=0; n < node->mNumMeshes; ++n) {
-		const struct aiMesh* mesh = scene->mMeshes[node->mMeshes[n]];
-
-		//apply_material(scene->mMaterials[mesh->mMaterialIndex]); // I'll leave this line up, in case I want to continue working on this project in the future
-
-		part.first = vertex_data.size()/3; // I DON'T THINK THIS IS NEEDED, WHY DID MARTIN PUT THIS HERE?
-		part.count = mesh->mNumFaces*3; // Since we are only dealing with triangles, number_of_faces * 3 = number_of_vertices
-
-		//Allocate data
-		vertex_data.reserve(vertex_data.size() + part.count*3);
-		normal_data.reserve(normal_data.size() + part.count * 3);
-
-		//Add the vertices from file   (FOR EVERY PRIMITIVE, THAT IS A TRIANGLE)
-		for (unsigned int t = 0; t < mesh->mNumFaces; ++t) {
-			const struct aiFace* face = &mesh->mFaces[t];
-
-			if(face->mNumIndices != 3)
-				THROW_EXCEPTION("Only triangle meshes are supported");
-
-			// FOR EVERY VERTEX THAT DEFINES THE PRIMITIVE TRIANGLE
-			for(unsigned int i = 0; i < face->mNumIndices; i++) {
-				int index = face->mIndices[i];
-				vertex_data.push_back(mesh->mVertices[index].x);
-				vertex_data.push_back(mesh->mVertices[index].y);
-				vertex_data.push_back(mesh->mVertices[index].z);
-				normal_data.push_back(mesh->mNormals[index].x);
-				normal_data.push_back(mesh->mNormals[index].y);
-				normal_data.push_back(mesh->mNormals[index].z);
-
-			}
-		}
-	}
-
-	// load all children
-	for (unsigned int n = 0; n < node->mNumChildren; ++n) {
-		part.children.push_back(MeshPart());
-		loadRecursive(part.children.back(), invert, vertex_data, normal_data, scene, node->mChildren[n]);
-	}
-
-}
-
-// We want to scale our model to an appropriate size
-glm::vec3 Model::FindScaleVector()
-{
-	glm::vec3 difference = glm::abs(min_dim - max_dim);
-
-	float biggest_diff;
-
-	if (difference.x > difference.y)
-	{
-		biggest_diff = difference.x;
-	}
-	else
-	{
-		biggest_diff = difference.y;
-	}
-
-	if (difference.z > biggest_diff)
-	{
-		biggest_diff = difference.z;
-	}
-
-	glm::vec3 scale_vec3(1.0f / biggest_diff);
-
-	return scale_vec3;
-}
-
-// We want to translate the model to the center of our window
-glm::vec3 Model::FindTranslateVector()
-{
-	float translate_x = max_dim.x + min_dim.x;
-	float translate_y = max_dim.y + min_dim.y;
-	float translate_z = max_dim.z + min_dim.z;
-
-	glm::vec3 translate_vec3(translate_x, translate_y, translate_z);
-
-	translate_vec3 /= 2.0f;
-	translate_vec3 *= -1.0f;
-
-	return translate_vec3;
-}
-
-// We want to create an interleaved VBO. To do that, we'll need a block of memory that contains the interleaved vertex attributes
-std::vector<float> Model::MakeInterleavedVBO(std::vector<float> vertex_data, std::vector<float> normal_data)
-{
-	std::vector<float> vertex_attrib_data; // The final container where the interleaved VBO will be stored
-
-	for (unsigned int offset = 0; offset < n_vertices; offset += 3)
-	{
-		vertex_attrib_data.push_back(vertex_data[offset]);
-		vertex_attrib_data.push_back(vertex_data[offset + 1]);
-		vertex_attrib_data.push_back(vertex_data[offset + 2]);
-		vertex_attrib_data.push_back(normal_data[offset]);
-		vertex_attrib_data.push_back(normal_data[offset + 1]);
-		vertex_attrib_data.push_back(normal_data[offset + 2]);
-	}
-
-	return vertex_attrib_data;
-}
-
-
-void Model::MakeBoudingBox(std::vector<float> vertex_data)
-{
-	// Finding the Axis-aligned bounding box
-	for (unsigned int offset = 0; offset < n_vertices; offset += 3)
-	{
-		if (vertex_data[offset] > max_dim.x)
-		{
-			max_dim.x = vertex_data[offset];
-		}
-		else if (vertex_data[offset + 1] > max_dim.y)
-		{
-			max_dim.y = vertex_data[offset + 1];
-		}
-		else if (vertex_data[offset + 2] > max_dim.z)
-		{
-			max_dim.z = vertex_data[offset + 2];
-		}
-		else if (vertex_data[offset] < min_dim.x)
-		{
-			min_dim.x = vertex_data[offset];
-		}
-		else if (vertex_data[offset + 1] < min_dim.y)
-		{
-			min_dim.y = vertex_data[offset + 1];
-		}
-		else if (vertex_data[offset + 2] < min_dim.z)
-		{
-			min_dim.z = vertex_data[offset + 2];
-		}
-	}
-}
\ No newline at end of file
+#include "Model.h"
+
+#include "GameException.h"
+#include "ImportStepTimer.h"
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "ObjReader.h"
+#include "ThreadPool.h"
+
+#include "Timer.h"
+
+#include <algorithm>
+#include <iostream>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <glm/gtc/matrix_transform.hpp>
+
+#ifdef _WIN32
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace {
+	const unsigned int empty_slot = std::numeric_limits<unsigned int>::max();
+
+	// FNV-1a over the raw bytes of an interleaved vertex (position and normal)
+	inline size_t hashVertex(const float* vertex) {
+		const unsigned char* bytes = reinterpret_cast<const unsigned char*>(vertex);
+		size_t hash = 2166136261u;
+		for (unsigned int i = 0; i < 6 * sizeof(float); ++i) {
+			hash ^= bytes[i];
+			hash *= 16777619u;
+		}
+		return hash;
+	}
+
+	// Welds count vertices, where vertex(i, out) writes the position and normal of
+	// vertex i to out[0..5], so vertices with the same position and normal are only
+	// stored once. store(v) returns where welded vertex v goes (and is read back
+	// from). The hash table only holds indices of welded vertices, so we never keep
+	// a second copy of them. Writes the welded index of every vertex to remap, grows
+	// the bounding box min_dim..max_dim, and returns the number of welded vertices.
+	template <typename VertexFunction, typename StoreFunction>
+	unsigned int weldVertices(size_t count, VertexFunction vertex_function, StoreFunction store, unsigned int* remap,
+			glm::vec3& min_dim, glm::vec3& max_dim) {
+		min_dim = glm::vec3(std::numeric_limits<float>::max());
+		max_dim = glm::vec3(-std::numeric_limits<float>::max());
+
+		size_t table_size = 1;
+		while (table_size < count * 2)
+			table_size <<= 1;
+		std::vector<unsigned int> table(table_size, empty_slot);
+
+		unsigned int n_welded = 0;
+		for (size_t v = 0; v < count; ++v) {
+			float vertex[6];
+			vertex_function(v, vertex);
+
+			size_t slot = hashVertex(vertex) & (table_size - 1);
+			while (table[slot] != empty_slot && memcmp(store(table[slot]), vertex, sizeof(vertex)) != 0)
+				slot = (slot + 1) & (table_size - 1);
+
+			if (table[slot] == empty_slot) {
+				// A new vertex: write the record and grow the bounding box in the same pass
+				memcpy(store(n_welded), vertex, sizeof(vertex));
+				min_dim = glm::min(min_dim, glm::vec3(vertex[0], vertex[1], vertex[2]));
+				max_dim = glm::max(max_dim, glm::vec3(vertex[0], vertex[1], vertex[2]));
+				table[slot] = n_welded++;
+			}
+			remap[v] = table[slot];
+		}
+		return n_welded;
+	}
+
+	// Peak resident set size of the process in bytes
+	size_t getPeakRSS() {
+#ifdef _WIN32
+		PROCESS_MEMORY_COUNTERS counters;
+		if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+			return counters.PeakWorkingSetSize;
+		return 0;
+#else
+		struct rusage usage;
+		if (getrusage(RUSAGE_SELF, &usage) != 0)
+			return 0;
+#ifdef __APPLE__
+		return static_cast<size_t>(usage.ru_maxrss);
+#else
+		return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+	}
+}
+
+Model::Model(std::string filename, bool invert, const LoadOptions& options) {
+	createBuffers(prepare(filename, invert, options));
+	upload(std::numeric_limits<size_t>::max());
+}
+
+Model::Model(std::shared_ptr<PreparedModel> prepared) {
+	createBuffers(prepared);
+}
+
+Model::~Model() {
+
+}
+
+std::shared_ptr<PreparedModel> Model::prepare(std::string filename, bool invert, const LoadOptions& options) {
+	TIMED_SCOPE("Model::prepare");
+	Timer prepare_timer;
+	std::shared_ptr<PreparedModel> prepared(new PreparedModel());
+	prepared->filename = filename;
+
+	std::string cache_filename = getCacheFilename(filename);
+
+	if (MeshCache::isUpToDate(cache_filename, filename)) {
+		// The cache is already in the layout OpenGL wants, so the mapped
+		// file is handed directly to the buffer objects
+		std::shared_ptr<MeshCache> cache(new MeshCache(cache_filename));
+		// A cache built with other levels of detail, optimization, reader or
+		// (for models read by assimp) import profile is imported again
+		bool obj_reader = options.obj_reader && ObjReader::isObjFile(filename);
+		if (cache->getHierarchy().getNumLevels() == std::max(1u, options.lod_levels)
+				&& cache->isOptimized() == options.optimize
+				&& cache->isObjReader() == obj_reader
+				&& (obj_reader || cache->getImportProfile() == options.import_profile)) {
+			prepared->hierarchy = cache->getHierarchy();
+			prepared->min_dim = cache->getMinDim();
+			prepared->max_dim = cache->getMaxDim();
+			prepared->n_vertices = cache->getNumVertices();
+			prepared->n_indices = cache->getNumIndices();
+			prepared->n_soup_vertices = cache->getNumSoupVertices();
+			prepared->index_type = cache->getIndexType();
+			prepared->vertex_data = cache->getVertices();
+			prepared->vertex_bytes = cache->getVertexBytes();
+			prepared->index_data = cache->getIndices();
+			prepared->index_bytes = cache->getIndexBytes();
+			prepared->cache = cache;
+			if (options.quantize)
+				quantizeVertices(*prepared);
+
+			std::cout << "Using mesh cache " << cache_filename << std::endl;
+			prepared->prepare_time = prepare_timer.elapsed();
+			return prepared;
+		}
+		std::cout << "Mesh cache " << cache_filename << " was built with other load options, importing again" << std::endl;
+	}
+
+	MeshData& data = prepared->data;
+	import(filename, invert, data, options);
+
+	try {
+		TIMED_SCOPE("MeshCache::write");
+		MeshCache::write(cache_filename, filename, data);
+	}
+	catch (GameException&) {
+		std::cout << "Could not write mesh cache " << cache_filename << ", continuing without it" << std::endl;
+	}
+
+	prepared->hierarchy = data.hierarchy;
+	prepared->min_dim = data.min_dim;
+	prepared->max_dim = data.max_dim;
+	prepared->n_vertices = static_cast<unsigned int>(data.vertices.size() / 6);
+	prepared->n_indices = static_cast<unsigned int>(data.indices.size());
+	prepared->n_soup_vertices = data.n_soup_vertices;
+	prepared->index_type = getIndexType(prepared->n_vertices);
+	prepared->vertex_data = data.vertices.data();
+	prepared->vertex_bytes = data.vertices.size() * sizeof(float);
+
+	if (prepared->index_type == GL_UNSIGNED_SHORT) {
+		prepared->short_indices.resize(data.indices.size());
+		for (size_t i = 0; i < data.indices.size(); ++i)
+			prepared->short_indices[i] = static_cast<unsigned short>(data.indices[i]);
+		std::vector<unsigned int>().swap(data.indices);
+
+		prepared->index_data = prepared->short_indices.data();
+		prepared->index_bytes = prepared->short_indices.size() * sizeof(unsigned short);
+	}
+	else {
+		prepared->index_data = data.indices.data();
+		prepared->index_bytes = data.indices.size() * sizeof(unsigned int);
+	}
+
+	if (options.quantize)
+		quantizeVertices(*prepared);
+
+	prepared->prepare_time = prepare_timer.elapsed();
+	return prepared;
+}
+
+void Model::quantizeVertices(PreparedModel& prepared) {
+	TIMED_SCOPE("Model::quantizeVertices");
+	prepared.quantized_vertices.resize(prepared.n_vertices);
+	VertexQuantizer::quantize(static_cast<const float*>(prepared.vertex_data), prepared.n_vertices, prepared.min_dim, prepared.max_dim,
+		prepared.quantized_vertices.data(), prepared.quantization_error);
+	prepared.hierarchy.setVertexTransform(VertexQuantizer::getDequantizationTransform(prepared.min_dim, prepared.max_dim));
+
+	prepared.vertex_data = prepared.quantized_vertices.data();
+	prepared.vertex_bytes = prepared.quantized_vertices.size() * sizeof(VertexQuantizer::QuantizedVertex);
+	prepared.quantized = true;
+
+	// Only the quantized vertices are uploaded (a mapped cache stays mapped for the indices)
+	std::vector<float>().swap(prepared.data.vertices);
+}
+
+void Model::createBuffers(std::shared_ptr<PreparedModel> prepared) {
+	this->prepared = prepared;
+	hierarchy = prepared->hierarchy;
+	min_dim = prepared->min_dim;
+	max_dim = prepared->max_dim;
+	n_vertices = prepared->n_vertices;
+	quantized = prepared->quantized;
+
+	// Allocate the buffers, they are filled by upload()
+	vertices.reset(new GLUtils::VBO(NULL, static_cast<unsigned int>(prepared->vertex_bytes)));
+	indices.reset(new GLUtils::IBO(NULL, static_cast<unsigned int>(prepared->index_bytes), prepared->index_type));
+	uploaded_vertex_bytes = 0;
+	uploaded_index_bytes = 0;
+	n_uploaded_indices = 0;
+}
+
+bool Model::upload(size_t max_bytes) {
+	TIMED_SCOPE("Model::upload");
+	if (!prepared)
+		return true;
+
+	// All the vertices go first, since any index can refer to any vertex
+	if (uploaded_vertex_bytes < prepared->vertex_bytes) {
+		size_t bytes = std::min(max_bytes, prepared->vertex_bytes - uploaded_vertex_bytes);
+		vertices->update(static_cast<const char*>(prepared->vertex_data) + uploaded_vertex_bytes,
+				static_cast<unsigned int>(uploaded_vertex_bytes), static_cast<unsigned int>(bytes));
+		uploaded_vertex_bytes += bytes;
+		max_bytes -= bytes;
+	}
+
+	if (uploaded_vertex_bytes == prepared->vertex_bytes && uploaded_index_bytes < prepared->index_bytes && max_bytes > 0) {
+		// Only upload whole triangles, so the uploaded indices can be drawn
+		size_t triangle_bytes = 3 * indices->indexSize();
+		size_t bytes = std::min(max_bytes, prepared->index_bytes - uploaded_index_bytes);
+		bytes = std::max(triangle_bytes, bytes - bytes % triangle_bytes);
+		bytes = std::min(bytes, prepared->index_bytes - uploaded_index_bytes);
+
+		indices->update(static_cast<const char*>(prepared->index_data) + uploaded_index_bytes,
+				static_cast<unsigned int>(uploaded_index_bytes), static_cast<unsigned int>(bytes));
+		uploaded_index_bytes += bytes;
+		n_uploaded_indices = static_cast<unsigned int>(uploaded_index_bytes / indices->indexSize());
+	}
+
+	if (uploaded_vertex_bytes < prepared->vertex_bytes || uploaded_index_bytes < prepared->index_bytes)
+		return false;
+
+	PrintStats(prepared->filename, prepared->n_soup_vertices, prepared->n_indices, prepared->prepare_time);
+
+	// Let go of the CPU side copy (or the mapping of the mesh cache)
+	prepared.reset();
+	return true;
+}
+
+void Model::bake(std::string filename, bool invert, const LoadOptions& options) {
+	MeshData data;
+	import(filename, invert, data, options);
+
+	std::string cache_filename = getCacheFilename(filename);
+	MeshCache::write(cache_filename, filename, data);
+
+	std::cout << "Baked " << filename << " into " << cache_filename << " ("
+		<< data.vertices.size() / 6 << " vertices, " << data.indices.size() / 3 << " triangles)" << std::endl;
+}
+
+std::string Model::getCacheFilename(const std::string& filename) {
+	return filename + ".meshcache";
+}
+
+GLenum Model::getIndexType(unsigned int n_vertices) {
+	return (n_vertices <= 65536) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
+
+// One mesh referenced by a node. Jobs are listed in the order of a depth first
+// walk over the nodes, which is also the order their data ends up in the buffers.
+struct Model::MeshJob {
+	const aiMesh* mesh; //< NULL for meshes read by ObjReader
+	unsigned int node; //< Node in the hierarchy that draws the mesh
+	size_t first_index; //< Where the indices of the mesh go in the index buffer
+	size_t n_indices;
+	size_t first_vertex; //< Where the vertices go: first the worst case range, and after compacting the final one
+	unsigned int n_vertices; //< Vertices left after welding
+	glm::vec3 min_dim;
+	glm::vec3 max_dim;
+	std::vector<std::vector<unsigned int> > levels; //< Indices of the coarser levels of detail, from level 1
+	std::vector<float> level_errors;
+	float acmr_before; //< Average cache miss ratio of the full level, before and after optimizeMesh
+	float acmr_after;
+};
+
+void Model::import(const std::string& filename, bool invert, MeshData& data, const LoadOptions& options) {
+	TIMED_SCOPE("Model::import");
+	if (options.obj_reader && ObjReader::isObjFile(filename)) {
+		ThreadPool pool(options.threads);
+		std::shared_ptr<ObjReader> reader;
+		try {
+			TIMED_SCOPE("ObjReader");
+			reader.reset(new ObjReader(filename, pool));
+		}
+		catch (GameException&) {
+			std::cout << "Could not read " << filename << " as OBJ, trying assimp instead" << std::endl;
+		}
+		if (reader) {
+			data.obj_reader = true;
+			convertObj(*reader, data, options, pool);
+			return;
+		}
+	}
+
+	std::shared_ptr<ImportStepTimer> step_timer;
+	if (options.import_timing)
+		step_timer.reset(new ImportStepTimer());
+	const aiScene* scene = ImportProfile::importFile(filename, options.import_profile);
+	if (step_timer) {
+		step_timer->finish();
+		step_timer->print();
+		step_timer.reset();
+	}
+	if (!scene) {
+		std::string log = "Unable to load mesh from ";
+		log.append(filename);
+		THROW_EXCEPTION(log);
+	}
+
+	data.import_profile = options.import_profile;
+	try {
+		convertScene(scene, invert, data, options);
+	}
+	catch (...) {
+		aiReleaseImport(scene);
+		throw;
+	}
+	aiReleaseImport(scene);
+}
+
+void Model::convertScene(const aiScene* scene, bool invert, MeshData& data, const LoadOptions& options) {
+	// Flatten the node tree, and find where every mesh goes in the buffers
+	std::vector<MeshJob> jobs;
+	size_t n_indices = 0, max_vertices = 0;
+	data.hierarchy.clear();
+	data.hierarchy.setNumLevels(std::max(1u, options.lod_levels));
+	loadRecursive(data.hierarchy, -1, invert, jobs, n_indices, max_vertices, data.n_soup_vertices, scene, scene->mRootNode);
+
+	// Allocate the buffers once, for the worst case of no duplicate vertices.
+	// Every mesh writes straight into its own range of them.
+	data.vertices.resize(max_vertices * 6);
+	data.indices.resize(n_indices);
+
+	ThreadPool pool(options.threads);
+	pool.parallelFor(jobs.size(), [&](size_t i) {
+		weldMesh(jobs[i], data);
+	});
+
+	finishMeshes(jobs, data, options, pool);
+}
+
+void Model::convertObj(const ObjReader& reader, MeshData& data, const LoadOptions& options, ThreadPool& pool) {
+	// A root node, with one child node and mesh per group, like assimp does
+	data.hierarchy.clear();
+	data.hierarchy.setNumLevels(std::max(1u, options.lod_levels));
+	data.hierarchy.addNode(-1, glm::mat4(), 0, 0);
+
+	std::vector<MeshJob> jobs(reader.getNumGroups());
+	size_t n_indices = reader.getNumTriangles() * 3;
+	if (n_indices > std::numeric_limits<unsigned int>::max())
+		THROW_EXCEPTION("The mesh has too many indices");
+	for (size_t i = 0; i < jobs.size(); ++i) {
+		const ObjReader::Group& group = reader.getGroup(i);
+		MeshJob& job = jobs[i];
+		job.mesh = NULL;
+		job.first_index = group.first_triangle * 3;
+		job.n_indices = group.n_triangles * 3;
+		job.n_vertices = 0;
+		job.acmr_before = 0.0f;
+		job.acmr_after = 0.0f;
+		job.node = data.hierarchy.addNode(0, glm::mat4(), static_cast<unsigned int>(job.first_index), static_cast<unsigned int>(job.n_indices));
+	}
+	data.n_soup_vertices = static_cast<unsigned int>(n_indices);
+	data.indices.resize(n_indices);
+
+	// The worst case of every corner being its own vertex is far more than
+	// an OBJ file needs, so every group is welded into a buffer of its own
+	// first, and then copied to its final place
+	std::vector<std::vector<float> > welded(jobs.size());
+	pool.parallelFor(jobs.size(), [&](size_t i) {
+		MeshJob& job = jobs[i];
+		job.n_vertices = weldVertices(job.n_indices, [&](size_t corner, float* vertex) {
+			reader.getVertex(job.first_index + corner, vertex);
+		}, [&](size_t v) {
+			if (welded[i].size() < (v + 1) * 6)
+				welded[i].resize((v + 1) * 6);
+			return &welded[i][v * 6];
+		}, &data.indices[job.first_index], job.min_dim, job.max_dim);
+	});
+
+	size_t n_vertices = 0;
+	for (size_t i = 0; i < jobs.size(); ++i) {
+		jobs[i].first_vertex = n_vertices;
+		n_vertices += jobs[i].n_vertices;
+	}
+	data.vertices.resize(n_vertices * 6);
+	pool.parallelFor(jobs.size(), [&](size_t i) {
+		std::copy(welded[i].begin(), welded[i].end(), data.vertices.begin() + jobs[i].first_vertex * 6);
+		std::vector<float>().swap(welded[i]);
+	});
+
+	finishMeshes(jobs, data, options, pool);
+}
+
+void Model::finishMeshes(std::vector<MeshJob>& jobs, MeshData& data, const LoadOptions& options, ThreadPool& pool) {
+	TIMED_SCOPE("Model::finishMeshes");
+	// Close the gaps the duplicates left, so the vertices of each mesh directly
+	// follow the previous mesh. This has to go front to back, since a range can
+	// be moved over the worst case range of an earlier mesh.
+	size_t n_vertices = 0;
+	data.min_dim = glm::vec3(std::numeric_limits<float>::max());
+	data.max_dim = glm::vec3(-std::numeric_limits<float>::max());
+	for (size_t i = 0; i < jobs.size(); ++i) {
+		if (jobs[i].first_vertex != n_vertices && jobs[i].n_vertices > 0)
+			memmove(&data.vertices[n_vertices * 6], &data.vertices[jobs[i].first_vertex * 6], jobs[i].n_vertices * 6 * sizeof(float));
+		jobs[i].first_vertex = n_vertices;
+		n_vertices += jobs[i].n_vertices;
+
+		data.min_dim = glm::min(data.min_dim, jobs[i].min_dim);
+		data.max_dim = glm::max(data.max_dim, jobs[i].max_dim);
+
+		// The bounding box of a node is the one around all of its meshes
+		unsigned int node = jobs[i].node;
+		if (jobs[i].n_vertices > 0) {
+			data.hierarchy.setBounds(node, glm::min(data.hierarchy.getBoundsMin(node), jobs[i].min_dim),
+				glm::max(data.hierarchy.getBoundsMax(node), jobs[i].max_dim));
+		}
+	}
+
+	if (n_vertices > std::numeric_limits<unsigned int>::max())
+		THROW_EXCEPTION("The mesh has too many vertices for 32-bit indices");
+
+	// Optimize and simplify every mesh while its indices are still relative
+	// to its own first vertex, then make them absolute. The coarser levels
+	// share the vertices, so the vertex order has to be final before them.
+	unsigned int n_levels = data.hierarchy.getNumLevels();
+	pool.parallelFor(jobs.size(), [&](size_t i) {
+		if (options.optimize)
+			optimizeMesh(jobs[i], data);
+		simplifyMesh(jobs[i], data, n_levels, options.optimize);
+
+		unsigned int first_vertex = static_cast<unsigned int>(jobs[i].first_vertex);
+		size_t end = jobs[i].first_index + jobs[i].n_indices;
+		for (size_t j = jobs[i].first_index; j < end; ++j)
+			data.indices[j] += first_vertex;
+	});
+
+	// Drop the room we reserved for the duplicates. This does not reallocate.
+	data.vertices.resize(n_vertices * 6);
+
+	addLevels(jobs, data);
+
+	data.optimized = options.optimize;
+	if (options.optimize)
+		PrintOptimizationStats(jobs);
+
+	glm::mat4 root_transform = data.hierarchy.getLocalTransform(0);
+	root_transform = glm::scale(root_transform, FindScaleVector(data.min_dim, data.max_dim));
+	root_transform = glm::translate(root_transform, FindTranslateVector(data.min_dim, data.max_dim));
+	data.hierarchy.setLocalTransform(0, root_transform);
+}
+
+void Model::loadRecursive(MeshHierarchy& hierarchy, int parent, bool invert, std::vector<MeshJob>& jobs, size_t& n_indices, size_t& max_vertices,
+			unsigned int& n_soup_vertices, const aiScene* scene, const aiNode* node) {
+	//update transform matrix. notice that we also transpose it
+	glm::mat4 transform;
+	aiMatrix4x4 m = node->mTransformation;
+	for (int j=0; j<4; ++j)
+		for (int i=0; i<4; ++i)
+			transform[j][i] = m[i][j];
+
+	// The meshes of a node are stored after each other, so they can be drawn as one range of indices
+	unsigned int first = static_cast<unsigned int>(n_indices);
+	unsigned int count = 0;
+	size_t first_job = jobs.size();
+
+	// draw all meshes assigned to this node
+	for (unsigned int n=0; n < node->mNumMeshes; ++n) {
+		const struct aiMesh* mesh = scene->mMeshes[node->mMeshes[n]];
+
+		//apply_material(scene->mMaterials[mesh->mMaterialIndex]); // I'll leave this line up, in case I want to continue working on this project in the future
+
+		count += mesh->mNumFaces*3; // Since we are only dealing with triangles, number_of_faces * 3 = number_of_indices
+		n_soup_vertices += mesh->mNumFaces*3;
+
+		MeshJob job;
+		job.mesh = mesh;
+		job.first_index = n_indices;
+		job.n_indices = mesh->mNumFaces*3;
+		job.first_vertex = max_vertices;
+		job.n_vertices = 0;
+		job.acmr_before = 0.0f;
+		job.acmr_after = 0.0f;
+		jobs.push_back(job);
+
+		n_indices += mesh->mNumFaces*3;
+		max_vertices += mesh->mNumVertices;
+	}
+
+	if (n_indices > std::numeric_limits<unsigned int>::max())
+		THROW_EXCEPTION("The mesh has too many indices");
+
+	int index = static_cast<int>(hierarchy.addNode(parent, transform, first, count));
+	for (size_t j = first_job; j < jobs.size(); ++j)
+		jobs[j].node = static_cast<unsigned int>(index);
+
+	// load all children, they follow their parent in the hierarchy
+	for (unsigned int n = 0; n < node->mNumChildren; ++n)
+		loadRecursive(hierarchy, index, invert, jobs, n_indices, max_vertices, n_soup_vertices, scene, node->mChildren[n]);
+
+}
+
+void Model::weldMesh(MeshJob& job, MeshData& data) {
+	TIMED_SCOPE("Model::weldMesh");
+	const aiMesh* mesh = job.mesh;
+	float* vertices = &data.vertices[job.first_vertex * 6];
+
+	// Find the index in our vertex buffer of every vertex in the mesh
+	std::vector<unsigned int> remap(mesh->mNumVertices);
+	job.n_vertices = weldVertices(mesh->mNumVertices, [&](size_t v, float* vertex) {
+		vertex[0] = mesh->mVertices[v].x; vertex[1] = mesh->mVertices[v].y; vertex[2] = mesh->mVertices[v].z;
+		vertex[3] = mesh->mNormals[v].x; vertex[4] = mesh->mNormals[v].y; vertex[5] = mesh->mNormals[v].z;
+	}, [&](size_t v) {
+		return &vertices[v * 6];
+	}, remap.data(), job.min_dim, job.max_dim);
+
+	//Add the indices from file   (FOR EVERY PRIMITIVE, THAT IS A TRIANGLE)
+	unsigned int* indices = &data.indices[job.first_index];
+	for (unsigned int t = 0; t < mesh->mNumFaces; ++t) {
+		const struct aiFace* face = &mesh->mFaces[t];
+
+		if(face->mNumIndices != 3)
+			THROW_EXCEPTION("Only triangle meshes are supported");
+
+		for(unsigned int i = 0; i < face->mNumIndices; i++)
+			*indices++ = remap[face->mIndices[i]];
+	}
+}
+
+void Model::optimizeMesh(MeshJob& job, MeshData& data) {
+	TIMED_SCOPE("Model::optimizeMesh");
+	unsigned int* indices = &data.indices[job.first_index];
+	size_t n_indices = job.n_indices;
+	float* vertices = &data.vertices[job.first_vertex * 6];
+
+	job.acmr_before = MeshOptimizer::getACMR(indices, n_indices, job.n_vertices);
+	MeshOptimizer::optimizeVertexCache(indices, n_indices, job.n_vertices);
+	MeshOptimizer::optimizeOverdraw(indices, n_indices, vertices, 6, job.n_vertices);
+	MeshOptimizer::optimizeVertexFetch(indices, n_indices, vertices, 6, job.n_vertices);
+	job.acmr_after = MeshOptimizer::getACMR(indices, n_indices, job.n_vertices);
+}
+
+void Model::simplifyMesh(MeshJob& job, const MeshData& data, unsigned int n_levels, bool optimize) {
+	TIMED_SCOPE("Model::simplifyMesh");
+	if (n_levels < 2 || job.n_vertices == 0)
+		return;
+
+	// Every level starts from the one before, so the errors only grow
+	size_t n_indices = job.n_indices;
+	MeshSimplifier simplifier(&data.vertices[job.first_vertex * 6], 6, job.n_vertices, &data.indices[job.first_index], n_indices);
+	job.levels.resize(n_levels - 1);
+	job.level_errors.resize(n_levels - 1);
+	for (unsigned int level = 1; level < n_levels; ++level) {
+		size_t target = (n_indices >> level) / 3 * 3;
+		simplifier.simplify(target);
+		job.levels[level - 1] = simplifier.getIndices();
+		job.level_errors[level - 1] = simplifier.getError();
+		if (optimize) {
+			std::vector<unsigned int>& indices = job.levels[level - 1];
+			MeshOptimizer::optimizeVertexCache(indices.data(), indices.size(), job.n_vertices);
+		}
+	}
+}
+
+void Model::addLevels(std::vector<MeshJob>& jobs, MeshData& data) {
+	TIMED_SCOPE("Model::addLevels");
+	MeshHierarchy& hierarchy = data.hierarchy;
+	unsigned int n_levels = hierarchy.getNumLevels();
+	if (n_levels < 2)
+		return;
+
+	size_t n_indices = data.indices.size();
+	for (size_t i = 0; i < jobs.size(); ++i)
+		for (size_t j = 0; j < jobs[i].levels.size(); ++j)
+			n_indices += jobs[i].levels[j].size();
+	if (n_indices > std::numeric_limits<unsigned int>::max())
+		THROW_EXCEPTION("The mesh has too many indices for its levels of detail");
+	data.indices.reserve(n_indices);
+
+	// All parts of a level follow each other, so the meshes of a node are
+	// one range of indices at every level, like at the full level
+	for (unsigned int level = 1; level < n_levels; ++level) {
+		for (size_t i = 0; i < jobs.size(); ) {
+			unsigned int node = jobs[i].node;
+			size_t end = i;
+			bool simplified = false;
+			for (; end < jobs.size() && jobs[end].node == node; ++end) {
+				if (jobs[end].levels.empty())
+					continue;
+				size_t previous = (level > 1) ? jobs[end].levels[level - 2].size() : jobs[end].n_indices;
+				simplified = simplified || (jobs[end].levels[level - 1].size() < previous);
+			}
+
+			// Meshes that could not be simplified any further reuse the level before
+			if (!simplified) {
+				hierarchy.setLevel(node, level, hierarchy.getFirst(node, level - 1), hierarchy.getCount(node, level - 1),
+					hierarchy.getError(node, level - 1));
+				i = end;
+				continue;
+			}
+
+			unsigned int first = static_cast<unsigned int>(data.indices.size());
+			float error = 0.0f;
+			for (; i < end; ++i) {
+				if (jobs[i].levels.empty())
+					continue;
+				const std::vector<unsigned int>& indices = jobs[i].levels[level - 1];
+				unsigned int first_vertex = static_cast<unsigned int>(jobs[i].first_vertex);
+				for (size_t j = 0; j < indices.size(); ++j)
+					data.indices.push_back(indices[j] + first_vertex);
+				error = std::max(error, jobs[i].level_errors[level - 1]);
+			}
+			hierarchy.setLevel(node, level, first, static_cast<unsigned int>(data.indices.size()) - first, error);
+		}
+	}
+
+	for (size_t i = 0; i < jobs.size(); ++i) {
+		std::vector<std::vector<unsigned int> >().swap(jobs[i].levels);
+	}
+}
+
+// We want to scale our model to an appropriate size
+glm::vec3 Model::FindScaleVector(const glm::vec3& min_dim, const glm::vec3& max_dim)
+{
+	glm::vec3 difference = glm::abs(min_dim - max_dim);
+
+	float biggest_diff;
+
+	if (difference.x > difference.y)
+	{
+		biggest_diff = difference.x;
+	}
+	else
+	{
+		biggest_diff = difference.y;
+	}
+
+	if (difference.z > biggest_diff)
+	{
+		biggest_diff = difference.z;
+	}
+
+	glm::vec3 scale_vec3(1.0f / biggest_diff);
+
+	return scale_vec3;
+}
+
+// We want to translate the model to the center of our window
+glm::vec3 Model::FindTranslateVector(const glm::vec3& min_dim, const glm::vec3& max_dim)
+{
+	float translate_x = max_dim.x + min_dim.x;
+	float translate_y = max_dim.y + min_dim.y;
+	float translate_z = max_dim.z + min_dim.z;
+
+	glm::vec3 translate_vec3(translate_x, translate_y, translate_z);
+
+	translate_vec3 /= 2.0f;
+	translate_vec3 *= -1.0f;
+
+	return translate_vec3;
+}
+
+void Model::PrintStats(const std::string& filename, unsigned int n_soup_vertices, unsigned int n_indices, double load_time)
+{
+	const unsigned int vertex_size = getVertexSize();
+	unsigned int n_unique_vertices = n_vertices;
+
+	size_t soup_bytes = static_cast<size_t>(n_soup_vertices) * 6 * sizeof(float);
+	size_t vertex_bytes = static_cast<size_t>(n_unique_vertices) * vertex_size;
+	size_t index_bytes = static_cast<size_t>(n_indices) * indices->indexSize();
+
+	std::cout << "Loaded " << filename << std::endl;
+	std::cout << "  triangle soup: " << n_soup_vertices << " vertices, " << soup_bytes << " bytes" << std::endl;
+	if (quantized) {
+		const VertexQuantizer::Error& error = prepared->quantization_error;
+		float size = std::max(glm::length(max_dim - min_dim), std::numeric_limits<float>::min());
+		std::cout << "  quantized vertices: " << vertex_size << " instead of " << 6 * sizeof(float) << " bytes each, saving "
+			<< static_cast<size_t>(n_vertices) * (6 * sizeof(float) - vertex_size) << " bytes" << std::endl;
+		std::cout << "  quantization error: position " << error.position << " (" << 100.0f * error.position / size
+			<< "% of the model size), normal " << error.normal_degrees << " degrees" << std::endl;
+	}
+	std::cout << "  indexed:       " << n_unique_vertices << " vertices, " << vertex_bytes << " bytes + "
+		<< n_indices << " " << (indices->indexSize() * 8) << "-bit indices, " << index_bytes << " bytes" << std::endl;
+	if (soup_bytes > 0)
+		std::cout << "  saved " << 100.0 * (1.0 - (vertex_bytes + index_bytes) / static_cast<double>(soup_bytes)) << "% of the buffer memory" << std::endl;
+	std::cout << "  load time: " << load_time * 1000.0 << " ms, peak RSS: "
+		<< getPeakRSS() / (1024.0 * 1024.0) << " MB" << std::endl;
+	PrintLevelStats();
+}
+
+void Model::PrintOptimizationStats(const std::vector<MeshJob>& jobs)
+{
+	const size_t max_listed = 10;
+
+	// The largest meshes first, they matter most
+	std::vector<size_t> order;
+	double total_before = 0.0, total_after = 0.0;
+	size_t n_triangles = 0;
+	for (size_t i = 0; i < jobs.size(); ++i) {
+		size_t triangles = jobs[i].n_indices / 3;
+		if (triangles == 0)
+			continue;
+		order.push_back(i);
+		total_before += jobs[i].acmr_before * triangles;
+		total_after += jobs[i].acmr_after * triangles;
+		n_triangles += triangles;
+	}
+	if (n_triangles == 0)
+		return;
+	std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+		return jobs[a].n_indices > jobs[b].n_indices;
+	});
+
+	std::cout << "Average cache miss ratio (" << MeshOptimizer::fifo_cache_size << " vertex FIFO), before -> after optimizing:" << std::endl;
+	for (size_t i = 0; i < std::min(order.size(), max_listed); ++i) {
+		const MeshJob& job = jobs[order[i]];
+		std::cout << "  mesh " << order[i] << ": " << job.n_indices / 3 << " triangles, "
+			<< job.acmr_before << " -> " << job.acmr_after << std::endl;
+	}
+	if (order.size() > max_listed)
+		std::cout << "  (" << order.size() - max_listed << " smaller meshes not listed)" << std::endl;
+	std::cout << "  all " << order.size() << " meshes: " << total_before / n_triangles << " -> " << total_after / n_triangles << std::endl;
+}
+
+void Model::PrintLevelStats()
+{
+	if (hierarchy.getNumLevels() < 2)
+		return;
+
+	size_t full_triangles = 0;
+	for (unsigned int level = 0; level < hierarchy.getNumLevels(); ++level) {
+		size_t n_triangles = 0;
+		float error = 0.0f;
+		for (unsigned int i = 0; i < hierarchy.size(); ++i) {
+			n_triangles += hierarchy.getCount(i, level) / 3;
+			error = std::max(error, hierarchy.getError(i, level));
+		}
+		if (level == 0)
+			full_triangles = n_triangles;
+
+		std::cout << "  level " << level << ": " << n_triangles << " triangles";
+		if (full_triangles > 0)
+			std::cout << " (" << 100.0 * n_triangles / full_triangles << "%)";
+		std::cout << ", max error " << error << std::endl;
+	}
+}
@@ -0,0 +1,389 @@
+#include "ObjReader.h"
+
+#include "GameException.h"
+#include "MappedFile.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdint.h>
+
+namespace {
+	const size_t min_chunk_bytes = 1 << 20; //< Smaller chunks are not worth a thread
+	const unsigned int chunks_per_thread = 8; //< More chunks than threads, to balance uneven lines
+
+	inline bool isSpace(char c) {
+		return c == ' ' || c == '\t' || c == '\r';
+	}
+
+	inline const char* skipSpace(const char* p, const char* end) {
+		while (p < end && isSpace(*p))
+			++p;
+		return p;
+	}
+
+	inline const char* skipToken(const char* p, const char* end) {
+		while (p < end && !isSpace(*p) && *p != '\n')
+			++p;
+		return p;
+	}
+
+	inline const char* nextLine(const char* p, const char* end) {
+		const char* newline = static_cast<const char*>(memchr(p, '\n', end - p));
+		return newline ? newline + 1 : end;
+	}
+
+	// True if the line starting at p is the keyword followed by white space
+	inline bool isKeyword(const char* p, const char* end, const char* keyword, size_t length) {
+		return static_cast<size_t>(end - p) > length && memcmp(p, keyword, length) == 0
+			&& (isSpace(p[length]) || p[length] == '\n');
+	}
+
+	inline bool isDigit(char c) {
+		return c >= '0' && c <= '9';
+	}
+
+	// Parses an integer with an optional sign at p, and returns the end of
+	// it, or NULL if there are no digits. The mapped file is not null
+	// terminated, so strtol cannot be used. Values too large for any index
+	// are clamped, to be rejected as out of range.
+	inline const char* parseInt(const char* p, const char* end, long long& value) {
+		bool negative = (p < end && *p == '-');
+		if (p < end && (*p == '-' || *p == '+'))
+			++p;
+		const char* digits = p;
+		long long result = 0;
+		for (; p < end && isDigit(*p); ++p) {
+			if (result < (1LL << 40))
+				result = result * 10 + (*p - '0');
+		}
+		if (p == digits)
+			return NULL;
+		value = negative ? -result : result;
+		return p;
+	}
+
+	// Parses a decimal floating point number after white space: an optional
+	// sign, digits with an optional point, and an optional exponent. Returns
+	// the end of it, or NULL if it is not a number or out of the range of
+	// float. The digits are summed exactly as long as a double holds them,
+	// which covers the precision OBJ files are written with, and scaled by
+	// an exact power of ten.
+	inline const char* parseFloat(const char* p, const char* end, float& value) {
+		static const double powers_of_ten[] = {
+			1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+			1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+		};
+		const uint64_t max_mantissa = 1ULL << 53; //< Integers a double holds exactly
+
+		p = skipSpace(p, end);
+		bool negative = (p < end && *p == '-');
+		if (p < end && (*p == '-' || *p == '+'))
+			++p;
+
+		uint64_t mantissa = 0;
+		int exponent = 0;
+		bool has_digits = false;
+		for (; p < end && isDigit(*p); ++p) {
+			if (mantissa < max_mantissa / 10)
+				mantissa = mantissa * 10 + (*p - '0');
+			else
+				++exponent;
+			has_digits = true;
+		}
+		if (p < end && *p == '.') {
+			for (++p; p < end && isDigit(*p); ++p) {
+				if (mantissa < max_mantissa / 10) {
+					mantissa = mantissa * 10 + (*p - '0');
+					--exponent;
+				}
+				has_digits = true;
+			}
+		}
+		if (!has_digits)
+			return NULL;
+
+		// Without digits after it, the e is not part of the number
+		if (p < end && (*p == 'e' || *p == 'E')) {
+			const char* e = p + 1;
+			bool negative_exponent = (e < end && *e == '-');
+			if (e < end && (*e == '-' || *e == '+'))
+				++e;
+			if (e < end && isDigit(*e)) {
+				int digits_exponent = 0;
+				for (; e < end && isDigit(*e); ++e) {
+					if (digits_exponent < 10000)
+						digits_exponent = digits_exponent * 10 + (*e - '0');
+				}
+				exponent += negative_exponent ? -digits_exponent : digits_exponent;
+				p = e;
+			}
+		}
+
+		double result = static_cast<double>(mantissa);
+		if (mantissa != 0) {
+			for (; exponent > 22; exponent -= 22)
+				result *= powers_of_ten[22];
+			for (; exponent < -22; exponent += 22)
+				result /= powers_of_ten[22];
+			result = (exponent >= 0) ? result * powers_of_ten[exponent] : result / powers_of_ten[-exponent];
+			if (!(result <= FLT_MAX))
+				return NULL;
+		}
+		value = static_cast<float>(negative ? -result : result);
+		return p;
+	}
+
+	// Turns a one based (or negative, relative) OBJ index into a zero based
+	// one. n_seen is the number of elements defined before the line.
+	inline bool resolveIndex(long long index, size_t n_seen, size_t n_total, unsigned int& result) {
+		long long resolved = (index > 0) ? index - 1 : static_cast<long long>(n_seen) + index;
+		if (index == 0 || resolved < 0 || static_cast<size_t>(resolved) >= n_total)
+			return false;
+		result = static_cast<unsigned int>(resolved);
+		return true;
+	}
+}
+
+/**
+ * A range of whole lines, with what it holds and where that goes
+ */
+struct ObjReader::Chunk {
+	const char* begin;
+	const char* end;
+
+	size_t n_positions;
+	size_t n_normals;
+	size_t n_triangles;
+	std::vector<std::pair<std::string, size_t> > group_starts; //< Name, and the first triangle after it in the chunk
+
+	size_t first_position;
+	size_t first_normal;
+	size_t first_triangle;
+	bool missing_normals; //< Some corner in the chunk has no vn index
+};
+
+ObjReader::ObjReader(const std::string& filename, ThreadPool& pool) : filename(filename) {
+	MappedFile file(filename);
+	const char* data = reinterpret_cast<const char*>(file.data());
+	const char* data_end = data + file.size();
+
+	// Split the file at line ends
+	size_t n_chunks = std::max<size_t>(1, std::min<size_t>(file.size() / min_chunk_bytes,
+		static_cast<size_t>(pool.getNumThreads()) * chunks_per_thread));
+	std::vector<Chunk> chunks;
+	const char* p = data;
+	for (size_t i = 0; i < n_chunks && p < data_end; ++i) {
+		Chunk chunk = Chunk();
+		chunk.begin = p;
+		chunk.end = (i + 1 == n_chunks) ? data_end : nextLine(std::min(data_end, p + file.size() / n_chunks), data_end);
+		chunks.push_back(chunk);
+		p = chunk.end;
+	}
+
+	pool.parallelFor(chunks.size(), [&](size_t i) {
+		countChunk(chunks[i]);
+	});
+
+	// Every chunk writes after the ones before it
+	size_t n_positions = 0, n_normals = 0, n_triangles = 0;
+	groups.push_back(Group());
+	groups.back().first_triangle = 0;
+	for (size_t i = 0; i < chunks.size(); ++i) {
+		chunks[i].first_position = n_positions;
+		chunks[i].first_normal = n_normals;
+		chunks[i].first_triangle = n_triangles;
+		for (size_t j = 0; j < chunks[i].group_starts.size(); ++j) {
+			Group group;
+			group.name = chunks[i].group_starts[j].first;
+			group.first_triangle = n_triangles + chunks[i].group_starts[j].second;
+			groups.push_back(group);
+		}
+		n_positions += chunks[i].n_positions;
+		n_normals += chunks[i].n_normals;
+		n_triangles += chunks[i].n_triangles;
+	}
+	if (n_positions > std::numeric_limits<unsigned int>::max() || n_normals > std::numeric_limits<unsigned int>::max())
+		THROW_EXCEPTION("Too many vertices in " + filename);
+
+	// Drop the groups without triangles (like the one before the first o or g)
+	size_t n_groups = 0;
+	for (size_t i = 0; i < groups.size(); ++i) {
+		size_t end = (i + 1 < groups.size()) ? groups[i + 1].first_triangle : n_triangles;
+		groups[i].n_triangles = end - groups[i].first_triangle;
+		if (groups[i].n_triangles > 0)
+			groups[n_groups++] = groups[i];
+	}
+	groups.resize(n_groups);
+
+	n_file_positions = n_positions;
+	n_file_normals = n_normals;
+	positions.resize(n_positions * 3);
+	normals.resize(n_normals * 3);
+	corner_positions.resize(n_triangles * 3);
+	corner_normals.resize(n_triangles * 3);
+
+	pool.parallelFor(chunks.size(), [&](size_t i) {
+		parseChunk(chunks[i]);
+	});
+
+	for (size_t i = 0; i < chunks.size(); ++i) {
+		if (chunks[i].missing_normals) {
+			generateSmoothNormals(pool);
+			break;
+		}
+	}
+}
+
+bool ObjReader::isObjFile(const std::string& filename) {
+	if (filename.size() < 4)
+		return false;
+	std::string extension = filename.substr(filename.size() - 4);
+	std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+	return extension == ".obj";
+}
+
+void ObjReader::countChunk(Chunk& chunk) const {
+	chunk.n_positions = 0;
+	chunk.n_normals = 0;
+	chunk.n_triangles = 0;
+
+	for (const char* p = chunk.begin; p < chunk.end; ) {
+		p = skipSpace(p, chunk.end);
+		if (isKeyword(p, chunk.end, "v", 1)) {
+			++chunk.n_positions;
+		}
+		else if (isKeyword(p, chunk.end, "vn", 2)) {
+			++chunk.n_normals;
+		}
+		else if (isKeyword(p, chunk.end, "f", 1)) {
+			// A polygon of n corners is n-2 triangles
+			unsigned int n_corners = 0;
+			p = skipSpace(p + 1, chunk.end);
+			while (p < chunk.end && *p != '\n') {
+				p = skipSpace(skipToken(p, chunk.end), chunk.end);
+				++n_corners;
+			}
+			if (n_corners >= 3)
+				chunk.n_triangles += n_corners - 2;
+		}
+		else if (isKeyword(p, chunk.end, "o", 1) || isKeyword(p, chunk.end, "g", 1)) {
+			const char* name = skipSpace(p + 1, chunk.end);
+			const char* name_end = name;
+			while (name_end < chunk.end && *name_end != '\n')
+				++name_end;
+			while (name_end > name && isSpace(name_end[-1]))
+				--name_end;
+			chunk.group_starts.push_back(std::make_pair(std::string(name, name_end), chunk.n_triangles));
+		}
+		p = nextLine(p, chunk.end);
+	}
+}
+
+void ObjReader::parseChunk(Chunk& chunk) {
+	size_t n_positions = chunk.first_position;
+	size_t n_normals = chunk.first_normal;
+	size_t corner = chunk.first_triangle * 3;
+	chunk.missing_normals = false;
+
+	std::vector<unsigned int> face_positions, face_normals;
+	for (const char* p = chunk.begin; p < chunk.end; ) {
+		p = skipSpace(p, chunk.end);
+		const char* line = p;
+		bool ok = true;
+
+		if (isKeyword(p, chunk.end, "v", 1) || isKeyword(p, chunk.end, "vn", 2)) {
+			bool normal = (p[1] == 'n');
+			float* target = normal ? &normals[n_normals++ * 3] : &positions[n_positions++ * 3];
+			p += normal ? 2 : 1;
+			for (int k = 0; k < 3 && ok; ++k) {
+				p = parseFloat(p, chunk.end, target[k]);
+				ok = (p != NULL);
+			}
+		}
+		else if (isKeyword(p, chunk.end, "f", 1)) {
+			// Corners are p, p/t, p//n or p/t/n
+			face_positions.clear();
+			face_normals.clear();
+			p = skipSpace(p + 1, chunk.end);
+			while (ok && p < chunk.end && *p != '\n') {
+				long long index = 0;
+				const char* next = parseInt(p, chunk.end, index);
+				unsigned int position = 0, normal = no_normal;
+				ok = (next != NULL) && resolveIndex(index, n_positions, n_file_positions, position);
+				p = ok ? next : p;
+				if (ok && p < chunk.end && *p == '/') {
+					// The texture coordinate is not used, and may be left out
+					next = parseInt(p + 1, chunk.end, index);
+					p = next ? next : p + 1;
+					if (p < chunk.end && *p == '/') {
+						next = parseInt(p + 1, chunk.end, index);
+						ok = (next != NULL) && resolveIndex(index, n_normals, n_file_normals, normal);
+						p = ok ? next : p;
+					}
+				}
+				ok = ok && (p == chunk.end || isSpace(*p) || *p == '\n');
+				face_positions.push_back(position);
+				face_normals.push_back(normal);
+				p = skipSpace(p, chunk.end);
+			}
+
+			for (size_t i = 2; ok && i < face_positions.size(); ++i) {
+				size_t fan[3] = {0, i - 1, i};
+				for (int k = 0; k < 3; ++k) {
+					corner_positions[corner] = face_positions[fan[k]];
+					corner_normals[corner] = face_normals[fan[k]];
+					chunk.missing_normals = chunk.missing_normals || (face_normals[fan[k]] == no_normal);
+					++corner;
+				}
+			}
+		}
+
+		if (!ok) {
+			const char* line_end = line;
+			while (line_end < chunk.end && *line_end != '\n' && line_end - line < 80)
+				++line_end;
+			THROW_EXCEPTION("Could not parse \"" + std::string(line, line_end) + "\" in " + filename);
+		}
+		p = nextLine(p, chunk.end);
+	}
+}
+
+void ObjReader::generateSmoothNormals(ThreadPool& pool) {
+	// Sum the (area weighted) normals of the triangles around every position.
+	// Triangles of different threads can share positions, so this is serial.
+	size_t n_positions = positions.size() / 3;
+	smooth_normals.assign(n_positions * 3, 0.0f);
+	for (size_t corner = 0; corner < corner_positions.size(); corner += 3) {
+		const float* a = &positions[static_cast<size_t>(corner_positions[corner]) * 3];
+		const float* b = &positions[static_cast<size_t>(corner_positions[corner + 1]) * 3];
+		const float* c = &positions[static_cast<size_t>(corner_positions[corner + 2]) * 3];
+		float e1[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+		float e2[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+		float n[3] = {e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0]};
+		for (int k = 0; k < 3; ++k) {
+			float* target = &smooth_normals[static_cast<size_t>(corner_positions[corner + k]) * 3];
+			target[0] += n[0];
+			target[1] += n[1];
+			target[2] += n[2];
+		}
+	}
+
+	const size_t block = 1 << 16;
+	pool.parallelFor((n_positions + block - 1) / block, [&](size_t i) {
+		size_t end = std::min(n_positions, (i + 1) * block);
+		for (size_t v = i * block; v < end; ++v) {
+			float* n = &smooth_normals[v * 3];
+			float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+			if (length > 0.0f) {
+				n[0] /= length;
+				n[1] /= length;
+				n[2] /= length;
+			}
+		}
+	});
+}
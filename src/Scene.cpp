@@ -0,0 +1,123 @@
+#include "Scene.h"
+
+#include "GameException.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <sstream>
+
+namespace {
+	const float instance_radius = 0.8660254f; //< Half the diagonal of the unit cube the models are fit into
+	const unsigned int max_grid_side = 4096; //< Guards against typos turning into millions of instances
+}
+
+Scene::Scene(const std::string& filename) : n_instances(0), radius(0.0f) {
+	std::ifstream file(filename.c_str());
+	if (!file.good())
+		THROW_EXCEPTION("Could not open " + filename);
+
+	size_t separator = filename.find_last_of("/\\");
+	directory = (separator != std::string::npos) ? filename.substr(0, separator + 1) : "";
+
+	float infinity = std::numeric_limits<float>::infinity();
+	min_dim = glm::vec3(infinity);
+	max_dim = glm::vec3(-infinity);
+
+	std::string line;
+	for (unsigned int line_number = 1; std::getline(file, line); ++line_number) {
+		size_t comment = line.find('#');
+		if (comment != std::string::npos)
+			line.erase(comment);
+
+		std::istringstream statement(line);
+		std::string keyword, model;
+		if (!(statement >> keyword))
+			continue;
+
+		std::stringstream where;
+		where << filename << ":" << line_number;
+		if (!(statement >> model))
+			THROW_EXCEPTION("No model in \"" + line + "\" at " + where.str());
+
+		bool valid = false;
+		if (keyword == "instance") {
+			glm::vec3 position;
+			float yaw = 0.0f, scale = 1.0f;
+			if (statement >> position.x >> position.y >> position.z) {
+				valid = true;
+				if (statement >> yaw)
+					valid = !!(statement >> scale) || statement.eof();
+				if (valid)
+					addInstance(getAsset(model), position, yaw, scale);
+			}
+		}
+		else if (keyword == "grid") {
+			unsigned int nx, nz;
+			float spacing, scale = 1.0f;
+			if (statement >> nx >> nz >> spacing && nx <= max_grid_side && nz <= max_grid_side) {
+				valid = !!(statement >> scale) || statement.eof();
+				if (valid && nx > 0 && nz > 0) {
+					unsigned int asset = getAsset(model);
+					for (unsigned int z = 0; z < nz; ++z) {
+						for (unsigned int x = 0; x < nx; ++x) {
+							glm::vec3 position((x - 0.5f * (nx - 1)) * spacing, 0.0f, (z - 0.5f * (nz - 1)) * spacing);
+							addInstance(asset, position, 0.0f, scale);
+						}
+					}
+				}
+			}
+		}
+		if (!valid || !(statement >> std::ws).eof())
+			THROW_EXCEPTION("Could not parse \"" + line + "\" at " + where.str());
+	}
+
+	if (n_instances == 0)
+		THROW_EXCEPTION("No instances in " + filename);
+
+	center = 0.5f * (min_dim + max_dim);
+	radius = 0.5f * glm::length(max_dim - min_dim);
+}
+
+bool Scene::isSceneFile(const std::string& filename) {
+	if (filename.size() < 6)
+		return false;
+	std::string extension = filename.substr(filename.size() - 6);
+	std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+	return extension == ".scene";
+}
+
+unsigned int Scene::getAsset(const std::string& filename) {
+	bool absolute = (filename[0] == '/' || filename[0] == '\\' || filename.find(':') != std::string::npos);
+	std::string path = absolute ? filename : directory + filename;
+
+	std::map<std::string, unsigned int>::const_iterator found = asset_indices.find(path);
+	if (found != asset_indices.end())
+		return found->second;
+
+	unsigned int asset = static_cast<unsigned int>(assets.size());
+	assets.push_back(Asset());
+	assets.back().filename = path;
+	asset_indices[path] = asset;
+	return asset;
+}
+
+void Scene::addInstance(unsigned int asset, const glm::vec3& position, float yaw, float scale) {
+	//Turned around the y axis and scaled, then moved into place
+	float angle = yaw * 3.14159265f / 180.0f;
+	float c = std::cos(angle) * scale;
+	float s = std::sin(angle) * scale;
+	glm::mat4 transform(1.0f);
+	transform[0] = glm::vec4(c, 0.0f, -s, 0.0f);
+	transform[1] = glm::vec4(0.0f, scale, 0.0f, 0.0f);
+	transform[2] = glm::vec4(s, 0.0f, c, 0.0f);
+	transform[3] = glm::vec4(position, 1.0f);
+	assets[asset].instances.push_back(transform);
+	++n_instances;
+
+	glm::vec3 extent(instance_radius * std::abs(scale));
+	min_dim = glm::min(min_dim, position - extent);
+	max_dim = glm::max(max_dim, position + extent);
+}
@@ -0,0 +1,386 @@
+#include "SoftwareRenderer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdint.h>
+
+namespace {
+	const size_t min_job_triangles = 4096; //< Smaller jobs are not worth handing to a thread
+	const unsigned int jobs_per_thread = 4;
+	const int subpixel_scale = 1 << SoftwareRenderer::subpixel_bits;
+	const float max_screen_coordinate = 1 << 20; //< Triangles beyond this (in pixels) would overflow the edge functions
+
+	// What test.vert and test.frag use for the light and the material
+	const glm::vec3 light_position(200.0f, 200.0f, 200.0f);
+	const float diffuse_color[3] = {0.5f, 0.5f, 1.0f};
+
+	// A signed, normalized 10-bit component of GL_INT_2_10_10_10_REV
+	inline float unpackNormalComponent(uint32_t packed, int shift) {
+		int value = static_cast<int>((packed >> shift) & 0x3ff);
+		if (value >= 512)
+			value -= 1024;
+		return std::max(value / 511.0f, -1.0f);
+	}
+
+	inline unsigned char toUnorm8(float value) {
+		return static_cast<unsigned char>(std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f);
+	}
+
+	inline float dot(const float* a, const float* b) {
+		return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+	}
+
+	/**
+	 * What test.frag does, for the interpolated v, l and normal_smooth
+	 */
+	inline void shade(const float* varyings, unsigned char* color) {
+		const float* v = varyings;
+		const float* l = varyings + 3;
+		const float* n_smooth = varyings + 6;
+		float n_scale = 1.0f / std::sqrt(dot(n_smooth, n_smooth));
+		float n[3] = {n_smooth[0] * n_scale, n_smooth[1] * n_scale, n_smooth[2] * n_scale};
+		float h[3] = {v[0] + l[0], v[1] + l[1], v[2] + l[2]};
+		float h_scale = 1.0f / std::sqrt(dot(h, h));
+
+		float diffuse = std::max(0.1f, dot(n, l));
+		float specular = std::max(0.0f, dot(n, h) * h_scale);
+		for (int j = 0; j < 7; ++j) // To the power of 128
+			specular *= specular;
+
+		for (int j = 0; j < 3; ++j)
+			color[j] = toUnorm8(diffuse * diffuse_color[j] + specular);
+	}
+}
+
+/**
+ * A vertex after the vertex shader: clip space position, and what is
+ * interpolated over the triangle (the v, l and normal_smooth varyings)
+ */
+struct SoftwareRenderer::Vertex {
+	glm::vec4 position;
+	float attributes[9];
+};
+
+/**
+ * A triangle ready to rasterize, with its vertices in window space.
+ * The vertices are ordered so the area is positive.
+ */
+struct SoftwareRenderer::Triangle {
+	int64_t x[3]; //< Fixed point, with subpixel_bits fraction bits, y pointing down
+	int64_t y[3];
+	int64_t area; //< Twice the area, in fixed point squared
+	// Interpolated values at the first corner, and how much more they are
+	// at the other two, so a pixel with barycentrics b1 and b2 (of the
+	// second and third corner) gets value[0] + b1 * value[1] + b2 * value[2]
+	float z[3]; //< Depth, 0 to 1
+	float inv_w[3];
+	float attributes[3][9]; //< Divided by w, for perspective correct interpolation
+	int min_x, min_y, max_x, max_y; //< Pixel bounds, clamped to the screen
+};
+
+/**
+ * A range of triangles set up by one thread, with the triangles that
+ * touch every tile
+ */
+struct SoftwareRenderer::Job {
+	size_t first_triangle;
+	size_t end_triangle;
+	std::vector<Triangle> triangles;
+	std::vector<std::vector<unsigned int> > bins; //< Per tile, indices into triangles
+};
+
+SoftwareRenderer::SoftwareRenderer(unsigned int width, unsigned int height, unsigned int n_threads)
+		: width(width), height(height), pool(n_threads), n_jobs(0) {
+	tiles_x = (width + tile_size - 1) / tile_size;
+	tiles_y = (height + tile_size - 1) / tile_size;
+	color_buffer.resize(static_cast<size_t>(width) * height * 3);
+	depth_buffer.resize(static_cast<size_t>(width) * height);
+}
+
+SoftwareRenderer::~SoftwareRenderer() {
+}
+
+void SoftwareRenderer::clear(const glm::vec3& color) {
+	unsigned char rgb[3] = {toUnorm8(color[0]), toUnorm8(color[1]), toUnorm8(color[2])};
+	for (size_t i = 0; i < color_buffer.size(); i += 3) {
+		color_buffer[i] = rgb[0];
+		color_buffer[i + 1] = rgb[1];
+		color_buffer[i + 2] = rgb[2];
+	}
+	std::fill(depth_buffer.begin(), depth_buffer.end(), 1.0f);
+}
+
+size_t SoftwareRenderer::draw(const PreparedModel& model, const DrawBatch& batch, const TransformKernel::DrawTransform* transforms,
+		const glm::mat4& projection_matrix) {
+	// Number the triangles of all draws, and split them into jobs
+	const std::vector<GLsizei>& counts = batch.getCounts();
+	draw_starts.resize(counts.size() + 1);
+	draw_starts[0] = 0;
+	for (size_t i = 0; i < counts.size(); ++i)
+		draw_starts[i + 1] = draw_starts[i] + counts[i] / 3;
+	size_t n_triangles = draw_starts.back();
+	if (n_triangles == 0)
+		return 0;
+
+	n_jobs = std::min<size_t>((n_triangles + min_job_triangles - 1) / min_job_triangles,
+		static_cast<size_t>(pool.getNumThreads()) * jobs_per_thread);
+	n_jobs = std::max<size_t>(n_jobs, 1);
+	if (jobs.size() < n_jobs)
+		jobs.resize(n_jobs);
+	for (size_t i = 0; i < n_jobs; ++i) {
+		jobs[i].first_triangle = n_triangles * i / n_jobs;
+		jobs[i].end_triangle = n_triangles * (i + 1) / n_jobs;
+	}
+
+	pool.parallelFor(n_jobs, [&](size_t i) {
+		setupJob(jobs[i], model, batch, transforms, projection_matrix);
+	});
+	pool.parallelFor(tiles_x * tiles_y, [&](size_t tile) {
+		rasterizeTile(static_cast<unsigned int>(tile));
+	});
+
+	size_t n_drawn = 0;
+	for (size_t i = 0; i < n_jobs; ++i)
+		n_drawn += jobs[i].triangles.size();
+	return n_drawn;
+}
+
+void SoftwareRenderer::readPixels(std::vector<unsigned char>& pixels) const {
+	pixels = color_buffer;
+}
+
+void SoftwareRenderer::setupJob(Job& job, const PreparedModel& model, const DrawBatch& batch,
+		const TransformKernel::DrawTransform* transforms, const glm::mat4& projection_matrix) {
+	job.triangles.clear();
+	job.bins.resize(tiles_x * tiles_y);
+	for (size_t i = 0; i < job.bins.size(); ++i)
+		job.bins[i].clear();
+
+	const std::vector<const GLvoid*>& offsets = batch.getOffsets();
+	size_t index_size = (model.index_type == GL_UNSIGNED_SHORT) ? 2 : 4;
+
+	// The draw the first triangle of the job is in
+	size_t draw = std::upper_bound(draw_starts.begin(), draw_starts.end(), job.first_triangle) - draw_starts.begin() - 1;
+
+	for (size_t t = job.first_triangle; t < job.end_triangle; ++t) {
+		while (t >= draw_starts[draw + 1])
+			++draw;
+
+		const TransformKernel::DrawTransform& transform = transforms[draw];
+		size_t first_index = reinterpret_cast<size_t>(offsets[draw]) / index_size + (t - draw_starts[draw]) * 3;
+
+		// The vertex shader, for the three corners
+		Vertex corners[3];
+		for (int k = 0; k < 3; ++k) {
+			size_t index = (model.index_type == GL_UNSIGNED_SHORT)
+				? static_cast<const unsigned short*>(model.index_data)[first_index + k]
+				: static_cast<const unsigned int*>(model.index_data)[first_index + k];
+
+			glm::vec3 position, normal;
+			if (model.quantized) {
+				const VertexQuantizer::QuantizedVertex& vertex = static_cast<const VertexQuantizer::QuantizedVertex*>(model.vertex_data)[index];
+				position = glm::vec3(vertex.position[0], vertex.position[1], vertex.position[2]);
+				normal = glm::vec3(unpackNormalComponent(vertex.normal, 0), unpackNormalComponent(vertex.normal, 10),
+					unpackNormalComponent(vertex.normal, 20));
+			}
+			else {
+				const float* vertex = static_cast<const float*>(model.vertex_data) + index * 6;
+				position = glm::vec3(vertex[0], vertex[1], vertex[2]);
+				normal = glm::vec3(vertex[3], vertex[4], vertex[5]);
+			}
+
+			glm::vec4 view_position = transform.modelview_matrix * glm::vec4(position, 1.0f);
+			glm::vec3 v = glm::normalize(-glm::vec3(view_position));
+			glm::vec3 l = glm::normalize(light_position - glm::vec3(view_position));
+			glm::vec3 n = glm::vec3(transform.normal_matrix[0]) * normal.x + glm::vec3(transform.normal_matrix[1]) * normal.y
+				+ glm::vec3(transform.normal_matrix[2]) * normal.z;
+
+			corners[k].position = projection_matrix * view_position;
+			for (int j = 0; j < 3; ++j) {
+				corners[k].attributes[j] = v[j];
+				corners[k].attributes[3 + j] = l[j];
+				corners[k].attributes[6 + j] = n[j];
+			}
+		}
+
+		// Triangles entirely outside one of the planes of the view volume
+		bool outside = false;
+		for (int axis = 0; axis < 3 && !outside; ++axis) {
+			outside = (corners[0].position[axis] > corners[0].position.w && corners[1].position[axis] > corners[1].position.w
+					&& corners[2].position[axis] > corners[2].position.w)
+				|| (corners[0].position[axis] < -corners[0].position.w && corners[1].position[axis] < -corners[1].position.w
+					&& corners[2].position[axis] < -corners[2].position.w);
+		}
+		if (outside)
+			continue;
+
+		// Clip against the near plane (z >= -w). The other planes are handled
+		// by clamping to the screen while rasterizing, and the depth test.
+		float distances[3];
+		bool clipped = false;
+		for (int k = 0; k < 3; ++k) {
+			distances[k] = corners[k].position.z + corners[k].position.w;
+			clipped = clipped || (distances[k] < 0.0f);
+		}
+		if (!clipped) {
+			setupTriangle(job, corners[0], corners[1], corners[2]);
+			continue;
+		}
+
+		Vertex polygon[4];
+		int n_polygon = 0;
+		for (int k = 0; k < 3; ++k) {
+			const Vertex& a = corners[k];
+			const Vertex& b = corners[(k + 1) % 3];
+			float da = distances[k], db = distances[(k + 1) % 3];
+			if (da >= 0.0f)
+				polygon[n_polygon++] = a;
+			if ((da >= 0.0f) != (db >= 0.0f)) {
+				float s = da / (da - db);
+				Vertex& c = polygon[n_polygon++];
+				c.position = a.position + (b.position - a.position) * s;
+				for (int j = 0; j < 9; ++j)
+					c.attributes[j] = a.attributes[j] + (b.attributes[j] - a.attributes[j]) * s;
+			}
+		}
+		for (int k = 2; k < n_polygon; ++k)
+			setupTriangle(job, polygon[0], polygon[k - 1], polygon[k]);
+	}
+}
+
+void SoftwareRenderer::setupTriangle(Job& job, const Vertex& a, const Vertex& b, const Vertex& c) {
+	const Vertex* corners[3] = {&a, &b, &c};
+	Triangle triangle;
+
+	// Perspective divide and viewport transform, with y pointing down
+	float screen_x[3], screen_y[3];
+	for (int k = 0; k < 3; ++k) {
+		const glm::vec4& position = corners[k]->position;
+		if (position.w <= 0.0f)
+			return;
+		float inv_w = 1.0f / position.w;
+		screen_x[k] = (position.x * inv_w + 1.0f) * 0.5f * width;
+		screen_y[k] = (1.0f - position.y * inv_w) * 0.5f * height;
+		if (std::fabs(screen_x[k]) > max_screen_coordinate || std::fabs(screen_y[k]) > max_screen_coordinate)
+			return;
+
+		triangle.x[k] = static_cast<int64_t>(std::floor(screen_x[k] * subpixel_scale + 0.5f));
+		triangle.y[k] = static_cast<int64_t>(std::floor(screen_y[k] * subpixel_scale + 0.5f));
+		triangle.z[k] = (position.z * inv_w + 1.0f) * 0.5f;
+		triangle.inv_w[k] = inv_w;
+		for (int j = 0; j < 9; ++j)
+			triangle.attributes[k][j] = corners[k]->attributes[j] * inv_w;
+	}
+
+	// Counter-clockwise is the front (glFrontFace(GL_CCW), y up), which is
+	// a negative area with y down. Back faces and empty triangles are culled.
+	int64_t area = (triangle.x[1] - triangle.x[0]) * (triangle.y[2] - triangle.y[0])
+		- (triangle.y[1] - triangle.y[0]) * (triangle.x[2] - triangle.x[0]);
+	if (area >= 0)
+		return;
+
+	// Swap two corners, so the area is positive
+	std::swap(triangle.x[1], triangle.x[2]);
+	std::swap(triangle.y[1], triangle.y[2]);
+	std::swap(triangle.z[1], triangle.z[2]);
+	std::swap(triangle.inv_w[1], triangle.inv_w[2]);
+	for (int j = 0; j < 9; ++j)
+		std::swap(triangle.attributes[1][j], triangle.attributes[2][j]);
+	triangle.area = -area;
+
+	for (int k = 1; k < 3; ++k) {
+		triangle.z[k] -= triangle.z[0];
+		triangle.inv_w[k] -= triangle.inv_w[0];
+		for (int j = 0; j < 9; ++j)
+			triangle.attributes[k][j] -= triangle.attributes[0][j];
+	}
+
+	// Pixels whose centers can be inside, clamped to the screen
+	float min_x = std::min(screen_x[0], std::min(screen_x[1], screen_x[2]));
+	float max_x = std::max(screen_x[0], std::max(screen_x[1], screen_x[2]));
+	float min_y = std::min(screen_y[0], std::min(screen_y[1], screen_y[2]));
+	float max_y = std::max(screen_y[0], std::max(screen_y[1], screen_y[2]));
+	triangle.min_x = std::max(0, static_cast<int>(std::floor(min_x - 0.5f)));
+	triangle.max_x = std::min(static_cast<int>(width) - 1, static_cast<int>(std::ceil(max_x - 0.5f)));
+	triangle.min_y = std::max(0, static_cast<int>(std::floor(min_y - 0.5f)));
+	triangle.max_y = std::min(static_cast<int>(height) - 1, static_cast<int>(std::ceil(max_y - 0.5f)));
+	if (triangle.min_x > triangle.max_x || triangle.min_y > triangle.max_y)
+		return;
+
+	unsigned int index = static_cast<unsigned int>(job.triangles.size());
+	job.triangles.push_back(triangle);
+	for (int tile_y = triangle.min_y / tile_size; tile_y <= triangle.max_y / static_cast<int>(tile_size); ++tile_y)
+		for (int tile_x = triangle.min_x / tile_size; tile_x <= triangle.max_x / static_cast<int>(tile_size); ++tile_x)
+			job.bins[tile_y * tiles_x + tile_x].push_back(index);
+}
+
+void SoftwareRenderer::rasterizeTile(unsigned int tile) {
+	int min_x = (tile % tiles_x) * tile_size;
+	int min_y = (tile / tiles_x) * tile_size;
+	int max_x = std::min(min_x + static_cast<int>(tile_size), static_cast<int>(width)) - 1;
+	int max_y = std::min(min_y + static_cast<int>(tile_size), static_cast<int>(height)) - 1;
+
+	for (size_t j = 0; j < n_jobs; ++j) {
+		const Job& job = jobs[j];
+		const std::vector<unsigned int>& bin = job.bins[tile];
+		for (size_t i = 0; i < bin.size(); ++i)
+			rasterizeTriangle(job.triangles[bin[i]], min_x, min_y, max_x, max_y);
+	}
+}
+
+void SoftwareRenderer::rasterizeTriangle(const Triangle& triangle, int min_x, int min_y, int max_x, int max_y) {
+	min_x = std::max(min_x, triangle.min_x);
+	min_y = std::max(min_y, triangle.min_y);
+	max_x = std::min(max_x, triangle.max_x);
+	max_y = std::min(max_y, triangle.max_y);
+	if (min_x > max_x || min_y > max_y)
+		return;
+
+	// Edge functions of the edges opposite each corner, at the center of
+	// the first pixel, and how they change from pixel to pixel. Pixels
+	// exactly on an edge belong to the triangle if the edge is a top or
+	// left one, so pixels on shared edges are drawn once.
+	int64_t start_x = static_cast<int64_t>(min_x) * subpixel_scale + subpixel_scale / 2;
+	int64_t start_y = static_cast<int64_t>(min_y) * subpixel_scale + subpixel_scale / 2;
+	int64_t row[3], step_x[3], step_y[3];
+	for (int k = 0; k < 3; ++k) {
+		int a = (k + 1) % 3, b = (k + 2) % 3;
+		int64_t dx = triangle.x[b] - triangle.x[a];
+		int64_t dy = triangle.y[b] - triangle.y[a];
+		bool top_left = (dy < 0) || (dy == 0 && dx > 0);
+		row[k] = dx * (start_y - triangle.y[a]) - dy * (start_x - triangle.x[a]) + (top_left ? 0 : -1);
+		step_x[k] = -dy * subpixel_scale;
+		step_y[k] = dx * subpixel_scale;
+	}
+
+	float inv_area = 1.0f / static_cast<float>(triangle.area);
+	for (int y = min_y; y <= max_y; ++y) {
+		int64_t edge[3] = {row[0], row[1], row[2]};
+		for (int x = min_x; x <= max_x; ++x) {
+			if ((edge[0] | edge[1] | edge[2]) >= 0) {
+				float b1 = static_cast<float>(edge[1]) * inv_area;
+				float b2 = static_cast<float>(edge[2]) * inv_area;
+
+				// Depth is linear on the screen
+				float z = triangle.z[0] + b1 * triangle.z[1] + b2 * triangle.z[2];
+				size_t pixel = static_cast<size_t>(y) * width + x;
+				if (z <= depth_buffer[pixel] && z >= 0.0f && z <= 1.0f) {
+					depth_buffer[pixel] = z;
+
+					// The fragment shader, with perspective correct varyings
+					float w = 1.0f / (triangle.inv_w[0] + b1 * triangle.inv_w[1] + b2 * triangle.inv_w[2]);
+					float varyings[9];
+					for (int j = 0; j < 9; ++j)
+						varyings[j] = (triangle.attributes[0][j] + b1 * triangle.attributes[1][j] + b2 * triangle.attributes[2][j]) * w;
+					shade(varyings, &color_buffer[pixel * 3]);
+				}
+			}
+			edge[0] += step_x[0];
+			edge[1] += step_x[1];
+			edge[2] += step_x[2];
+		}
+		row[0] += step_y[0];
+		row[1] += step_y[1];
+		row[2] += step_y[2];
+	}
+}
@@ -0,0 +1,99 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(unsigned int n_threads) : generation(0), busy_workers(0), stopping(false),
+		loop_function(NULL), loop_count(0), next_index(0) {
+	if (n_threads == 0)
+		n_threads = std::max(1u, std::thread::hardware_concurrency());
+	this->n_threads = n_threads;
+
+	for (unsigned int i = 1; i < n_threads; ++i)
+		workers.push_back(std::thread(&ThreadPool::workerLoop, this));
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	start_condition.notify_all();
+
+	for (unsigned int i = 0; i < workers.size(); ++i)
+		workers[i].join();
+}
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)>& function) {
+	if (count == 0)
+		return;
+
+	// Not worth waking anyone up for
+	if (workers.empty() || count == 1) {
+		for (size_t i = 0; i < count; ++i)
+			function(i);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		loop_function = &function;
+		loop_count = count;
+		next_index = 0;
+		loop_error = std::exception_ptr();
+		busy_workers = static_cast<unsigned int>(workers.size());
+		++generation;
+	}
+	start_condition.notify_all();
+
+	runIterations();
+
+	std::unique_lock<std::mutex> lock(mutex);
+	while (busy_workers > 0)
+		done_condition.wait(lock);
+	loop_function = NULL;
+
+	if (loop_error) {
+		std::exception_ptr error = loop_error;
+		loop_error = std::exception_ptr();
+		std::rethrow_exception(error);
+	}
+}
+
+void ThreadPool::workerLoop() {
+	unsigned long long seen_generation = 0;
+
+	for (;;) {
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			while (!stopping && generation == seen_generation)
+				start_condition.wait(lock);
+			if (stopping)
+				return;
+			seen_generation = generation;
+		}
+
+		runIterations();
+
+		std::lock_guard<std::mutex> lock(mutex);
+		if (--busy_workers == 0)
+			done_condition.notify_one();
+	}
+}
+
+void ThreadPool::runIterations() {
+	for (;;) {
+		size_t i = next_index.fetch_add(1);
+		if (i >= loop_count)
+			return;
+
+		try {
+			(*loop_function)(i);
+		}
+		catch (...) {
+			std::lock_guard<std::mutex> lock(mutex);
+			if (!loop_error)
+				loop_error = std::current_exception();
+			next_index = loop_count;
+		}
+	}
+}
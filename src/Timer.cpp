@@ -0,0 +1,75 @@
+#include "Timer.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include <thread>
+
+namespace {
+	// Head of the list of all accumulators. Accumulators are only added,
+	// from the first run of their TIMED_SCOPE, on any thread.
+	std::atomic<TimerAccumulator*>& getAccumulators() {
+		static std::atomic<TimerAccumulator*> accumulators(NULL);
+		return accumulators;
+	}
+}
+
+double Timer::getTickSeconds() {
+#ifdef TIMER_HAVE_TSC
+	// Count the ticks over a few milliseconds of the monotonic clock
+	static const double tick_seconds = []() {
+		uint64_t start_ns = getNanoseconds();
+		uint64_t start_ticks = getTicks();
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		uint64_t ns = getNanoseconds() - start_ns;
+		uint64_t ticks = getTicks() - start_ticks;
+		return (ticks > 0) ? ns * 1e-9 / ticks : 1e-9;
+	}();
+	return tick_seconds;
+#else
+	return 1e-9;
+#endif
+}
+
+TimerAccumulator::TimerAccumulator(const char* name) : name(name), total_ticks(0), count(0) {
+	std::atomic<TimerAccumulator*>& accumulators = getAccumulators();
+	next = accumulators.load();
+	while (!accumulators.compare_exchange_weak(next, this))
+		;
+}
+
+void TimerAccumulator::resetAll() {
+	for (TimerAccumulator* accumulator = getAccumulators().load(); accumulator != NULL; accumulator = accumulator->next) {
+		accumulator->total_ticks.store(0, std::memory_order_relaxed);
+		accumulator->count.store(0, std::memory_order_relaxed);
+	}
+}
+
+void TimerAccumulator::printAll() {
+	// Scopes with the same name add up
+	std::map<std::string, std::pair<double, uint64_t> > totals;
+	for (TimerAccumulator* accumulator = getAccumulators().load(); accumulator != NULL; accumulator = accumulator->next) {
+		if (accumulator->getCount() == 0)
+			continue;
+		std::pair<double, uint64_t>& total = totals[accumulator->getName()];
+		total.first += accumulator->getSeconds();
+		total.second += accumulator->getCount();
+	}
+	if (totals.empty())
+		return;
+
+	size_t name_width = 0;
+	for (std::map<std::string, std::pair<double, uint64_t> >::const_iterator i = totals.begin(); i != totals.end(); ++i)
+		name_width = std::max(name_width, i->first.size());
+
+	std::ios::fmtflags flags = std::cout.flags();
+	std::cout << "Timed scopes:" << std::endl << std::fixed << std::setprecision(3);
+	for (std::map<std::string, std::pair<double, uint64_t> >::const_iterator i = totals.begin(); i != totals.end(); ++i) {
+		std::cout << "  " << std::left << std::setw(name_width) << i->first << std::right
+			<< std::setw(12) << i->second.first * 1000.0 << " ms" << std::setw(10) << i->second.second << " calls"
+			<< std::setw(12) << i->second.first * 1e6 / i->second.second << " us per call" << std::endl;
+	}
+	std::cout.flags(flags);
+}
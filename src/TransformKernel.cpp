@@ -0,0 +1,213 @@
+#include "TransformKernel.h"
+
+#include "GameException.h"
+
+#include <glm/gtc/type_ptr.hpp>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__)
+#define TRANSFORM_KERNEL_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// GCC and Clang only emit AVX2 instructions in functions marked for it,
+// MSVC emits whatever intrinsics are used
+#if defined(__GNUC__) || defined(__clang__)
+#define TARGET_AVX2 __attribute__((target("avx2,fma")))
+#else
+#define TARGET_AVX2
+#endif
+
+namespace {
+	using TransformKernel::DrawTransform;
+
+	// The kernels treat DrawTransform as 28 consecutive floats
+	static_assert(sizeof(DrawTransform) == 28 * sizeof(float), "DrawTransform must be tightly packed");
+	static_assert(sizeof(glm::mat4) == 16 * sizeof(float), "glm::mat4 must be tightly packed");
+
+	/**
+	 * out = a * b for the first n_columns columns of column major 4x4 matrices
+	 */
+	inline void multiplyScalar(const float* a, const float* b, float* out, int n_columns) {
+		for (int j = 0; j < n_columns; ++j)
+			for (int r = 0; r < 4; ++r)
+				out[j*4 + r] = a[r]*b[j*4] + a[4 + r]*b[j*4 + 1] + a[8 + r]*b[j*4 + 2] + a[12 + r]*b[j*4 + 3];
+	}
+
+	inline size_t getNode(const unsigned int* nodes, size_t i) {
+		return (nodes != NULL) ? nodes[i] : i;
+	}
+
+	void transformPartsScalar(const float* view_model, const float* view_model_normal,
+			const float* world, const float* world_normal, const unsigned int* nodes, size_t count, float* out) {
+		for (size_t i = 0; i < count; ++i) {
+			size_t node = getNode(nodes, i);
+			multiplyScalar(view_model, world + node*16, out + i*28, 4);
+			multiplyScalar(view_model_normal, world_normal + node*16, out + i*28 + 16, 3);
+		}
+	}
+
+#ifdef TRANSFORM_KERNEL_X86
+	/**
+	 * One column of a * b: the columns of a, weighted by the elements of
+	 * the column of b, each broadcast with a shuffle
+	 */
+	inline __m128 multiplyColumnSSE(const __m128* a, __m128 b) {
+		__m128 r = _mm_mul_ps(a[0], _mm_shuffle_ps(b, b, 0x00));
+		r = _mm_add_ps(r, _mm_mul_ps(a[1], _mm_shuffle_ps(b, b, 0x55)));
+		r = _mm_add_ps(r, _mm_mul_ps(a[2], _mm_shuffle_ps(b, b, 0xaa)));
+		r = _mm_add_ps(r, _mm_mul_ps(a[3], _mm_shuffle_ps(b, b, 0xff)));
+		return r;
+	}
+
+	void transformPartsSSE(const float* view_model, const float* view_model_normal,
+			const float* world, const float* world_normal, const unsigned int* nodes, size_t count, float* out) {
+		__m128 a[4], n[4];
+		for (int k = 0; k < 4; ++k) {
+			a[k] = _mm_loadu_ps(view_model + k*4);
+			n[k] = _mm_loadu_ps(view_model_normal + k*4);
+		}
+
+		for (size_t i = 0; i < count; ++i) {
+			size_t node = getNode(nodes, i);
+			const float* w = world + node*16;
+			const float* wn = world_normal + node*16;
+			float* o = out + i*28;
+
+			for (int j = 0; j < 4; ++j)
+				_mm_storeu_ps(o + j*4, multiplyColumnSSE(a, _mm_loadu_ps(w + j*4)));
+			for (int j = 0; j < 3; ++j)
+				_mm_storeu_ps(o + 16 + j*4, multiplyColumnSSE(n, _mm_loadu_ps(wn + j*4)));
+		}
+	}
+
+	/**
+	 * Two columns of a * b at once: each 128-bit lane of b holds a column,
+	 * and the in-lane shuffle broadcasts the same element of both
+	 */
+	TARGET_AVX2 inline __m256 multiplyColumnsAVX2(const __m256* a, __m256 b) {
+		__m256 r = _mm256_mul_ps(a[0], _mm256_shuffle_ps(b, b, 0x00));
+		r = _mm256_fmadd_ps(a[1], _mm256_shuffle_ps(b, b, 0x55), r);
+		r = _mm256_fmadd_ps(a[2], _mm256_shuffle_ps(b, b, 0xaa), r);
+		r = _mm256_fmadd_ps(a[3], _mm256_shuffle_ps(b, b, 0xff), r);
+		return r;
+	}
+
+	TARGET_AVX2 void transformPartsAVX2(const float* view_model, const float* view_model_normal,
+			const float* world, const float* world_normal, const unsigned int* nodes, size_t count, float* out) {
+		// Every column of the shared matrices in both lanes
+		__m256 a[4], n[4];
+		for (int k = 0; k < 4; ++k) {
+			a[k] = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(view_model + k*4));
+			n[k] = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(view_model_normal + k*4));
+		}
+
+		for (size_t i = 0; i < count; ++i) {
+			size_t node = getNode(nodes, i);
+			const float* w = world + node*16;
+			const float* wn = world_normal + node*16;
+			float* o = out + i*28;
+
+			_mm256_storeu_ps(o, multiplyColumnsAVX2(a, _mm256_loadu_ps(w)));
+			_mm256_storeu_ps(o + 8, multiplyColumnsAVX2(a, _mm256_loadu_ps(w + 8)));
+
+			// The normal matrix only has three columns, the third goes through one lane
+			_mm256_storeu_ps(o + 16, multiplyColumnsAVX2(n, _mm256_loadu_ps(wn)));
+			__m256 third = multiplyColumnsAVX2(n, _mm256_castps128_ps256(_mm_loadu_ps(wn + 8)));
+			_mm_storeu_ps(o + 24, _mm256_castps256_ps128(third));
+		}
+	}
+
+	bool cpuSupportsAVX2() {
+#if defined(__GNUC__) || defined(__clang__)
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#elif defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7)
+			return false;
+
+		// FMA, and the OS saving the AVX registers
+		__cpuid(info, 1);
+		if ((info[2] & (1 << 12)) == 0 || (info[2] & (1 << 27)) == 0)
+			return false;
+		if ((_xgetbv(0) & 6) != 6)
+			return false;
+
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#else
+		return false;
+#endif
+	}
+#endif
+}
+
+TransformKernel::Implementation TransformKernel::getBestImplementation() {
+	static const Implementation best = isSupported(AVX2) ? AVX2 : (isSupported(SSE) ? SSE : SCALAR);
+	return best;
+}
+
+bool TransformKernel::isSupported(Implementation implementation) {
+	switch (implementation) {
+	case SCALAR:
+		return true;
+#ifdef TRANSFORM_KERNEL_X86
+	case SSE:
+		return true; // Part of x86-64
+	case AVX2: {
+		static const bool avx2 = cpuSupportsAVX2();
+		return avx2;
+	}
+#endif
+	default:
+		return false;
+	}
+}
+
+const char* TransformKernel::getName(Implementation implementation) {
+	switch (implementation) {
+	case SCALAR: return "scalar";
+	case SSE: return "SSE";
+	case AVX2: return "AVX2";
+	default: return "unknown";
+	}
+}
+
+void TransformKernel::transformParts(const glm::mat4& view_model, const glm::mat4& view_model_normal,
+		const glm::mat4* world, const glm::mat4* world_normal, const unsigned int* nodes, size_t count, DrawTransform* out) {
+	transformParts(getBestImplementation(), view_model, view_model_normal, world, world_normal, nodes, count, out);
+}
+
+void TransformKernel::transformParts(Implementation implementation, const glm::mat4& view_model, const glm::mat4& view_model_normal,
+		const glm::mat4* world, const glm::mat4* world_normal, const unsigned int* nodes, size_t count, DrawTransform* out) {
+	if (count == 0)
+		return;
+
+	const float* a = glm::value_ptr(view_model);
+	const float* n = glm::value_ptr(view_model_normal);
+	const float* w = glm::value_ptr(world[0]);
+	const float* wn = glm::value_ptr(world_normal[0]);
+	float* o = glm::value_ptr(out[0].modelview_matrix);
+
+	switch (implementation) {
+	case SCALAR:
+		transformPartsScalar(a, n, w, wn, nodes, count, o);
+		break;
+#ifdef TRANSFORM_KERNEL_X86
+	case SSE:
+		transformPartsSSE(a, n, w, wn, nodes, count, o);
+		break;
+	case AVX2:
+		if (!isSupported(AVX2))
+			THROW_EXCEPTION("The CPU does not support AVX2");
+		transformPartsAVX2(a, n, w, wn, nodes, count, o);
+		break;
+#endif
+	default:
+		THROW_EXCEPTION(std::string("Transform kernel not supported: ") + getName(implementation));
+	}
+}
@@ -0,0 +1,75 @@
+#include "VertexQuantizer.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+	const float position_steps = 65535.0f; //< Steps between the ends of the box
+	const float normal_scale = 511.0f; //< Largest 10-bit signed value
+
+	// Size of one step along each axis. Flat boxes get a step anyway,
+	// so the transform stays invertible.
+	glm::vec3 getStep(const glm::vec3& min_dim, const glm::vec3& max_dim) {
+		glm::vec3 step = (max_dim - min_dim) / position_steps;
+		for (int i = 0; i < 3; ++i)
+			if (!(step[i] > 0.0f))
+				step[i] = 1.0f;
+		return step;
+	}
+
+	inline uint32_t packNormalComponent(float value, float& decoded) {
+		int32_t c = static_cast<int32_t>(std::floor(std::min(1.0f, std::max(-1.0f, value)) * normal_scale + 0.5f));
+		decoded = c / normal_scale;
+		return static_cast<uint32_t>(c) & 0x3FF;
+	}
+}
+
+glm::mat4 VertexQuantizer::getDequantizationTransform(const glm::vec3& min_dim, const glm::vec3& max_dim) {
+	// Integers from -32768 to 32767 map to the box
+	glm::vec3 step = getStep(min_dim, max_dim);
+	glm::vec3 offset = min_dim + step * 32768.0f;
+	glm::mat4 transform(1.0f);
+	transform[0][0] = step.x;
+	transform[1][1] = step.y;
+	transform[2][2] = step.z;
+	transform[3] = glm::vec4(offset, 1.0f);
+	return transform;
+}
+
+void VertexQuantizer::quantize(const float* vertices, size_t n_vertices, const glm::vec3& min_dim, const glm::vec3& max_dim,
+		QuantizedVertex* out, Error& error) {
+	glm::vec3 step = getStep(min_dim, max_dim);
+	glm::vec3 offset = min_dim + step * 32768.0f;
+	float max_position_error = 0.0f;
+	float min_normal_cosine = 1.0f;
+
+	for (size_t i = 0; i < n_vertices; ++i) {
+		const float* vertex = vertices + i * 6;
+		QuantizedVertex& packed = out[i];
+
+		float distance2 = 0.0f;
+		for (int j = 0; j < 3; ++j) {
+			float q = std::floor((vertex[j] - min_dim[j]) / step[j] + 0.5f) - 32768.0f;
+			q = std::min(32767.0f, std::max(-32768.0f, q));
+			packed.position[j] = static_cast<int16_t>(q);
+			float d = offset[j] + q * step[j] - vertex[j];
+			distance2 += d * d;
+		}
+		packed.position[3] = 0;
+		max_position_error = std::max(max_position_error, distance2);
+
+		glm::vec3 decoded;
+		packed.normal = packNormalComponent(vertex[3], decoded.x)
+			| (packNormalComponent(vertex[4], decoded.y) << 10)
+			| (packNormalComponent(vertex[5], decoded.z) << 20);
+
+		glm::vec3 normal(vertex[3], vertex[4], vertex[5]);
+		float lengths = glm::length(normal) * glm::length(decoded);
+		if (lengths > 0.0f)
+			min_normal_cosine = std::min(min_normal_cosine, glm::dot(normal, decoded) / lengths);
+	}
+
+	error.position = std::max(error.position, std::sqrt(max_position_error));
+	float degrees = std::acos(std::min(1.0f, std::max(-1.0f, min_normal_cosine))) * 180.0f / 3.14159265f;
+	error.normal_degrees = std::max(error.normal_degrees, degrees);
+}
@@ -1,130 +1,141 @@
-#include "VirtualTrackball.h"
-#include <cmath>
-#include <iostream>
-#include "GLUtils/GLUtils.hpp"
-
-glm::mat4 quatToMat4(glm::quat m_q) {
-	
-	// There probably exists an glm function for this calculation
-	// But because I'm not that familiar with glm yet, I prefer to do the calculations manually
-
-	float m11, m12, m13;
-	float m21, m22, m23;
-	float m31, m32, m33;
-
-	m11 = 1 - 2 * glm::pow(m_q.y, 2.0f) - 2 * glm::pow(m_q.z, 2.0f);
-	m21 = 2 * m_q.x * m_q.y + 2 * m_q.w * m_q.z;
-	m31 = 2 * m_q.x * m_q.z - 2 * m_q.w * m_q.y;
-	m12 = 2 * m_q.x * m_q.y - 2 * m_q.w * m_q.z;
-	m22 = 1 - 2 * glm::pow(m_q.x, 2.0f) - 2 * glm::pow(m_q.z, 2.0f);
-	m32 = 2 * m_q.y * m_q.z + 2 * m_q.w * m_q.x;
-	m13 = 2 * m_q.x * m_q.z + 2 * m_q.w * m_q.y;
-	m23 = 2 * m_q.y * m_q.z - 2 * m_q.w * m_q.x;
-	m33 = 1 - 2 * glm::pow(m_q.x, 2.0f) - 2 * glm::pow(m_q.y, 2.0f);
-
-	glm::mat3x3 rot_matrix(m11, m12, m13, m21, m22, m23, m31, m32, m33);
-
-	return glm::mat4(rot_matrix);
-}
-
-VirtualTrackball::VirtualTrackball() {
-	quat_old.w = 1.0;
-	quat_old.x = 0.0;
-	quat_old.y = 0.0;
-	quat_old.z = 0.0;
-	rotating = false;
-}
-
-VirtualTrackball::~VirtualTrackball() {}
-
-void VirtualTrackball::rotateBegin(int x, int y) {
-	rotating = true;
-	point_on_sphere_begin = getClosestPointOnUnitSphere(x, y);
-}
-
-void VirtualTrackball::rotateEnd(int x, int y) {
-	rotating = false;
-	quat_old = quat_new;
-}
-
-glm::mat4 VirtualTrackball::rotate(int x, int y) {
-
-	//If not rotating, simply return the old rotation matrix
-	if (!rotating) return quatToMat4(quat_old);
-
-	glm::vec3 point_on_sphere_end; //Current point on unit sphere
-	glm::vec3 axis_of_rotation; //axis of rotation
-	float theta = 0.0f; //angle of rotation
-
-	point_on_sphere_end = getClosestPointOnUnitSphere(x, y);
-
-
-	// Calculating the CROSS product between the source and destination vectors, in order to find the axis if rotation
-	axis_of_rotation.x = point_on_sphere_end.y * point_on_sphere_begin.z - point_on_sphere_end.z * point_on_sphere_begin.y;
-	axis_of_rotation.y = -(point_on_sphere_end.x * point_on_sphere_begin.z - point_on_sphere_end.z * point_on_sphere_begin.x);
-	axis_of_rotation.z = point_on_sphere_end.x * point_on_sphere_begin.y - point_on_sphere_end.y * point_on_sphere_begin.x;
-
-
-	// Normalize length of axis_of_rotation
-	axis_of_rotation = GLUtils::normaliseVector(axis_of_rotation); 
-
-	// Calculating the DOT product of the source and destination vectors
-	float dot = point_on_sphere_begin.x * point_on_sphere_end.x +
-		point_on_sphere_begin.y * point_on_sphere_end.y +
-		point_on_sphere_begin.z * point_on_sphere_end.z;
-	
-	// Calculation the angle between the source and destination vectors
-	theta = glm::degrees(glm::acos(dot)); // Arc-cosine returns the angle in radians for some reason
-
-#ifdef MORE_DEBUG_INFO
-	std::cout << "rotate: " << std::endl;
-	std::cout << "Angle: " << theta << std::endl;
-	std::cout << "Axis: " << axis_of_rotation.x << " " << axis_of_rotation.y << " " << axis_of_rotation.z << std::endl;
-#endif
-
-	quat_new = glm::rotate(quat_old, theta, axis_of_rotation);
-
-	return quatToMat4(quat_new);
-}
-
-
-void VirtualTrackball::setWindowSize(int w, int h) {
-	this->w = w;
-	this->h = h;
-}
-
-
-glm::vec2 VirtualTrackball::getNormalizedWindowCoordinates(int x, int y) {
-	
-	glm::vec2 coord = glm::vec2(0.0f);
-	
-	coord.x = ((x / static_cast<float>(w)) - 0.5f);
-	coord.y = (0.5f - (y / static_cast<float>(h)));
-
-	return coord;
-}
-
-
-glm::vec3 VirtualTrackball::getClosestPointOnUnitSphere(int x, int y) {
-	glm::vec2 normalized_coords;
-	glm::vec3 point_on_sphere;
-	float k;
-
-	normalized_coords = getNormalizedWindowCoordinates(x, y);
-	
-	k = glm::sqrt(glm::pow(normalized_coords.x, 2.0f) + glm::pow(normalized_coords.y, 2.0f));
-	
-	if(k <= 0.5f)
-	{
-		point_on_sphere.x = normalized_coords.x * 2;
-		point_on_sphere.y = normalized_coords.y * 2;
-		point_on_sphere.z = glm::sqrt(1 - (4 * glm::pow(k, 2.0f)));
-	} else
-	{
-		point_on_sphere.x = normalized_coords.x / k;
-		point_on_sphere.y = normalized_coords.y / k;
-
-	}
-
-	return point_on_sphere;
+#include "VirtualTrackball.h"
+#include <cmath>
+#include <iostream>
+
+glm::mat4 quatToMat4(const glm::quat& m_q) {
+	
+	// There probably exists an glm function for this calculation
+	// But because I'm not that familiar with glm yet, I prefer to do the calculations manually
+
+	// The products are shared between the elements, squares are plain multiplications
+	float xx = m_q.x * m_q.x, yy = m_q.y * m_q.y, zz = m_q.z * m_q.z;
+	float xy = m_q.x * m_q.y, xz = m_q.x * m_q.z, yz = m_q.y * m_q.z;
+	float wx = m_q.w * m_q.x, wy = m_q.w * m_q.y, wz = m_q.w * m_q.z;
+
+	float m11, m12, m13;
+	float m21, m22, m23;
+	float m31, m32, m33;
+
+	m11 = 1 - 2 * (yy + zz);
+	m21 = 2 * (xy + wz);
+	m31 = 2 * (xz - wy);
+	m12 = 2 * (xy - wz);
+	m22 = 1 - 2 * (xx + zz);
+	m32 = 2 * (yz + wx);
+	m13 = 2 * (xz + wy);
+	m23 = 2 * (yz - wx);
+	m33 = 1 - 2 * (xx + yy);
+
+	glm::mat3x3 rot_matrix(m11, m12, m13, m21, m22, m23, m31, m32, m33);
+
+	return glm::mat4(rot_matrix);
+}
+
+VirtualTrackball::VirtualTrackball() {
+	quat_old.w = 1.0;
+	quat_old.x = 0.0;
+	quat_old.y = 0.0;
+	quat_old.z = 0.0;
+	quat_new = quat_old;
+	rotating = false;
+}
+
+VirtualTrackball::~VirtualTrackball() {}
+
+void VirtualTrackball::rotateBegin(int x, int y) {
+	rotating = true;
+	point_on_sphere_begin = getClosestPointOnUnitSphere(x, y);
+}
+
+void VirtualTrackball::rotateEnd(int x, int y) {
+	rotating = false;
+	quat_old = quat_new;
+}
+
+glm::mat4 VirtualTrackball::rotate(int x, int y) {
+
+	//If not rotating, simply return the old rotation matrix
+	if (!rotating) return quatToMat4(quat_old);
+
+	glm::vec3 point_on_sphere_end; //Current point on unit sphere
+	glm::vec3 axis_of_rotation; //axis of rotation, sin(theta) long
+
+	point_on_sphere_end = getClosestPointOnUnitSphere(x, y);
+
+
+	// Calculating the CROSS product between the source and destination vectors, in order to find the axis if rotation
+	axis_of_rotation.x = point_on_sphere_end.y * point_on_sphere_begin.z - point_on_sphere_end.z * point_on_sphere_begin.y;
+	axis_of_rotation.y = -(point_on_sphere_end.x * point_on_sphere_begin.z - point_on_sphere_end.z * point_on_sphere_begin.x);
+	axis_of_rotation.z = point_on_sphere_end.x * point_on_sphere_begin.y - point_on_sphere_end.y * point_on_sphere_begin.x;
+
+	// Calculating the DOT product of the source and destination vectors, cos(theta)
+	float dot = point_on_sphere_begin.x * point_on_sphere_end.x +
+		point_on_sphere_begin.y * point_on_sphere_end.y +
+		point_on_sphere_begin.z * point_on_sphere_end.z;
+
+	// The quaternion rotating by theta around the axis is (cos(theta/2), sin(theta/2) * axis).
+	// Both points are on the unit sphere, so (1 + cos(theta), cross product) is that quaternion
+	// times 2 cos(theta/2) = sqrt(2 (1 + cos(theta))). Dividing by it rotates without acos,
+	// sin and cos, or normalizing the axis. Opposite points have no single axis, and keep the
+	// last rotation.
+	float w = 1.0f + dot;
+	if (w <= 1e-6f) return quatToMat4(quat_new);
+	float scale = 1.0f / std::sqrt(2.0f * w);
+	glm::quat rotation(w * scale, axis_of_rotation.x * scale, axis_of_rotation.y * scale, axis_of_rotation.z * scale);
+
+#ifdef MORE_DEBUG_INFO
+	std::cout << "rotate: " << std::endl;
+	std::cout << "Angle: " << glm::degrees(2.0f * std::acos(rotation.w)) << std::endl;
+	std::cout << "Axis: " << axis_of_rotation.x << " " << axis_of_rotation.y << " " << axis_of_rotation.z << std::endl;
+#endif
+
+	quat_new = quat_old * rotation;
+
+	return quatToMat4(quat_new);
+}
+
+
+void VirtualTrackball::setWindowSize(int w, int h) {
+	this->w = w;
+	this->h = h;
+	inverse_w = 1.0f / w;
+	inverse_h = 1.0f / h;
+}
+
+
+glm::vec2 VirtualTrackball::getNormalizedWindowCoordinates(int x, int y) {
+	
+	glm::vec2 coord = glm::vec2(0.0f);
+	
+	coord.x = ((x * inverse_w) - 0.5f);
+	coord.y = (0.5f - (y * inverse_h));
+
+	return coord;
+}
+
+
+glm::vec3 VirtualTrackball::getClosestPointOnUnitSphere(int x, int y) {
+	glm::vec2 normalized_coords;
+	glm::vec3 point_on_sphere;
+	float k2; // Squared distance from the center of the window
+
+	normalized_coords = getNormalizedWindowCoordinates(x, y);
+	
+	k2 = normalized_coords.x * normalized_coords.x + normalized_coords.y * normalized_coords.y;
+	
+	if(k2 <= 0.25f)
+	{
+		point_on_sphere.x = normalized_coords.x * 2;
+		point_on_sphere.y = normalized_coords.y * 2;
+		point_on_sphere.z = std::sqrt(1 - 4 * k2);
+	} else
+	{
+		// Outside the sphere, the closest point is on its rim
+		float inverse_k = 1.0f / std::sqrt(k2);
+		point_on_sphere.x = normalized_coords.x * inverse_k;
+		point_on_sphere.y = normalized_coords.y * inverse_k;
+		point_on_sphere.z = 0.0f;
+	}
+
+	return point_on_sphere;
 }
\ No newline at end of file
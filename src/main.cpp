@@ -1,34 +1,239 @@
-#include "GameManager.h"
-#include <iostream>
-#include <memory>
-
-#ifdef _WIN32
-#include <Windows.h>
-#endif
-
-
-#define CUSTOM_MODELS // remove in case we only want to load the bunny model
-
-/**
- * Simple program that starts our game manager
- */
-int main(int argc, char *argv[]) {
-	for (int i=0; i<argc; ++i) {
-		std::cout << "Argument " << i << ": " << argv[i] << std::endl;
-	}
-
-	const char * bunny = "models/bunny.obj";
-	
-	std::shared_ptr<GameManager> game;
-	game.reset(new GameManager(
-#ifdef CUSTOM_MODELS
-		(argc > 1) ? argv[1] : bunny
-#else
-		bunny
-#endif
-		));
-	game->init();
-	game->play();
-	game.reset();
-	return 0;
-}
+#include "GameManager.h"
+#include <iostream>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+
+#define CUSTOM_MODELS // remove in case we only want to load the bunny model
+
+/**
+ * Builds the mesh cache of every model in models (and of
+ * every model of the scene files among them), without
+ * opening a window
+ */
+int bake(const std::vector<std::string>& arguments, const LoadOptions& load_options) {
+	int failed = 0;
+	std::vector<std::string> models;
+	for (unsigned int i=0; i<arguments.size(); ++i) {
+		if (!Scene::isSceneFile(arguments[i])) {
+			models.push_back(arguments[i]);
+			continue;
+		}
+		try {
+			Scene scene(arguments[i]);
+			for (unsigned int j=0; j<scene.getAssets().size(); ++j)
+				models.push_back(scene.getAssets()[j].filename);
+		}
+		catch (GameException& e) {
+			std::cerr << e.what() << std::endl;
+			++failed;
+		}
+	}
+
+	for (unsigned int i=0; i<models.size(); ++i) {
+		try {
+			Model::bake(models[i], false, load_options);
+		}
+		catch (GameException&) {
+			std::cerr << "Could not bake " << models[i] << std::endl;
+			++failed;
+		}
+	}
+	PRINT_TIMED_SCOPES();
+	return (failed > 0) ? 1 : 0;
+}
+
+/**
+ * Simple program that starts our game manager.
+ * Usage:
+ *   <program> [options] [model]
+ *   <program> [options] [scene.scene]   (instances of models, see Scene)
+ *   <program> [options] bake model1 [model2 ...]   (pre-builds mesh caches)
+ * Options:
+ *   --threads N        number of threads used to import models (default: one per core)
+ *   --headless         render offscreen (EGL) without a window, and print frame times
+ *   --software         render headless on the CPU, without OpenGL or a GPU
+ *   --render-threads N threads of the software renderer (default: one per core)
+ *   --frames N         number of frames to render in headless mode (default: 300)
+ *   --dump-frames P    save every headless frame as P0000.ppm, P0001.ppm, ...
+ *   --draw-data M      how per part matrices reach the shader: ubo (uniform buffer,
+ *                      default) or tbo (buffer texture)
+ *   --no-batching      draw every part with its own draw call instead of
+ *                      multi-draw calls (toggle with B while running)
+ *   --no-culling       draw parts outside the view frustum too (toggle with C
+ *                      while running)
+ *   --lod-levels N     levels of detail generated at load, each with half the
+ *                      triangles of the one before (default: 4, 1 turns it off,
+ *                      at most 16)
+ *   --lod-tolerance P  largest error of a level of detail on the screen, in
+ *                      pixels (default: 1)
+ *   --no-lod           always draw the full meshes (toggle with L while running)
+ *   --quantize         upload 12 byte vertices (16-bit positions, 10-bit normals)
+ *                      instead of 24 byte float vertices
+ *   --no-optimize      keep the triangle and vertex order of the file instead of
+ *                      reordering for the vertex cache, overdraw and vertex fetch
+ *   --no-obj-reader    import .obj files with assimp too, instead of the faster
+ *                      built in OBJ reader
+ *   --import-profile P assimp post-processing: minimal, fast (default) or quality
+ *   --import-timing    print the time of every assimp import step
+ *   --profile-csv F    write the CPU time of every phase, the GPU time, draw calls
+ *                      and triangles of every frame to the CSV file F
+ *   --profile-interval S
+ *                      seconds between the frame time percentiles printed while
+ *                      running (default: 5, 0 prints them only at the end)
+ *   --continuous       draw frames back to back instead of only when the view
+ *                      changes, e.g. to profile the frame rate
+ *   --max-fps N        draw at most N frames per second (default: no limit
+ *                      beyond vsync)
+ *   --vsync M          on (default), off, or adaptive (frames that miss the
+ *                      vertical blank are shown without waiting for the next)
+ *   --no-render-thread draw on the thread that handles the input, instead of
+ *                      on a render thread of its own
+ */
+int main(int argc, char *argv[]) {
+	LoadOptions load_options;
+	RenderOptions render_options;
+	bool headless = false;
+	unsigned int n_frames = 300;
+	std::string frame_prefix;
+	std::vector<std::string> arguments;
+
+	for (int i=0; i<argc; ++i) {
+		std::cout << "Argument " << i << ": " << argv[i] << std::endl;
+	}
+
+	for (int i=1; i<argc; ++i) {
+		std::string argument = argv[i];
+		if (argument == "--threads" && i+1 < argc) {
+			load_options.threads = static_cast<unsigned int>(atoi(argv[++i]));
+		}
+		else if (argument == "--headless") {
+			headless = true;
+		}
+		else if (argument == "--software") {
+			headless = true;
+			render_options.software = true;
+		}
+		else if (argument == "--render-threads" && i+1 < argc) {
+			render_options.render_threads = static_cast<unsigned int>(atoi(argv[++i]));
+		}
+		else if (argument == "--frames" && i+1 < argc) {
+			n_frames = static_cast<unsigned int>(atoi(argv[++i]));
+		}
+		else if (argument == "--dump-frames" && i+1 < argc) {
+			frame_prefix = argv[++i];
+		}
+		else if (argument == "--no-batching") {
+			render_options.batched = false;
+		}
+		else if (argument == "--no-culling") {
+			render_options.culling = false;
+		}
+		else if (argument == "--lod-levels" && i+1 < argc) {
+			int lod_levels = atoi(argv[++i]);
+			if (lod_levels < 1 || lod_levels > static_cast<int>(MeshHierarchy::max_levels)) {
+				std::cerr << "--lod-levels must be between 1 and " << MeshHierarchy::max_levels << std::endl;
+				return 1;
+			}
+			load_options.lod_levels = static_cast<unsigned int>(lod_levels);
+		}
+		else if (argument == "--lod-tolerance" && i+1 < argc) {
+			render_options.lod_tolerance = static_cast<float>(atof(argv[++i]));
+		}
+		else if (argument == "--no-lod") {
+			render_options.lod = false;
+		}
+		else if (argument == "--quantize") {
+			load_options.quantize = true;
+		}
+		else if (argument == "--no-optimize") {
+			load_options.optimize = false;
+		}
+		else if (argument == "--no-obj-reader") {
+			load_options.obj_reader = false;
+		}
+		else if (argument == "--import-profile" && i+1 < argc) {
+			if (!ImportProfile::fromName(argv[++i], load_options.import_profile))
+				std::cerr << "Unknown import profile " << argv[i] << ", using " << ImportProfile::getName(load_options.import_profile) << std::endl;
+		}
+		else if (argument == "--import-timing") {
+			load_options.import_timing = true;
+		}
+		else if (argument == "--profile-csv" && i+1 < argc) {
+			render_options.profile_csv = argv[++i];
+		}
+		else if (argument == "--profile-interval" && i+1 < argc) {
+			render_options.profile_interval = atof(argv[++i]);
+		}
+		else if (argument == "--continuous") {
+			render_options.continuous = true;
+		}
+		else if (argument == "--no-render-thread") {
+			render_options.render_thread = false;
+		}
+		else if (argument == "--max-fps" && i+1 < argc) {
+			render_options.max_fps = atof(argv[++i]);
+		}
+		else if (argument == "--vsync" && i+1 < argc) {
+			std::string mode = argv[++i];
+			if (mode == "off")
+				render_options.swap_interval = 0;
+			else if (mode == "adaptive")
+				render_options.swap_interval = -1;
+			else
+				render_options.swap_interval = 1;
+		}
+		else if (argument == "--draw-data" && i+1 < argc) {
+			std::string mode = argv[++i];
+			if (mode == "tbo")
+				render_options.draw_data_mode = DrawDataBuffer::TEXTURE_BUFFER;
+			else if (mode == "ubo")
+				render_options.draw_data_mode = DrawDataBuffer::UNIFORM_BUFFER;
+			else {
+				std::cerr << "Unknown --draw-data mode " << mode << ", use ubo or tbo" << std::endl;
+				return 1;
+			}
+		}
+		else {
+			arguments.push_back(argument);
+		}
+	}
+
+	if (!arguments.empty() && arguments[0] == "bake") {
+		if (arguments.size() < 2) {
+			std::cerr << "Usage: " << argv[0] << " [--threads N] [--lod-levels N] [--no-optimize] [--import-profile P] bake <model> [<model> ...]" << std::endl;
+			return 1;
+		}
+		return bake(std::vector<std::string>(arguments.begin() + 1, arguments.end()), load_options);
+	}
+
+	const char * bunny = "models/bunny.obj";
+	
+	std::shared_ptr<GameManager> game;
+	game.reset(new GameManager(
+#ifdef CUSTOM_MODELS
+		(!arguments.empty()) ? arguments[0] : bunny
+#else
+		bunny
+#endif
+		, load_options, render_options));
+	if (headless) {
+		if (render_options.software)
+			game->initSoftware();
+		else
+			game->initHeadless();
+		game->playHeadless(n_frames, frame_prefix);
+	}
+	else {
+		game->init();
+		game->play();
+	}
+	game.reset();
+	return 0;
+}
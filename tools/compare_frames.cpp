@@ -0,0 +1,90 @@
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+	/**
+	 * An RGB image, as the viewer saves frames (binary PPM, 255 as the
+	 * largest value)
+	 */
+	struct Image {
+		unsigned int width;
+		unsigned int height;
+		std::vector<unsigned char> pixels;
+	};
+
+	bool readPPM(const std::string& filename, Image& image) {
+		std::ifstream file(filename.c_str(), std::ios::binary);
+		std::string magic;
+		unsigned int max_value;
+		if (!(file >> magic >> image.width >> image.height >> max_value) || magic != "P6" || max_value != 255)
+			return false;
+		file.get(); // The single whitespace after the header
+		image.pixels.resize(static_cast<size_t>(image.width) * image.height * 3);
+		file.read(reinterpret_cast<char*>(&image.pixels[0]), image.pixels.size());
+		return file.gcount() == static_cast<std::streamsize>(image.pixels.size());
+	}
+}
+
+/**
+ * Compares two frames saved by the viewer with --dump-frames, e.g. one
+ * rendered with OpenGL and one with the software renderer. A pixel
+ * differs if any of its channels differs by more than the tolerance. The
+ * two rasterizers may round the edges of triangles differently, so a
+ * small share of differing pixels is allowed.
+ * Usage: compare_frames <a.ppm> <b.ppm> [tolerance] [max different]
+ *   tolerance       largest difference of a channel (default: 8)
+ *   max different   largest share of differing pixels (default: 0.01)
+ * Returns 0 if the frames match.
+ */
+int main(int argc, char* argv[]) {
+	if (argc < 3) {
+		std::cerr << "Usage: " << argv[0] << " <a.ppm> <b.ppm> [tolerance] [max different]" << std::endl;
+		return 1;
+	}
+	int tolerance = (argc > 3) ? atoi(argv[3]) : 8;
+	double max_different = (argc > 4) ? atof(argv[4]) : 0.01;
+
+	Image a, b;
+	if (!readPPM(argv[1], a)) {
+		std::cerr << "Could not read " << argv[1] << std::endl;
+		return 1;
+	}
+	if (!readPPM(argv[2], b)) {
+		std::cerr << "Could not read " << argv[2] << std::endl;
+		return 1;
+	}
+	if (a.width != b.width || a.height != b.height) {
+		std::cerr << "Frame sizes differ: " << a.width << "x" << a.height << " and " << b.width << "x" << b.height << std::endl;
+		return 1;
+	}
+
+	size_t n_pixels = static_cast<size_t>(a.width) * a.height;
+	size_t n_different = 0;
+	size_t n_background = 0;
+	for (size_t i = 0; i < n_pixels; ++i) {
+		const unsigned char* pa = &a.pixels[3 * i];
+		const unsigned char* pb = &b.pixels[3 * i];
+		bool different = false;
+		for (int c = 0; c < 3; ++c)
+			different = different || std::abs(pa[c] - pb[c]) > tolerance;
+		if (different)
+			++n_different;
+		if (memcmp(pa, &a.pixels[0], 3) == 0)
+			++n_background;
+	}
+
+	double share = (n_pixels > 0) ? n_different / static_cast<double>(n_pixels) : 0.0;
+	std::cout << n_different << " of " << n_pixels << " pixels differ by more than " << tolerance
+		<< " (" << share * 100.0 << "%, at most " << max_different * 100.0 << "% allowed)" << std::endl;
+
+	// Two empty frames would match too, but test nothing
+	if (n_background == n_pixels) {
+		std::cerr << "Nothing was drawn in " << argv[1] << std::endl;
+		return 1;
+	}
+	return (share <= max_different) ? 0 : 1;
+}